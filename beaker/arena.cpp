@@ -0,0 +1,86 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/arena.hpp"
+
+#include <cstdlib>
+
+
+// Allocate a new block large enough to hold n bytes
+// with alignment a, and allocate from that. Requests
+// larger than a block get a block of their own.
+void*
+Arena::grow(std::size_t n, std::size_t a)
+{
+  std::size_t size = block_size;
+  if (n + a > size)
+    size = n + a;
+  char* block = static_cast<char*>(std::malloc(size));
+  if (!block)
+    throw std::bad_alloc();
+  blocks_.push_back(block);
+
+  // Only move to the new block if it has more room
+  // than the current one.
+  std::size_t p = reinterpret_cast<std::size_t>(block);
+  std::size_t q = (p + a - 1) & ~(a - 1);
+  if (size == block_size) {
+    first_ = reinterpret_cast<char*>(q + n);
+    last_ = block + size;
+  }
+  bytes_ += n;
+  return reinterpret_cast<void*>(q);
+}
+
+
+// Destroy all objects in the arena and release its
+// memory. Objects are destroyed in the reverse order
+// of their construction.
+void
+Arena::release()
+{
+  for (auto iter = dtors_.rbegin(); iter != dtors_.rend(); ++iter)
+    iter->fn(iter->obj);
+  dtors_.clear();
+
+  for (char* block : blocks_)
+    std::free(block);
+  blocks_.clear();
+
+  first_ = last_ = nullptr;
+  bytes_ = 0;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Current arena
+
+namespace
+{
+
+Arena global_arena_;
+thread_local Arena* current_ = &global_arena_;
+
+} // namespace
+
+
+Arena&
+current_arena()
+{
+  return *current_;
+}
+
+
+Arena_sentinel::Arena_sentinel(Arena& a)
+  : prev(current_)
+{
+  current_ = &a;
+}
+
+
+Arena_sentinel::~Arena_sentinel()
+{
+  current_ = prev;
+}
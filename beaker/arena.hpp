@@ -0,0 +1,146 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_ARENA_HPP
+#define BEAKER_ARENA_HPP
+
+// The arena module provides bump-pointer allocation for
+// the nodes of an abstract syntax tree. Nodes created
+// during the translation of a module are allocated from
+// the module's arena and released, all at once, when
+// the module is destroyed.
+//
+// Canonical types are global, and do not refer to nodes
+// in any arena (see get_array_type).
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// An arena is a sequence of large memory blocks from
+// which objects are allocated by incrementing a pointer.
+// Individual objects are never deallocated. Objects with
+// non-trivial destructors are registered when created
+// and destroyed (in reverse order) on release.
+class Arena
+{
+  struct Cleanup
+  {
+    void (*fn)(void*);
+    void* obj;
+  };
+
+public:
+  static constexpr std::size_t block_size = 64 * 1024;
+
+  Arena();
+  ~Arena();
+
+  Arena(Arena const&) = delete;
+  Arena& operator=(Arena const&) = delete;
+
+  void* allocate(std::size_t, std::size_t);
+
+  template<typename T, typename... Args>
+  T* make(Args&&...);
+
+  void release();
+
+  std::size_t allocated() const { return bytes_; }
+
+private:
+  void* grow(std::size_t, std::size_t);
+
+  template<typename T>
+  static void destroy(void* p) { static_cast<T*>(p)->~T(); }
+
+  char*              first_;  // Next free byte in the block
+  char*              last_;   // End of the current block
+  std::size_t        bytes_;  // Total bytes allocated
+  std::vector<char*> blocks_; // Owned memory blocks
+  std::vector<Cleanup> dtors_; // Registered destructors
+};
+
+
+inline
+Arena::Arena()
+  : first_(nullptr), last_(nullptr), bytes_(0)
+{ }
+
+
+inline
+Arena::~Arena()
+{
+  release();
+}
+
+
+// Allocate n bytes with alignment a. This is a simple
+// pointer increment in the common case.
+inline void*
+Arena::allocate(std::size_t n, std::size_t a)
+{
+  std::size_t p = reinterpret_cast<std::size_t>(first_);
+  std::size_t q = (p + a - 1) & ~(a - 1);
+  if (first_ && q + n <= reinterpret_cast<std::size_t>(last_)) {
+    first_ = reinterpret_cast<char*>(q + n);
+    bytes_ += n;
+    return reinterpret_cast<void*>(q);
+  }
+  return grow(n, a);
+}
+
+
+// Construct a new object of type T in the arena. If T
+// is not trivially destructible, it is registered for
+// destruction when the arena is released.
+template<typename T, typename... Args>
+inline T*
+Arena::make(Args&&... args)
+{
+  void* p = allocate(sizeof(T), alignof(T));
+  T* t = new (p) T(std::forward<Args>(args)...);
+  if (!std::is_trivially_destructible<T>::value)
+    dtors_.push_back({&destroy<T>, t});
+  return t;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Current arena
+
+// Returns the arena from which nodes are currently
+// allocated. When no arena has been established, a
+// global arena is used; it is released at exit.
+//
+// The current arena is per thread, and arenas are not
+// shared between threads. A thread that allocates nodes
+// must first establish its own arena.
+Arena& current_arena();
+
+
+// An RAII class that establishes the arena from which
+// nodes are allocated. The previous arena is restored
+// on exit.
+struct Arena_sentinel
+{
+  Arena_sentinel(Arena&);
+  ~Arena_sentinel();
+
+  Arena* prev;
+};
+
+
+// Allocate a new node in the current arena.
+template<typename T, typename... Args>
+inline T*
+make(Args&&... args)
+{
+  return current_arena().make<T>(std::forward<Args>(args)...);
+}
+
+
+#endif
@@ -0,0 +1,195 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+// Compares the two ways of selecting a function by the
+// class of a node:
+//
+//    - apply(), which calls accept() and then visit() on a
+//      generic visitor (two virtual calls); and
+//    - dispatch(), which switches on the node's kind.
+//
+// It also compares is<T> with the dynamic_cast that it
+// replaced. The nodes are real expressions, allocated in
+// an arena as the compiler allocates them.
+//
+// Usage: beaker-bench-dispatch [depth [trees]]
+
+#include "config.hpp"
+
+#include "beaker/expr.hpp"
+#include "beaker/type.hpp"
+#include "beaker/value.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+std::mt19937 rng(42);
+
+
+// Build a random expression tree of the given depth.
+Expr*
+tree(int d)
+{
+  Type const* z = get_integer_type();
+  if (d == 0)
+    return make<Literal_expr>(z, Value(int(rng() % 100)));
+  switch (rng() % 9) {
+    case 0: return make<Add_expr>(tree(d - 1), tree(d - 1));
+    case 1: return make<Sub_expr>(tree(d - 1), tree(d - 1));
+    case 2: return make<Mul_expr>(tree(d - 1), tree(d - 1));
+    case 3: return make<Eq_expr>(tree(d - 1), tree(d - 1));
+    case 4: return make<Lt_expr>(tree(d - 1), tree(d - 1));
+    case 5: return make<And_expr>(tree(d - 1), tree(d - 1));
+    case 6: return make<Neg_expr>(tree(d - 1));
+    case 7: return make<Not_expr>(tree(d - 1));
+    default: return make<Literal_expr>(z, Value(int(rng() % 100)));
+  }
+}
+
+
+long visit_apply(Expr const*);
+long visit_dispatch(Expr const*);
+
+
+// Returns the kind of e plus the values of its operands.
+// Both walks do the same work, except for how they select
+// this function.
+template<typename F>
+long
+walk(Expr const* e, F recur)
+{
+  long r = e->kind();
+  if (Unary_expr const* u = as<Unary_expr>(e))
+    r += recur(u->operand());
+  else if (Binary_expr const* b = as<Binary_expr>(e))
+    r += recur(b->left()) ^ recur(b->right());
+  return r;
+}
+
+
+struct Apply_fn
+{
+  template<typename T>
+  long operator()(T const* e) { return walk(e, visit_apply); }
+};
+
+
+struct Dispatch_fn
+{
+  template<typename T>
+  long operator()(T const* e) { return walk(e, visit_dispatch); }
+};
+
+
+__attribute__((noinline)) long
+visit_apply(Expr const* e)
+{
+  return apply(e, Apply_fn{});
+}
+
+
+__attribute__((noinline)) long
+visit_dispatch(Expr const* e)
+{
+  return dispatch(e, Dispatch_fn{});
+}
+
+
+__attribute__((noinline)) long
+count_cast(std::vector<Expr*> const& es)
+{
+  long n = 0;
+  for (Expr const* e : es)
+    n += dynamic_cast<Add_expr const*>(e) != nullptr;
+  return n;
+}
+
+
+__attribute__((noinline)) long
+count_kind(std::vector<Expr*> const& es)
+{
+  long n = 0;
+  for (Expr const* e : es)
+    n += is<Add_expr>(e);
+  return n;
+}
+
+
+// Returns the best time of several runs of f, in seconds.
+template<typename F>
+double
+best(F f)
+{
+  double t = 1e9;
+  for (int i = 0; i < 7; ++i) {
+    Clock::time_point start = Clock::now();
+    volatile long r = f();
+    (void)r;
+    t = std::min(t, std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  return t;
+}
+
+
+void
+collect(Expr* e, std::vector<Expr*>& es)
+{
+  es.push_back(e);
+  if (Unary_expr* u = as<Unary_expr>(e))
+    collect(u->operand(), es);
+  else if (Binary_expr* b = as<Binary_expr>(e)) {
+    collect(b->left(), es);
+    collect(b->right(), es);
+  }
+}
+
+} // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+  int depth = argc > 1 ? std::atoi(argv[1]) : 16;
+  int count = argc > 2 ? std::atoi(argv[2]) : 32;
+
+  Arena arena;
+  Arena_sentinel alloc(arena);
+  std::vector<Expr*> roots;
+  std::vector<Expr*> nodes;
+  for (int i = 0; i < count; ++i) {
+    roots.push_back(tree(depth));
+    collect(roots.back(), nodes);
+  }
+
+  double a = best([&] {
+    long s = 0;
+    for (Expr const* e : roots)
+      s += visit_apply(e);
+    return s;
+  });
+  double d = best([&] {
+    long s = 0;
+    for (Expr const* e : roots)
+      s += visit_dispatch(e);
+    return s;
+  });
+  double c = best([&] { return count_cast(nodes); });
+  double k = best([&] { return count_kind(nodes); });
+
+  double n = nodes.size();
+  std::printf("nodes:             %zu\n", nodes.size());
+  std::printf("apply:             %.2f ns/node\n", a / n * 1e9);
+  std::printf("dispatch:          %.2f ns/node\n", d / n * 1e9);
+  std::printf("dynamic_cast:      %.2f ns/test\n", c / n * 1e9);
+  std::printf("is<T> (kind):      %.2f ns/test\n", k / n * 1e9);
+}
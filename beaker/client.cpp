@@ -0,0 +1,90 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+// The client (beaker-client) forwards a command to the
+// compile server. The commands are:
+//
+//    compile <args>   -- as beaker-compile <args>
+//    check <args>     -- as beaker-compile --check <args>
+//    run <args>       -- as beaker-interpret <args>
+//
+// If no server is running, the corresponding program is
+// executed instead.
+
+#include "config.hpp"
+
+#include "beaker/remote.hpp"
+
+#include <climits>
+#include <iostream>
+
+#include <unistd.h>
+
+
+static void
+usage(std::ostream& os)
+{
+  os << "usage: beaker-client compile|check|run [args...]\n";
+}
+
+
+// Run the command locally.
+static int
+execute(Request& req)
+{
+  std::vector<char*> argv;
+  for (std::string& s : req.args)
+    argv.push_back(&s[0]);
+  argv.push_back(nullptr);
+  ::execvp(argv[0], argv.data());
+  std::cerr << "error: cannot execute '" << req.args[0] << "'\n";
+  return -1;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    usage(std::cerr);
+    return -1;
+  }
+
+  Request req;
+  std::string cmd = argv[1];
+  if (cmd == "compile" || cmd == "check") {
+    req.command = "compile";
+    req.args.push_back("beaker-compile");
+    if (cmd == "check")
+      req.args.push_back("--check");
+  } else if (cmd == "run") {
+    req.command = "run";
+    req.args.push_back("beaker-interpret");
+  } else {
+    usage(std::cerr);
+    return -1;
+  }
+  for (int i = 2; i < argc; ++i)
+    req.args.push_back(argv[i]);
+
+  char cwd[PATH_MAX];
+  if (!::getcwd(cwd, sizeof(cwd))) {
+    std::cerr << "error: cannot determine the current directory\n";
+    return -1;
+  }
+  req.cwd = cwd;
+  req.fds[0] = 0;
+  req.fds[1] = 1;
+  req.fds[2] = 2;
+
+  int fd = connect_socket(default_socket());
+  if (fd < 0)
+    return execute(req);
+
+  int status;
+  if (!send_request(fd, req) || !receive_status(fd, status)) {
+    std::cerr << "error: lost connection to the compile server\n";
+    return -1;
+  }
+  return status;
+}
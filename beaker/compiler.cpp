@@ -9,15 +9,31 @@
 #include "beaker/parser.hpp"
 #include "beaker/decl.hpp"
 #include "beaker/elaborator.hpp"
+#include "beaker/inliner.hpp"
+#include "beaker/specializer.hpp"
+#include "beaker/cse.hpp"
+#include "beaker/effects.hpp"
+#include "beaker/ssa.hpp"
 #include "beaker/generator.hpp"
+#include "beaker/optimizer.hpp"
+#include "beaker/emitter.hpp"
+#include "beaker/object_cache.hpp"
+#include "beaker/interface.hpp"
+#include "beaker/layout.hpp"
+#include "beaker/parse_cache.hpp"
 #include "beaker/error.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <unordered_set>
 
 // FIXME: It would be better if the generator hid all
 // of these details from us.
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 
@@ -36,7 +52,18 @@ struct Config
   bool keep     = false;
   bool assemble = false;
   bool compile  = false;
+  bool check    = false;
+  bool lazy     = false;
+  bool reorder  = false;
+  bool external = false;
+  int jobs      = 1;
+  bool time_jobs = false;
+  bool whole    = false;
   Target target = program_tgt;
+  Opt_level opt = o0_opt;
+
+  // Directories searched for module interfaces.
+  Path_seq import_dirs;
 };
 
 
@@ -48,13 +75,17 @@ usage(std::ostream& os, po::options_description& desc)
 }
 
 
+static bool reuse(Path const&, Decl_set&, Config const&);
 static bool parse(Path const&, Config const&);
-static bool parse(Path_seq const&, Path const&, Config const&);
+static bool parse(Path_seq const&, Path const&, Path_seq&, Config const&);
+static bool import(Decl_set&, Config const&);
+static bool link(llvm::Module*, Path const&);
 
-static bool lower(Path const&, Path const&, Config const&);
-static bool assemble(Path const&, Path const&, Config const&);
-static bool executable(Path_seq const&, Path const&, Config const&);
-static bool module(Path_seq const&, Path const&, Config const&);
+static Path assembled_object(Path const&, std::unordered_set<String>&);
+static Job lower(Path const&, Path const&, Config const&);
+static Job assemble(Path const&, Path const&, Config const&);
+static Job executable(Path_seq const&, Path const&, Config const&);
+static Job module(Path_seq const&, Path const&, Config const&);
 
 
 // Global resources.
@@ -63,11 +94,25 @@ Symbol_table syms; // The symbol table
 Module_decl  mod;  // The translation module
 
 
-int
-compiler_main(int argc, char* argv[])
+// Initialize the global resources. This is done once
+// per process, so that a resident server can do it
+// before handling any requests.
+void
+compiler_init()
 {
+  static bool init = false;
+  if (init)
+    return;
   init_colors();
   init_symbols(syms);
+  init = true;
+}
+
+
+int
+compiler_main(int argc, char* argv[])
+{
+  compiler_init();
 
   po::options_description common_opts("Common options");
   common_opts.add_options()
@@ -86,6 +131,21 @@ compiler_main(int argc, char* argv[])
   compile_opts.add_options()
     ("assemble,s",  po::bool_switch(),  "Compile to native assembly.")
     ("compile,c",   po::bool_switch(),  "Compile but do not link.")
+    ("check",       po::bool_switch(),  "Check the input files but do not translate them.")
+    ("import-path,I", po::value<String_seq>(), "Add a directory to search for module interfaces.")
+    ("reorder-fields", po::bool_switch(), "Reorder record fields to minimize padding.")
+    ("lazy",        po::bool_switch(),  "Elaborate and translate only the functions reachable from main.")
+    ("inline-limit", po::value<int>()->default_value(16), "Inline calls whose cost is at most N (0 disables inlining).")
+    ("specialization-budget", po::value<int>()->default_value(256), "Limit the total size of specialized functions to N (0 disables specialization).")
+    ("jobs,j",      po::value<int>()->default_value(1), "Run up to N elaboration or code generation threads, or external tools, at once.")
+    ("cache-dir",   po::value<String>(), "Reuse object files cached in this directory.")
+    ("cache-size",  po::value<std::uintmax_t>()->default_value(1024), "Limit the cache to N megabytes.")
+    ("cache-stats", po::bool_switch(),  "Print statistics for the cache and exit.")
+    ("time-jobs",   po::bool_switch(),  "Report the wall time of each external tool.")
+    ("whole-program", po::bool_switch(), "Optimize a linked program as a whole.")
+    ("use-llc",     po::bool_switch(),  "Lower IR with llc and the native assembler instead of in-process.")
+    ("optimize,O",  po::value<String>()->default_value("0"),
+     "Set the optimization level (0, 1, 2, 3, or s).")
     ("target,t",    po::value<String>()->default_value("program"),
      "Specify whether a program or module should be produced.");
 
@@ -123,14 +183,72 @@ compiler_main(int argc, char* argv[])
   }
 
   // Check options.
+  if (vm["keep"].as<bool>())
+    conf.keep = true;
+
+  if (vm["use-llc"].as<bool>())
+    conf.external = true;
+
+  conf.jobs = vm["jobs"].as<int>();
+  if (conf.jobs < 1) {
+    std::cerr << "error: invalid number of jobs\n\n";
+    usage(std::cerr, all_opts);
+    return -1;
+  }
+
+  if (vm["whole-program"].as<bool>())
+    conf.whole = true;
+
+  if (vm["time-jobs"].as<bool>())
+    conf.time_jobs = true;
+
   if (vm["compile"].as<bool>())
     conf.compile = true;
 
+  if (vm["check"].as<bool>())
+    conf.check = true;
+
+  if (vm["lazy"].as<bool>())
+    conf.lazy = true;
+
+  // Note that all modules of a program must agree on
+  // the layout of records.
+  conf.reorder = vm["reorder-fields"].as<bool>();
+  reorder_fields(conf.reorder);
+
+  if (vm["inline-limit"].as<int>() < 0) {
+    std::cerr << "error: invalid inline limit\n\n";
+    usage(std::cerr, all_opts);
+    return -1;
+  }
+  inline_limit(vm["inline-limit"].as<int>());
+
+  if (vm["specialization-budget"].as<int>() < 0) {
+    std::cerr << "error: invalid specialization budget\n\n";
+    usage(std::cerr, all_opts);
+    return -1;
+  }
+  specialization_budget(vm["specialization-budget"].as<int>());
+
+  if (!parse_opt_level(vm["optimize"].as<String>(), conf.opt)) {
+    std::cerr << "error: invalid optimization level\n\n";
+    usage(std::cerr, all_opts);
+    return -1;
+  }
+
   if (vm["assemble"].as<bool>()) {
     conf.assemble = true;
     conf.compile = true;
   }
 
+  // Imported modules are found in the current directory,
+  // then in the given directories.
+  conf.import_dirs.push_back(".");
+  if (vm.count("import-path")) {
+    for (String const& s : vm["import-path"].as<String_seq>())
+      conf.import_dirs.push_back(s);
+  }
+
   String t = vm["target"].as<String>();
   if (t == "program") {
     conf.target = program_tgt;
@@ -142,6 +260,38 @@ compiler_main(int argc, char* argv[])
     return -1;
   }
 
+  // Open the object cache, if requested. Failures of the
+  // cache are not failures of the build.
+  std::unique_ptr<Object_cache> cache;
+  if (vm.count("cache-dir")) {
+    try {
+      std::uintmax_t limit = vm["cache-size"].as<std::uintmax_t>() << 20;
+      cache.reset(new Object_cache(vm["cache-dir"].as<String>(), limit));
+    } catch (fs::filesystem_error& err) {
+      std::cerr << "warning: " << err.what() << '\n';
+    }
+  }
+  if (vm["cache-stats"].as<bool>()) {
+    if (!cache) {
+      std::cerr << "error: no cache directory\n\n";
+      usage(std::cerr, all_opts);
+      return -1;
+    }
+    Cache_stats s = cache->stats();
+    std::cout << "hits:    " << s.hits << '\n';
+    std::cout << "misses:  " << s.misses << '\n';
+    std::cout << "entries: " << s.entries << '\n';
+    std::cout << "size:    " << s.bytes << " bytes\n";
+    return 0;
+  }
+
+  // Only a linked program is a whole program.
+  if (conf.whole && (conf.compile || conf.target != program_tgt)) {
+    std::cerr << "error: --whole-program requires a linked program\n\n";
+    usage(std::cerr, all_opts);
+    return -1;
+  }
+
   // Validate the input files.
   if (!vm.count("input")) {
     std::cerr << "error: no input files\n\n";
@@ -163,36 +313,182 @@ compiler_main(int argc, char* argv[])
     output = vm["output"].as<String>();
   }
 
-  // Parse all of the input files into the translation module.
-  //
-  // FIXME: We should collect a set of output files from
-  // parsing since we could potentially pass .ll/.bc/.s/.o
-  // files to the next phase of translation.
-  //
-  // FIXME: Clean up temporary files.
-  Path ir = to_ir_file(output);
-  if (!parse(inputs, ir, conf))
-    return -1;
-
-  Path as = to_asm_file(output);
-  if (!lower(ir, as, conf))
-    return -1;
-  if (conf.assemble)
-    return 0;
+  // Route each input to the stage of translation that
+  // accepts it. Beaker sources, LLVM IR, and bitcode are
+  // translated together into a single object file. Native
+  // assembly is assembled separately. Objects and libraries
+  // go straight to the link.
+  Path_seq sources;
+  Path_seq natives;
+  Path_seq objects;
+  for (Path const& p : inputs) {
+    switch (get_file_kind(p)) {
+      case beaker_file:
+      case ir_file:
+      case bitcode_file:
+        sources.push_back(p);
+        break;
+      case asm_file:
+        natives.push_back(p);
+        break;
+      case object_file:
+      case library_file:
+      case archive_file:
+        objects.push_back(p);
+        break;
+      default:
+        std::cerr << format("error: unknown input file type '{}'\n", p.string());
+        return -1;
+    }
+  }
 
+  // Look for the translation of the sources in the cache.
+  // A cache entry is a single object file, so a translation
+  // that may be cached is not split across jobs.
   Path obj = to_object_file(output);
-  if (!assemble(as, obj, conf))
-    return -1;
-  if (conf.compile)
+  Path iface;
+  if (conf.compile || conf.target == module_tgt)
+    iface = to_interface_file(output);
+  String key;
+  bool cached = false;
+
+  // The cache holds only objects, so it is not used when
+  // intermediate files are kept.
+  if (sources.empty() || conf.check || conf.assemble || conf.external || conf.keep)
+    cache.reset();
+  if (cache) {
+    String opts = format("{} {} {} {} {} {} {} {} {}",
+                         host_triple(),
+                         (int)conf.opt,
+                         conf.whole,
+                         conf.lazy,
+                         vm["reorder-fields"].as<bool>(),
+                         vm["inline-limit"].as<int>(),
+                         vm["specialization-budget"].as<int>(),
+                         (int)conf.target,
+                         conf.compile);
+    try {
+      key = cache->key(sources, opts);
+      cached = cache->get(key, conf.import_dirs, obj, iface);
+    } catch (fs::filesystem_error& err) {
+      std::cerr << "warning: " << err.what() << '\n';
+      cache.reset();
+    }
+  }
+
+  // Translate the sources in-process. This emits object
+  // files (or assembly, with -s) unless external tools are
+  // requested, in which case only the IR file is written.
+  Path ir = to_ir_file(output);
+  Path_seq objs;
+  if (cached) {
+    objs.push_back(obj);
+  } else if (!sources.empty()) {
+    Config c = conf;
+    if (cache)
+      c.jobs = 1;
+    if (!parse(sources, ir, objs, c))
+      return -1;
+    if (cache) {
+      std::vector<String> names;
+      for (Symbol const* n : mod.imports())
+        names.push_back(n->spelling());
+      try {
+        cache->put(key, names, conf.import_dirs, obj, iface);
+      } catch (fs::filesystem_error& err) {
+        std::cerr << "warning: " << err.what() << '\n';
+      }
+    }
+  }
+  if (conf.check)
     return 0;
 
-  // Generate the linked result.
-  if (conf.target == program_tgt)
-    return executable({obj}, output, conf);
-  if (conf.target == module_tgt)
-    return module({obj}, output, conf);
+  // The remaining steps are a graph of external jobs.
+  // Independent jobs run concurrently. Objects assembled
+  // from inputs are written to the current directory, as
+  // a C compiler would, but never over another object of
+  // the build.
+  Job_seq jobs;
+  Path_seq assembled;
+  Path_seq temps;
+  if (!conf.assemble) {
+    std::unordered_set<String> used;
+    for (Path const& p : objs)
+      used.insert(fs::absolute(p).string());
+    for (Path const& p : objects)
+      used.insert(fs::absolute(p).string());
+    used.insert(fs::absolute(obj).string());
+    for (Path const& p : natives) {
+      Path obj = assembled_object(p, used);
+      jobs.push_back(assemble(p, obj, conf));
+      assembled.push_back(obj);
+    }
+  }
+  if (conf.external && !sources.empty()) {
+    Path as = to_asm_file(output);
+    jobs.push_back(lower(ir, as, conf));
+    if (!conf.assemble) {
+      Path obj = to_object_file(output);
+      jobs.push_back(assemble(as, obj, conf));
+      jobs.back().deps.push_back(jobs.size() - 2);
+      objs.push_back(obj);
+      temps.push_back(ir);
+      temps.push_back(as);
+    }
+  }
 
-  return 0;
+  // Link the result after everything else. Archives given
+  // as inputs must follow the objects that use them. The
+  // objects produced for the link are temporary.
+  if (!conf.assemble && !conf.compile) {
+    Path_seq in = objs;
+    in.insert(in.end(), assembled.begin(), assembled.end());
+    in.insert(in.end(), objects.begin(), objects.end());
+    Job job = conf.target == program_tgt
+      ? executable(in, output, conf)
+      : module(in, output, conf);
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+      job.deps.push_back(i);
+    jobs.push_back(job);
+    temps.insert(temps.end(), objs.begin(), objs.end());
+    temps.insert(temps.end(), assembled.begin(), assembled.end());
+  }
+
+  bool ok = run(jobs, conf.jobs);
+  if (conf.time_jobs) {
+    for (Job const& j : jobs) {
+      if (j.status >= 0)
+        std::cerr << j.exec.filename().string() << ": " << j.time << "s\n";
+    }
+  }
+  if (!conf.keep) {
+    for (Path const& p : temps)
+      fs::remove(p);
+  }
+
+  return ok ? 0 : -1;
+}
+
+
+// Reuse the resident server's elaboration of the input
+// file, if it has one. Its declarations are added to the
+// module as reused, so they are declared but not elaborated
+// again. That elaboration did not reorder fields, and it
+// defined every function, so it is not used otherwise.
+bool
+reuse(Path const& in, Decl_set& reused, Config const& conf)
+{
+  Parse_cache* cache = parse_cache();
+  if (!cache || conf.lazy || conf.reorder)
+    return false;
+  Module_decl* m = cache->elaborated(in, locs);
+  if (!m)
+    return false;
+  Decl_seq d(mod.decls_.begin(), mod.decls_.end());
+  d.insert(d.end(), m->decls_.begin(), m->decls_.end());
+  mod.decls_ = Decl_list(d, mod.arena());
+  reused.insert(m->decls_.begin(), m->decls_.end());
+  return true;
 }
 
 
@@ -200,6 +496,18 @@ compiler_main(int argc, char* argv[])
 bool
 parse(Path const& in, Config const& conf)
 {
+  // Reuse the resident server's parse of the file,
+  // and its locations, if it has one.
+  if (Parse_cache* cache = parse_cache()) {
+    if (Module_decl* m = cache->get(in, locs)) {
+      Decl_seq d(mod.decls_.begin(), mod.decls_.end());
+      d.insert(d.end(), m->decls_.begin(), m->decls_.end());
+      mod.decls_ = Decl_list(d, mod.arena());
+      mod.imports_.insert(mod.imports_.end(), m->imports_.begin(), m->imports_.end());
+      return true;
+    }
+  }
+
   try {
     // Read the input source.
     File src = in.c_str();
@@ -207,7 +515,6 @@ parse(Path const& in, Config const& conf)
 
     // Lex the input source.
     Token_stream ts;
-    Location_map locs;
     Lexer lex(syms, buf);
     if (!lex.lex(ts))
       return false;
@@ -233,53 +540,197 @@ parse(Path const& in, Config const& conf)
 
 
 bool
-parse(Path_seq const& in, Path const& out, Config const& conf)
+parse(Path_seq const& in, Path const& out, Path_seq& objs, Config const& conf)
 {
-  bool ok = true;
+  // All nodes are allocated in the module's arena.
+  Arena_sentinel alloc(mod.arena());
+
+  // LLVM IR and bitcode are linked into the generated
+  // module, so that they are optimized along with it.
+  Path_seq parsed;
+  Path_seq linked;
   for (Path const& p : in) {
     if (get_file_kind(p) == beaker_file)
+      parsed.push_back(p);
+    else
+      linked.push_back(p);
+  }
+
+  // A single source may already be elaborated. Such a
+  // source imports nothing.
+  Decl_set imported;
+  if (parsed.size() != 1 || !reuse(parsed.front(), imported, conf)) {
+    bool ok = true;
+    for (Path const& p : parsed)
       ok &= parse(p, conf);
-    else {
-      // FIXME: LLVM IR/BC or assembly could (should?) be
-      // lowered and passed through to the link phase. That
-      // would allow a module to contain native assembly,
-      // and used internally via foreign declarations.
-      std::cerr << "error: unknown input file type\n";
+    if (!ok)
+      return false;
+    if (!import(imported, conf))
       return false;
-    }
   }
-  if (!ok)
-    return false;
 
-  // Elaborate the parse result.
+  // Elaborate the parse result. Imported (and reused)
+  // declarations are already elaborated.
+  //
+  // Only a linked program can omit unreachable functions.
+  // Those of a module may be used by its importers.
   Elaborator elab(locs, syms);
-  elab.elaborate(&mod);
+  elab.threads = conf.jobs;
+  elab.lazy = conf.lazy && !conf.compile && conf.target == program_tgt;
+  elab.elaborate(&mod, imported);
+  if (conf.check)
+    return true;
 
-  // Translate to LLVM.
+  // The front end's optimizations run only when optimizing,
+  // so that -O0 translates the program as it was written.
+  // Specializations are not part of a module's interface.
+  bool opt = conf.opt != o0_opt;
+  if (opt) {
+    inline_calls(&mod);
+    if (!conf.compile && conf.target == program_tgt)
+      specialize_calls(&mod, syms);
+    eliminate_common_subexpressions(&mod);
+  }
+  analyze_effects(&mod);
+  if (opt)
+    lower_module(&mod);
+
+  // A module that is not linked into a program can be
+  // imported by others. Write its interface alongside
+  // the compiled output.
+  if (conf.compile || conf.target == module_tgt)
+    write_interface(&mod, to_interface_file(out));
+
+  // Translate to LLVM, and target the result to the
+  // host before optimizing it.
   Generator gen;
+  gen.internal = conf.whole;
   llvm::Module* ir = gen(&mod);
+  for (Path const& p : linked) {
+    if (!link(ir, p))
+      return false;
+  }
+  std::unique_ptr<Emitter> emit;
+  if (!conf.external) {
+    try {
+      emit.reset(new Emitter(conf.opt));
+    } catch (std::runtime_error& err) {
+      std::cerr << "error: " << err.what() << '\n';
+      return false;
+    }
+    emit->configure(ir);
+  }
+  optimize_module(ir, conf.opt, conf.whole);
+
+  // Write the IR file only if it is kept or lowered by
+  // llc. That file is not the requested output.
+  if (conf.keep || conf.external) {
+    Path p = to_ir_file(out);
+    std::error_code err;
+    llvm::raw_fd_ostream ofs(p.string(), err, llvm::sys::fs::F_None);
+    ofs << *ir;
+  }
+  if (conf.external)
+    return true;
+
+  // Emit assembly for -s, or object files otherwise. The
+  // requested output of -c is a single object file, so
+  // only code for a linked output is split across jobs.
+  if (conf.assemble)
+    return emit->emit(ir, to_asm_file(out), asm_emit);
+  if (conf.jobs > 1 && !conf.compile)
+    return emit->emit(ir, out, conf.jobs, objs);
+  Path obj = to_object_file(out);
+  if (!emit->emit(ir, obj, object_emit))
+    return false;
+  objs.push_back(obj);
+  return true;
+}
 
-  // Write the output to an IR file, not the requested
-  // output. That happens later.
-  Path p = to_ir_file(out);
 
-  // Write the result to the output file.
-  std::error_code err;
-  llvm::raw_fd_ostream ofs(p.string(), err, llvm::sys::fs::F_None);
-  ofs << *ir;
+// Link the LLVM IR or bitcode file into the module. Returns
+// false if the file cannot be read or linked.
+bool
+link(llvm::Module* ir, Path const& p)
+{
+  llvm::SMDiagnostic diag;
+  std::unique_ptr<llvm::Module> m = llvm::parseIRFile(p.string(), diag, ir->getContext());
+  if (!m) {
+    diag.print("beaker-compile", llvm::errs());
+    return false;
+  }
+#if LLVM_VERSION_MAJOR >= 4
+  bool failed = llvm::Linker::linkModules(*ir, std::move(m));
+#else
+  bool failed = llvm::Linker::LinkModules(ir, m.get());
+#endif
+  if (failed) {
+    std::cerr << format("error: cannot link '{}'\n", p.string());
+    return false;
+  }
   return true;
 }
 
 
-// Lower LLVM IR/BC to native assembly.
+// Read the interfaces of the modules imported by the
+// translation module. Imported declarations precede
+// the module's own declarations.
 bool
+import(Decl_set& imported, Config const& conf)
+{
+  Interface_reader reader(syms);
+  std::unordered_set<Symbol const*> seen;
+  Decl_seq ds;
+  try {
+    for (Symbol const* n : mod.imports()) {
+      if (!seen.insert(n).second)
+        continue;
+      Path p = find_interface(n, conf.import_dirs);
+      if (p.empty()) {
+        std::cerr << format("error: no interface for module '{}'\n", *n);
+        return false;
+      }
+      Decl_seq d = reader.read(p);
+      ds.insert(ds.end(), d.begin(), d.end());
+    }
+  } catch (std::runtime_error& err) {
+    std::cerr << "error: " << err.what() << '\n';
+    return false;
+  }
+
+  imported.insert(ds.begin(), ds.end());
+  ds.insert(ds.end(), mod.decls_.begin(), mod.decls_.end());
+  mod.decls_ = Decl_list(ds, mod.arena());
+  return true;
+}
+
+
+// Returns the name of the object file assembled from the
+// input p. This is p's name in the current directory, with
+// an object extension. If that is already used, the name is
+// numbered (e.g., a.1.o). The result is added to used.
+Path
+assembled_object(Path const& p, std::unordered_set<String>& used)
+{
+  Path obj = to_object_file(p.filename());
+  for (int n = 1; used.count(fs::absolute(obj).string()); ++n) {
+    obj = p.filename();
+    obj.replace_extension(format(".{}{}", n, object_extension()));
+  }
+  used.insert(fs::absolute(obj).string());
+  return obj;
+}
+
+
+// Lower LLVM IR/BC to native assembly.
+Job
 lower(Path const& in, Path const& out, Config const& conf)
 {
-  Job job(llvm_compiler(), {
-    format("-o {}", out.string()),
+  return Job(llvm_compiler(), {
+    llc_opt_flag(conf.opt),
+    "-o", out.string(),
     in.string()
   });
-  return job.run();
 }
 
 
@@ -288,15 +739,14 @@ lower(Path const& in, Path const& out, Config const& conf)
 // FIXME: We should be using the native assembler and
 // not a C compiler for this program. Note that we
 // add the "-c" option as a result of this decision.
-bool
+Job
 assemble(Path const& in, Path const& out, Config const& conf)
 {
-  Job job(native_assembler(), {
+  return Job(native_assembler(), {
     "-c",
-    format("-o {}", out.string()),
+    "-o", out.string(),
     in.string()
   });
-  return job.run();
 }
 
 
@@ -305,34 +755,32 @@ assemble(Path const& in, Path const& out, Config const& conf)
 // against the C runtime.
 //
 // TODO: Don't link against the C runtime!
-bool
+Job
 executable(Path_seq const& in, Path const& out, Config const& conf)
 {
   // Build the argument list.
   String_seq args;
-  args.push_back(format("-o {}", out.string()));
+  args.push_back("-o");
+  args.push_back(out.string());
   for (Path const& p : in)
     args.push_back(p.string());
 
-  // Build and run the job.
-  Job job(native_linker(), args);
-  return job.run();
+  return Job(native_linker(), args);
 }
 
 
 // Link a sequence of object files into a shared
 // library.
-bool
+Job
 module(Path_seq const& in, Path const& out, Config const& conf)
 {
   // Build the argument list.
   String_seq args;
   args.push_back("-shared");
-  args.push_back(format("-o {}", out.string()));
+  args.push_back("-o");
+  args.push_back(out.string());
   for (Path const& p : in)
     args.push_back(p.string());
 
-  // Build and run the job.
-  Job job(native_linker(), args);
-  return job.run();
+  return Job(native_linker(), args);
 }
@@ -65,7 +65,7 @@ Expr*
 promote(Expr* e, Type const* t)
 {
   if (get_scalar_rank(t) > get_scalar_rank(e->type()))
-    return new Promote_conv(t, e);
+    return make<Promote_conv>(t, e);
   else
     return e;
 }
@@ -78,7 +78,7 @@ Expr*
 convert_to_value(Expr* e)
 {
   if (Reference_type const* t = as<Reference_type>(e->type()))
-    return new Value_conv(t->nonref(), e);
+    return make<Value_conv>(t->nonref(), e);
   else
     return e;
 }
@@ -90,7 +90,7 @@ Expr*
 convert_to_block(Expr* e)
 {
   if (Array_type const* a = as<Array_type>(e->type()))
-    return new Block_conv(get_block_type(a->type()), e);
+    return make<Block_conv>(get_block_type(a->type()), e);
   else
     return e;
 }
@@ -101,12 +101,64 @@ Expr*
 convert_to_base(Expr* e)
 {
   if (Record_type const* r = as<Record_type>(e->type()->nonref()))
-    return new Base_conv(get_record_type(r->declaration()), e);
+    return make<Base_conv>(get_record_type(r->declaration()), e);
   else
     return e;
 }
 
 
+// Returns the rank of the conversion that convert()
+// would apply to an expression of type s to produce an
+// expression of type t, or no_rank if there is no such
+// conversion. This builds no expressions.
+Conversion_rank
+rank_conversion(Type const* s, Type const* t)
+{
+  if (s == t)
+    return exact_rank;
+
+  // Object-to-value conversion.
+  Type const* c = s;
+  if (!is<Reference_type>(t)) {
+    c = s->nonref();
+    if (c == t)
+      return exact_rank;
+  }
+
+  // Array-to-block conversion.
+  if (is<Block_type>(t)) {
+    if (Array_type const* a = as<Array_type>(c))
+      if (get_block_type(a->type()) == t)
+        return exact_rank;
+  }
+
+  // Conversions to bool are not implemented.
+  if (is<Boolean_type>(t))
+    return no_rank;
+
+  // Type promotion.
+  if (is_scalar(t) && !is<Boolean_type>(s)) {
+    if (get_scalar_rank(t) > get_scalar_rank(s))
+      return promotion_rank;
+    return no_rank;
+  }
+
+  // Derived-to-base conversion.
+  if (Reference_type const* v = as<Reference_type>(t)) {
+    if (Record_type const* goal = as<Record_type>(v->type())) {
+      if (is_derived(c->nonref(), goal)) {
+        Record_type const* d = cast<Record_type>(c->nonref());
+        if (d->declaration() == goal->declaration())
+          return exact_rank;
+        return conversion_rank;
+      }
+    }
+  }
+
+  return no_rank;
+}
+
+
 // Find a conversion from e to t. If no such
 // conversion exists, return nullptr. Diagnostics
 // are better handled in the calling context.
@@ -173,12 +225,13 @@ convert(Expr* e, Type const* t)
         if (goal->declaration() == d->declaration()) {
           return ret;
         } else {
-          ret->path_.push_back(0);
+          std::vector<int> path {0};
           Record_decl* decl = d->declaration();
           while (decl && decl != goal->declaration()) {
-            ret->path_.push_back(0);
+            path.push_back(0);
             decl = decl->base()->declaration();
           }
+          ret->path_ = Base_conv::Method_path(path);
           return ret;
         }
       }
@@ -12,6 +12,21 @@
 
 class Elaborator;
 
+
+// The rank of an implicit conversion. Lower ranks are
+// better. Value and array-to-block conversions are as
+// good as an exact match.
+enum Conversion_rank
+{
+  exact_rank,
+  promotion_rank,
+  conversion_rank,
+  no_rank,
+};
+
+
+Conversion_rank rank_conversion(Type const*, Type const*);
+
 Expr*    convert(Expr*, Type const*);
 Expr_seq convert(Expr_seq const&, Type_seq const&);
 
@@ -0,0 +1,334 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/cse.hpp"
+#include "beaker/hash.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/decl.hpp"
+#include "beaker/stmt.hpp"
+
+#include <utility>
+
+
+namespace
+{
+
+// Hashes expressions through a cache. Operands are visited
+// before the expressions that contain them, so each node is
+// hashed only once.
+struct Cached_hash
+{
+  std::size_t operator()(Expr const* e) const { return hash_value(e, *cache); }
+
+  Expr_hash_cache* cache;
+};
+
+
+// The common subexpression eliminator maintains a table
+// of expressions available in the current basic block.
+struct Eliminator
+{
+  using Table = std::unordered_map<Expr const*, Expr*, Cached_hash, Equal_fn<Expr>>;
+
+  Eliminator()
+    : avail(0, Cached_hash{&hashes})
+  { }
+
+  struct Block_sentinel;
+
+  bool expr(Expr*&);
+  void stmt(Stmt*);
+  void decl(Decl*);
+
+  Expr_hash_cache hashes;
+  Table           avail;
+};
+
+
+// An RAII class that begins a new basic block. The
+// expressions available in the enclosing block are
+// restored on exit.
+struct Eliminator::Block_sentinel
+{
+  Block_sentinel(Eliminator& e)
+    : elim(e), saved(0, e.avail.hash_function())
+  {
+    std::swap(saved, elim.avail);
+  }
+
+  ~Block_sentinel()
+  {
+    std::swap(saved, elim.avail);
+  }
+
+  Eliminator& elim;
+  Table       saved;
+};
+
+
+// Returns true if an expression of kind k is worth
+// sharing. Literals and references to declarations
+// are cheaper to recompute than to look up.
+inline bool
+is_shareable(Expr_kind k)
+{
+  return k != literal_expr && k != decl_expr;
+}
+
+
+// Eliminate common subexpressions within the operands
+// of an expression. Returns true when the expression
+// is free of side effects.
+struct Expr_fn
+{
+  Eliminator& elim;
+
+  bool operator()(Literal_expr* e) { return true; }
+  bool operator()(Decl_expr* e)    { return true; }
+
+  // Unresolved expressions are never shared.
+  bool operator()(Id_expr* e)     { return false; }
+  bool operator()(Lambda_expr* e) { return false; }
+  bool operator()(Dot_expr* e)    { return false; }
+
+  bool operator()(Unary_expr* e)
+  {
+    return elim.expr(e->first);
+  }
+
+  bool operator()(Binary_expr* e)
+  {
+    bool p1 = elim.expr(e->first);
+    bool p2 = elim.expr(e->second);
+    return p1 && p2;
+  }
+
+  // The right operand of a logical operator is evaluated
+  // conditionally, so it begins a new block.
+  bool logical(Binary_expr* e)
+  {
+    bool p1 = elim.expr(e->first);
+    Eliminator::Block_sentinel block(elim);
+    bool p2 = elim.expr(e->second);
+    return p1 && p2;
+  }
+
+  bool operator()(And_expr* e) { return logical(e); }
+  bool operator()(Or_expr* e)  { return logical(e); }
+
+  // A call may modify any object.
+  bool operator()(Call_expr* e)
+  {
+    for (Expr*& a : e->arguments())
+      elim.expr(a);
+    return false;
+  }
+
+  bool operator()(Field_expr* e)
+  {
+    return elim.expr(e->first);
+  }
+
+  bool operator()(Method_expr* e)
+  {
+    elim.expr(e->first);
+    return false;
+  }
+
+  bool operator()(Index_expr* e)
+  {
+    bool p1 = elim.expr(e->first);
+    bool p2 = elim.expr(e->second);
+    return p1 && p2;
+  }
+
+  bool operator()(Conv* e)
+  {
+    return elim.expr(e->first);
+  }
+
+  // Initializers are evaluated on uninitialized
+  // objects. They are never shared.
+  bool operator()(Default_init* e) { return false; }
+  bool operator()(Trivial_init* e) { return false; }
+
+  bool operator()(Copy_init* e)
+  {
+    elim.expr(e->first);
+    return false;
+  }
+
+  bool operator()(Reference_init* e)
+  {
+    elim.expr(e->first);
+    return false;
+  }
+};
+
+
+// Eliminate common subexpressions in e. If e is free of
+// side effects and an equal expression is available, e is
+// replaced by that expression. Otherwise, e becomes
+// available. Returns true when e is free of side effects.
+//
+// Note that operands are processed before e, so equal
+// operands have already been replaced by the same node.
+bool
+Eliminator::expr(Expr*& e)
+{
+  if (!e)
+    return true;
+  bool pure = dispatch(e, Expr_fn{*this});
+  if (pure && is_shareable(e->kind())) {
+    auto ins = avail.emplace(e, e);
+    if (!ins.second) {
+      e = ins.first->second;
+      e->share();
+    }
+  }
+  return pure;
+}
+
+
+// Eliminate common subexpressions within a statement.
+// Control flow ends the current basic block, so the
+// set of available expressions is discarded.
+void
+Eliminator::stmt(Stmt* s)
+{
+  struct Fn
+  {
+    Eliminator& elim;
+
+    void operator()(Empty_stmt* s) { }
+
+    void operator()(Block_stmt* s)
+    {
+      for (Stmt* s1 : s->first)
+        elim.stmt(s1);
+    }
+
+    void operator()(Assign_stmt* s)
+    {
+      elim.expr(s->first);
+      elim.expr(s->second);
+    }
+
+    void operator()(Return_stmt* s)
+    {
+      elim.expr(s->first);
+      elim.avail.clear();
+    }
+
+    void operator()(If_then_stmt* s)
+    {
+      elim.expr(s->first);
+      {
+        Eliminator::Block_sentinel block(elim);
+        elim.stmt(s->second);
+      }
+      elim.avail.clear();
+    }
+
+    void operator()(If_else_stmt* s)
+    {
+      elim.expr(s->first);
+      {
+        Eliminator::Block_sentinel block(elim);
+        elim.stmt(s->second);
+      }
+      {
+        Eliminator::Block_sentinel block(elim);
+        elim.stmt(s->third);
+      }
+      elim.avail.clear();
+    }
+
+    // The condition of a loop is evaluated in its own
+    // block, on each iteration.
+    void operator()(While_stmt* s)
+    {
+      {
+        Eliminator::Block_sentinel block(elim);
+        elim.expr(s->first);
+      }
+      {
+        Eliminator::Block_sentinel block(elim);
+        elim.stmt(s->second);
+      }
+      elim.avail.clear();
+    }
+
+    void operator()(Break_stmt* s)    { elim.avail.clear(); }
+    void operator()(Continue_stmt* s) { elim.avail.clear(); }
+
+    void operator()(Expression_stmt* s)
+    {
+      elim.expr(s->first);
+    }
+
+    void operator()(Declaration_stmt* s)
+    {
+      elim.decl(s->first);
+    }
+  };
+
+  dispatch(s, Fn{*this});
+}
+
+
+// Eliminate common subexpressions within a declaration.
+// Each function definition and global initializer is
+// analyzed separately.
+void
+Eliminator::decl(Decl* d)
+{
+  struct Fn
+  {
+    Eliminator& elim;
+
+    void operator()(Variable_decl* d)
+    {
+      elim.expr(d->init_);
+    }
+
+    void operator()(Function_decl* d)
+    {
+      if (d->body()) {
+        Eliminator::Block_sentinel block(elim);
+        elim.stmt(d->body());
+      }
+    }
+
+    void operator()(Parameter_decl* d) { }
+    void operator()(Field_decl* d)     { }
+
+    void operator()(Record_decl* d)
+    {
+      for (Decl* m : d->members())
+        elim.decl(m);
+    }
+
+    void operator()(Module_decl* d)
+    {
+      for (Decl* d1 : d->declarations()) {
+        Eliminator::Block_sentinel block(elim);
+        elim.decl(d1);
+      }
+    }
+  };
+
+  dispatch(d, Fn{*this});
+}
+
+} // namespace
+
+
+void
+eliminate_common_subexpressions(Decl* d)
+{
+  Eliminator elim;
+  elim.decl(d);
+}
@@ -0,0 +1,22 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_CSE_HPP
+#define BEAKER_CSE_HPP
+
+// Common subexpression elimination.
+//
+// Within a basic block, every occurrence of a side-effect
+// free subexpression that is structurally equal to an
+// earlier one is replaced by that earlier expression, which
+// is then marked as shared. The evaluator and the code
+// generator reuse the value of a shared expression until
+// an assignment or call might change it.
+
+#include <beaker/prelude.hpp>
+
+
+void eliminate_common_subexpressions(Decl*);
+
+
+#endif
@@ -25,7 +25,7 @@ Function_decl::return_type() const
 int
 Field_decl::index() const
 {
-  Decl_seq const& f = context()->fields();
+  Decl_list const& f = context()->fields();
   for (std::size_t i = 0; i < f.size(); ++i)
     if (f[i] == this)
       return i;
@@ -62,7 +62,7 @@ Record_decl::is_empty() const
   // If a base class is non-empty, then this class
   // is non-empty.
   if (Record_decl const* b = base_declaration())
-    if (b->is_empty())
+    if (!b->is_empty())
       return false;
 
   // An empty base class has no fields.
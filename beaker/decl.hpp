@@ -9,6 +9,26 @@
 #include <beaker/specifier.hpp>
 #include <beaker/type.hpp>
 
+#include <forward_list>
+
+
+struct Layout;
+struct Effects;
+struct Ssa_function;
+
+
+// The kinds of declarations.
+enum Decl_kind : unsigned char
+{
+  variable_decl,
+  function_decl,
+  method_decl,
+  parameter_decl,
+  record_decl,
+  field_decl,
+  module_decl,
+};
+
 
 // Represents the declaration of a named entity.
 // Every declaration has a name and a type. Note that
@@ -20,12 +40,12 @@ struct Decl
   struct Visitor;
   struct Mutator;
 
-  Decl(Symbol const* s, Type const* t)
-    : spec_(no_spec), name_(s), type_(t), cxt_(nullptr)
+  Decl(Decl_kind k, Symbol const* s, Type const* t)
+    : kind_(k), spec_(no_spec), name_(s), type_(t), cxt_(nullptr)
   { }
 
-  Decl(Specifier spec, Symbol const* s, Type const* t)
-    : spec_(spec), name_(s), type_(t), cxt_(nullptr)
+  Decl(Decl_kind k, Specifier spec, Symbol const* s, Type const* t)
+    : kind_(k), spec_(spec), name_(s), type_(t), cxt_(nullptr)
   { }
 
   virtual ~Decl() { }
@@ -33,9 +53,12 @@ struct Decl
   virtual void accept(Visitor&) const = 0;
   virtual void accept(Mutator&) = 0;
 
+  Decl_kind kind() const { return kind_; }
+
   // Declaration specifiers
   Specifier specifiers() const { return spec_; }
   bool      is_foreign() const { return spec_ & foreign_spec; }
+  bool      is_imported() const { return spec_ & imported_spec; }
 
   Symbol const* name() const { return name_; }
   Type const*   type() const { return type_; }
@@ -49,6 +72,7 @@ struct Decl
   bool is_abstract() const { return spec_ & abstract_spec; }
   bool is_polymorphic() const { return is_virtual() || is_abstract(); }
 
+  Decl_kind     kind_;
   Specifier     spec_;
   Symbol const* name_;
   Type const*   type_;
@@ -85,12 +109,14 @@ struct Decl::Mutator
 // Represents variable declarations.
 struct Variable_decl : Decl
 {
+  static constexpr Decl_kind node_kind = variable_decl;
+
   Variable_decl(Symbol const* n, Type const* t, Expr* e)
-    : Decl(n, t), init_(e)
+    : Decl(node_kind, n, t), init_(e)
   { }
 
   Variable_decl(Specifier spec, Symbol const* n, Type const* t, Expr* e)
-    : Decl(spec, n, t), init_(e)
+    : Decl(node_kind, spec, n, t), init_(e)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -106,18 +132,24 @@ struct Variable_decl : Decl
 // Represents function declarations.
 struct Function_decl : Decl
 {
+  static constexpr Decl_kind node_kind = function_decl;
+
   Function_decl(Symbol const* n, Type const* t, Decl_seq const& p, Stmt* b)
-    : Decl(n, t), parms_(p), body_(b)
+    : Function_decl(node_kind, no_spec, n, t, p, b)
   { }
 
   Function_decl(Specifier spec, Symbol const* n, Type const* t, Decl_seq const& p, Stmt* b)
-    : Decl(spec, n, t), parms_(p), body_(b)
+    : Function_decl(node_kind, spec, n, t, p, b)
+  { }
+
+  Function_decl(Decl_kind k, Specifier spec, Symbol const* n, Type const* t, Decl_seq const& p, Stmt* b)
+    : Decl(k, spec, n, t), parms_(p), body_(b), vparms_(nullptr), effects_(nullptr), ssa_(nullptr)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
-  Decl_seq const& parameters() const         { return parms_; }
+  Decl_list const& parameters() const        { return parms_; }
   Decl_seq const* virtual_parameters() const { return vparms_; }
   Decl_seq*       virtual_parameters()       { return vparms_; }
 
@@ -127,9 +159,15 @@ struct Function_decl : Decl
   Stmt const* body() const { return body_; }
   Stmt*       body()       { return body_; }
 
-  Decl_seq  parms_;
+  Decl_list parms_;
   Stmt*     body_;
   Decl_seq* vparms_;
+
+  // Inferred by effect analysis.
+  mutable Effects* effects_;
+
+  // The SSA form of the definition, if it can be lowered.
+  Ssa_function* ssa_;
 };
 
 
@@ -140,7 +178,15 @@ struct Function_decl : Decl
 // its index?
 struct Parameter_decl : Decl
 {
-  using Decl::Decl;
+  static constexpr Decl_kind node_kind = parameter_decl;
+
+  Parameter_decl(Symbol const* n, Type const* t)
+    : Decl(node_kind, n, t)
+  { }
+
+  Parameter_decl(Specifier spec, Symbol const* n, Type const* t)
+    : Decl(node_kind, spec, n, t)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -160,9 +206,11 @@ struct Parameter_decl : Decl
 // member lookup.
 struct Record_decl : Decl
 {
+  static constexpr Decl_kind node_kind = record_decl;
+
   Record_decl(Symbol const* n, Decl_seq const& f, Decl_seq const& m, Type const* base)
-    : Decl(n, nullptr), scope_(this), fields_(f), members_(m)
-    , base_(base), vref_(nullptr), vtbl_(nullptr)
+    : Decl(node_kind, n, nullptr), scope_(this), fields_(f), members_(m)
+    , base_(base), vref_(nullptr), vtbl_(nullptr), layout_(nullptr)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -171,8 +219,8 @@ struct Record_decl : Decl
   Record_type const* base() const;
   Record_decl*       base_declaration() const;
 
-  Decl_seq const& fields() const  { return fields_; }
-  Decl_seq const& members() const { return members_; }
+  Decl_list const& fields() const  { return fields_; }
+  Decl_list const& members() const { return members_; }
 
   Scope const*    scope() const { return &scope_; }
   Scope*          scope()       { return &scope_; }
@@ -186,11 +234,15 @@ struct Record_decl : Decl
   bool is_empty() const;
 
   Scope          scope_;
-  Decl_seq       fields_;
-  Decl_seq       members_;
+  Decl_list      fields_;
+  Decl_list      members_;
   const Type*    base_;
   Decl*          vref_;
   Decl_seq*      vtbl_;
+
+  // The layout of the record, computed on first use
+  // (see layout.hpp).
+  mutable Layout* layout_;
 };
 
 
@@ -199,7 +251,15 @@ struct Record_decl : Decl
 // TODO: Cache the field index?
 struct Field_decl : Decl
 {
-  using Decl::Decl;
+  static constexpr Decl_kind node_kind = field_decl;
+
+  Field_decl(Symbol const* n, Type const* t)
+    : Decl(node_kind, n, t)
+  { }
+
+  Field_decl(Specifier spec, Symbol const* n, Type const* t)
+    : Decl(node_kind, spec, n, t)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -215,7 +275,15 @@ struct Field_decl : Decl
 // type is T&.
 struct Method_decl : Function_decl
 {
-  using Function_decl::Function_decl;
+  static constexpr Decl_kind node_kind = method_decl;
+
+  Method_decl(Symbol const* n, Type const* t, Decl_seq const& p, Stmt* b)
+    : Function_decl(node_kind, no_spec, n, t, p, b)
+  { }
+
+  Method_decl(Specifier spec, Symbol const* n, Type const* t, Decl_seq const& p, Stmt* b)
+    : Function_decl(node_kind, spec, n, t, p, b)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -231,25 +299,56 @@ struct Method_decl : Function_decl
 
 
 // A module is a sequence of top-level declarations.
+// The names of the modules that it imports are kept
+// separately; they are resolved by the compiler.
+//
+// The module owns the arena from which the nodes of
+// its translation are allocated. Those nodes are
+// released with the module. Threads that allocate
+// nodes concurrently use additional arenas, which are
+// also owned by the module.
 struct Module_decl : Decl
 {
+  static constexpr Decl_kind node_kind = module_decl;
+
   Module_decl()
-    : Decl(nullptr, nullptr)
+    : Decl(node_kind, nullptr, nullptr)
   { }
 
   Module_decl(Symbol const* n, Decl_seq const& d)
-    : Decl(n, nullptr), decls_(d)
+    : Decl(node_kind, n, nullptr), decls_(d, arena_)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
-  Decl_seq const& declarations() const { return decls_; }
+  Decl_list const& declarations() const { return decls_; }
+
+  std::vector<Symbol const*> const& imports() const { return imports_; }
+
+  Arena&       arena()       { return arena_; }
+  Arena const& arena() const { return arena_; }
+  Arena&       make_arena();
+
+  Arena     arena_;
+  Decl_list decls_;
+
+  std::vector<Symbol const*> imports_;
 
-  Decl_seq decls_;
+  std::forward_list<Arena> arenas_; // Additional arenas
 };
 
 
+// Create a new arena, owned by the module. This is not
+// safe to call concurrently.
+inline Arena&
+Module_decl::make_arena()
+{
+  arenas_.emplace_front();
+  return arenas_.front();
+}
+
+
 // -------------------------------------------------------------------------- //
 // Queries
 
@@ -346,4 +445,97 @@ apply(Decl* d, F fn)
   return accept(d, v);
 }
 
+// -------------------------------------------------------------------------- //
+// Kind dispatch
+
+// The range of kinds of declarations of type T. This is
+// specialized for declarations that have derived declarations.
+template<typename T>
+struct Decl_kinds
+{
+  static constexpr Decl_kind first = T::node_kind;
+  static constexpr Decl_kind last  = T::node_kind;
+};
+
+template<>
+struct Decl_kinds<Decl>
+{
+  static constexpr Decl_kind first = variable_decl;
+  static constexpr Decl_kind last  = module_decl;
+};
+
+template<>
+struct Decl_kinds<Function_decl>
+{
+  static constexpr Decl_kind first = function_decl;
+  static constexpr Decl_kind last  = method_decl;
+};
+
+
+// Returns true if d is a declaration of type T. This is a
+// comparison of kinds and does not require a dynamic cast.
+template<typename T>
+inline bool
+is(Decl const* d)
+{
+  using R = Decl_kinds<T>;
+  return d && R::first <= d->kind() && d->kind() <= R::last;
+}
+
+
+// Returns d as a declaration of type T, or nullptr if d
+// is not a T.
+template<typename T>
+inline T*
+as(Decl* d)
+{
+  return is<T>(d) ? static_cast<T*>(d) : nullptr;
+}
+
+
+template<typename T>
+inline T const*
+as(Decl const* d)
+{
+  return is<T>(d) ? static_cast<T const*>(d) : nullptr;
+}
+
+
+// Apply fn to d, dispatching on its kind. This has the
+// same effect as apply(), but selects the function with
+// a single switch instead of calling through a visitor.
+template<typename F, typename T = typename std::result_of<F(Variable_decl const*)>::type>
+inline T
+dispatch(Decl const* d, F fn)
+{
+  switch (d->kind()) {
+    case variable_decl: return fn(static_cast<Variable_decl const*>(d));
+    case function_decl: return fn(static_cast<Function_decl const*>(d));
+    case method_decl: return fn(static_cast<Method_decl const*>(d));
+    case parameter_decl: return fn(static_cast<Parameter_decl const*>(d));
+    case record_decl: return fn(static_cast<Record_decl const*>(d));
+    case field_decl: return fn(static_cast<Field_decl const*>(d));
+    case module_decl: return fn(static_cast<Module_decl const*>(d));
+  }
+  lingo_unreachable();
+}
+
+
+template<typename F, typename T = typename std::result_of<F(Variable_decl*)>::type>
+inline T
+dispatch(Decl* d, F fn)
+{
+  switch (d->kind()) {
+    case variable_decl: return fn(static_cast<Variable_decl*>(d));
+    case function_decl: return fn(static_cast<Function_decl*>(d));
+    case method_decl: return fn(static_cast<Method_decl*>(d));
+    case parameter_decl: return fn(static_cast<Parameter_decl*>(d));
+    case record_decl: return fn(static_cast<Record_decl*>(d));
+    case field_decl: return fn(static_cast<Field_decl*>(d));
+    case module_decl: return fn(static_cast<Module_decl*>(d));
+  }
+  lingo_unreachable();
+}
+
+
 #endif
@@ -0,0 +1,508 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/effects.hpp"
+#include "beaker/type.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/stmt.hpp"
+#include "beaker/decl.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace
+{
+
+// The effects of a function that is not analyzed.
+Effects const unknown_;
+
+
+// The root of an object is the object that it is part of,
+// or the referent of the reference parameter through which
+// it is accessed (given as the parameter's index).
+constexpr int local_root    = -1; // An object of the function
+constexpr int nonlocal_root = -2; // Any other object
+
+
+// A call that passes a reference argument to a reference
+// parameter of the callee.
+struct Pass
+{
+  Function_decl const* callee;
+  std::size_t          parm;
+  int                  root;
+};
+
+
+// The effects of a function definition, excluding those of
+// the functions it calls.
+struct Summary
+{
+  Summary(Function_decl* f)
+    : fn(f), capture(f->parameters().size())
+  {
+    for (std::size_t i = 0; i < capture.size(); ++i)
+      capture[i] = !is<Reference_type>(f->parameters()[i]->type());
+  }
+
+  void expr(Expr const*);
+  void call(Call_expr const*);
+  void access(Expr const*);
+  void read(Expr const*);
+  void write(Expr const*);
+  void escape(Expr const*);
+  void stmt(Stmt const*);
+  void init(Expr const*);
+
+  int root(Expr const*) const;
+  int parm(Decl const*) const;
+  void touch(int, bool&);
+
+  Function_decl* fn;
+  bool           reads   = false;
+  bool           writes  = false;
+  bool           loops   = false;
+  bool           unknown = false; // Calls an unknown function
+
+  std::vector<bool>                 capture;
+  std::vector<Function_decl const*> callees;
+  std::vector<Pass>                 passes;
+};
+
+
+// Returns the index of the parameter p.
+int
+Summary::parm(Decl const* p) const
+{
+  Decl_list const& ps = fn->parameters();
+  return std::find(ps.begin(), ps.end(), p) - ps.begin();
+}
+
+
+// Returns the root of the object designated by e.
+int
+Summary::root(Expr const* e) const
+{
+  if (Decl_expr const* d = as<Decl_expr>(e)) {
+    Decl const* v = d->declaration();
+    if (is<Reference_type>(v->type()))
+      return is<Parameter_decl>(v) ? parm(v) : nonlocal_root;
+    if (Variable_decl const* var = as<Variable_decl>(v))
+      if (is_global_variable(var))
+        return nonlocal_root;
+    return local_root;
+  }
+  if (Dot_expr const* d = as<Dot_expr>(e))
+    return root(d->container());
+  if (Base_conv const* c = as<Base_conv>(e))
+    return root(c->source());
+  if (Index_expr const* x = as<Index_expr>(e))
+    if (is<Array_type>(x->array()->type()->nonref()))
+      return root(x->array());
+  return nonlocal_root;
+}
+
+
+// Record an access to an object with the given root.
+void
+Summary::touch(int r, bool& flag)
+{
+  if (r != local_root)
+    flag = true;
+}
+
+
+// Analyze the operands of an object expression that are
+// not part of the object's path.
+void
+Summary::access(Expr const* e)
+{
+  if (is<Decl_expr>(e))
+    return;
+  if (Dot_expr const* d = as<Dot_expr>(e))
+    return access(d->container());
+  if (Base_conv const* c = as<Base_conv>(e))
+    return access(c->source());
+  if (Index_expr const* x = as<Index_expr>(e)) {
+    if (is<Array_type>(x->array()->type()->nonref()))
+      access(x->array());
+    else
+      expr(x->array());
+    return expr(x->index());
+  }
+  if (Call_expr const* c = as<Call_expr>(e))
+    return call(c);
+  unknown = true;
+}
+
+
+void
+Summary::read(Expr const* e)
+{
+  touch(root(e), reads);
+  access(e);
+}
+
+
+void
+Summary::write(Expr const* e)
+{
+  touch(root(e), writes);
+  access(e);
+}
+
+
+// The address of the object designated by e may outlive
+// the function, and its referent may be accessed in any
+// way.
+void
+Summary::escape(Expr const* e)
+{
+  int r = root(e);
+  if (r >= 0)
+    capture[r] = true;
+  touch(r, reads);
+  touch(r, writes);
+  access(e);
+}
+
+
+// Analyze an expression whose value is computed. An
+// expression of reference type designates an object,
+// whose address is the value.
+void
+Summary::expr(Expr const* e)
+{
+  if (!e)
+    return;
+  if (Call_expr const* c = as<Call_expr>(e))
+    return call(c);
+  if (is<Reference_type>(e->type()))
+    return escape(e);
+
+  struct Fn
+  {
+    Summary& s;
+
+    void operator()(Literal_expr const* e) { }
+    void operator()(Decl_expr const* e)    { }
+
+    // These do not appear in elaborated definitions.
+    void operator()(Id_expr const* e)     { s.unknown = true; }
+    void operator()(Lambda_expr const* e) { s.unknown = true; }
+    void operator()(Dot_expr const* e)    { s.unknown = true; }
+    void operator()(Init const* e)        { s.unknown = true; }
+
+    void operator()(Unary_expr const* e)  { s.expr(e->operand()); }
+
+    void operator()(Binary_expr const* e)
+    {
+      s.expr(e->left());
+      s.expr(e->right());
+    }
+
+    void operator()(Call_expr const* e) { s.call(e); }
+
+    void operator()(Index_expr const* e)
+    {
+      s.expr(e->array());
+      s.expr(e->index());
+    }
+
+    void operator()(Value_conv const* e) { s.read(e->source()); }
+    void operator()(Block_conv const* e) { s.escape(e->source()); }
+    void operator()(Conv const* e)       { s.expr(e->source()); }
+  };
+  dispatch(e, Fn{*this});
+}
+
+
+// A call to an unknown function may do anything with its
+// arguments. A direct call passes reference arguments to
+// the callee, whose effects are not yet known.
+void
+Summary::call(Call_expr const* e)
+{
+  Function_decl const* f = get_callee(e);
+  if (!f) {
+    unknown = true;
+    expr(e->target());
+    for (Expr const* a : e->arguments())
+      expr(a);
+    return;
+  }
+
+  callees.push_back(f);
+  Decl_list const& ps = f->parameters();
+  Expr_list const& args = e->arguments();
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    Expr const* a = args[i];
+    if (i < ps.size() && is<Reference_type>(ps[i]->type()) && is<Reference_type>(a->type())) {
+      passes.push_back({f, i, root(a)});
+      access(a);
+    } else {
+      expr(a);
+    }
+  }
+}
+
+
+void
+Summary::init(Expr const* e)
+{
+  if (Copy_init const* c = as<Copy_init>(e))
+    expr(c->value());
+  else if (Reference_init const* r = as<Reference_init>(e))
+    escape(r->object());
+}
+
+
+void
+Summary::stmt(Stmt const* s)
+{
+  struct Fn
+  {
+    Summary& sum;
+
+    void operator()(Empty_stmt const* s) { }
+
+    void operator()(Block_stmt const* s)
+    {
+      for (Stmt const* s1 : s->statements())
+        sum.stmt(s1);
+    }
+
+    void operator()(Assign_stmt const* s)
+    {
+      sum.write(s->object());
+      sum.expr(s->value());
+    }
+
+    void operator()(Return_stmt const* s)
+    {
+      sum.expr(s->value());
+    }
+
+    void operator()(If_then_stmt const* s)
+    {
+      sum.expr(s->condition());
+      sum.stmt(s->body());
+    }
+
+    void operator()(If_else_stmt const* s)
+    {
+      sum.expr(s->condition());
+      sum.stmt(s->true_branch());
+      sum.stmt(s->false_branch());
+    }
+
+    // We can't show that a loop terminates.
+    void operator()(While_stmt const* s)
+    {
+      sum.loops = true;
+      sum.expr(s->condition());
+      sum.stmt(s->body());
+    }
+
+    void operator()(Break_stmt const* s)    { }
+    void operator()(Continue_stmt const* s) { }
+
+    void operator()(Expression_stmt const* s)
+    {
+      sum.expr(s->expression());
+    }
+
+    void operator()(Declaration_stmt const* s)
+    {
+      if (Variable_decl const* v = as<Variable_decl>(s->declaration()))
+        sum.init(v->init());
+    }
+  };
+  dispatch(s, Fn{*this});
+}
+
+
+// Propagates effects through the call graph. The strongly
+// connected components of the graph are found by Tarjan's
+// algorithm, which produces each component after those it
+// calls. The functions of a component call each other, so
+// they have the same effects (except for captures).
+struct Solver
+{
+  void visit(Summary*);
+  void solve(std::vector<Summary*> const&);
+
+  std::unordered_map<Function_decl const*, Summary*> sums;
+  std::unordered_map<Summary*, int> index;
+  std::unordered_map<Summary*, int> low;
+  std::vector<Summary*>             stack;
+  std::vector<bool>                 stacked;
+  int                               count = 0;
+};
+
+
+void
+Solver::visit(Summary* s)
+{
+  int n = count++;
+  index[s] = low[s] = n;
+  stack.push_back(s);
+  stacked.push_back(true);
+
+  for (Function_decl const* f : s->callees) {
+    auto iter = sums.find(f);
+    if (iter == sums.end())
+      continue;
+    Summary* c = iter->second;
+    auto ix = index.find(c);
+    if (ix == index.end()) {
+      visit(c);
+      low[s] = std::min(low[s], low[c]);
+    } else if (stacked[ix->second]) {
+      low[s] = std::min(low[s], ix->second);
+    }
+  }
+
+  if (low[s] == n) {
+    std::vector<Summary*> scc;
+    Summary* c;
+    do {
+      c = stack.back();
+      stack.pop_back();
+      stacked[index[c]] = false;
+      scc.push_back(c);
+    } while (c != s);
+    solve(scc);
+  }
+}
+
+
+// Compute the effects of the functions in a component.
+// The effects of the functions they call outside the
+// component are known.
+void
+Solver::solve(std::vector<Summary*> const& scc)
+{
+  Effects e;
+  e.reads = e.writes = e.unwinds = false;
+  e.recurses = scc.size() > 1;
+  e.returns = true;
+
+  auto inside = [&scc](Function_decl const* f) {
+    return std::any_of(scc.begin(), scc.end(), [f](Summary* s) { return s->fn == f; });
+  };
+
+  for (Summary* s : scc) {
+    if (s->unknown) {
+      e = Effects();
+      break;
+    }
+    e.reads |= s->reads;
+    e.writes |= s->writes;
+    e.returns &= !s->loops;
+    for (Function_decl const* f : s->callees) {
+      if (inside(f)) {
+        e.recurses = true;
+        continue;
+      }
+      Effects const& c = get_effects(f);
+      e.reads |= c.reads;
+      e.writes |= c.writes;
+      e.unwinds |= c.unwinds;
+      e.recurses |= c.recurses;
+      e.returns &= c.returns;
+    }
+  }
+  e.returns &= !e.recurses;
+
+  // Parameters passed to capturing parameters within
+  // the component are captured.
+  for (Summary* s : scc) {
+    Effects* fe = make<Effects>(e);
+    fe->capture = s->capture;
+    s->fn->effects_ = fe;
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Summary* s : scc) {
+      std::vector<bool>& cap = s->fn->effects_->capture;
+      for (Pass const& p : s->passes) {
+        if (p.root >= 0 && !cap[p.root] && get_effects(p.callee).captures(p.parm)) {
+          cap[p.root] = true;
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+
+// Infer the effects of each function defined in the
+// module m. The results are allocated in the module's
+// arena.
+void
+analyze_effects(Module_decl* m)
+{
+  Arena_sentinel alloc(m->arena());
+
+  std::vector<Summary> sums;
+  for (Decl* d : m->declarations()) {
+    if (Function_decl* f = as<Function_decl>(d))
+      if (f->body())
+        sums.emplace_back(f);
+    if (Record_decl* r = as<Record_decl>(d))
+      for (Decl* d1 : r->members())
+        if (Method_decl* f = as<Method_decl>(d1))
+          if (f->body())
+            sums.emplace_back(f);
+  }
+
+  Solver solver;
+  for (Summary& s : sums) {
+    s.fn->effects_ = nullptr;
+    s.stmt(s.fn->body());
+    solver.sums.emplace(s.fn, &s);
+  }
+  for (Summary& s : sums)
+    if (!solver.index.count(&s))
+      solver.visit(&s);
+}
+
+
+// Returns the function called by e, if it is called
+// directly. Virtual functions and multimethods are
+// called indirectly.
+Function_decl const*
+get_callee(Call_expr const* e)
+{
+  if (Decl_expr const* d = as<Decl_expr>(e->target()))
+    if (Function_decl const* f = as<Function_decl>(d->declaration()))
+      if (!f->is_polymorphic() && !f->virtual_parameters())
+        return f;
+  return nullptr;
+}
+
+
+// Returns the effects of f. If f has not been analyzed,
+// it may do anything.
+Effects const&
+get_effects(Function_decl const* f)
+{
+  return f->effects_ ? *f->effects_ : unknown_;
+}
+
+
+// Returns the effects of the function called by e.
+Effects const&
+get_effects(Call_expr const* e)
+{
+  if (Function_decl const* f = get_callee(e))
+    return get_effects(f);
+  return unknown_;
+}
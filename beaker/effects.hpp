@@ -0,0 +1,65 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_EFFECTS_HPP
+#define BEAKER_EFFECTS_HPP
+
+// Effect analysis.
+//
+// The effects of a function summarize what a call to the
+// function may do, as far as its caller can tell. Effects
+// are inferred from the elaborated definitions of the
+// functions in a module, and from the effects of the
+// functions they call. A function whose definition is not
+// analyzed (a foreign or imported function, or the target
+// of an indirect or virtual call) may do anything.
+//
+// The objects of a function (its local variables and
+// value parameters) are not visible to its callers, so
+// accessing them is not an effect. The referent of a
+// reference parameter is visible.
+//
+// The generator emits effects as function and parameter
+// attributes. The generator and the evaluator also keep the
+// values of shared expressions across calls to functions
+// that do not write memory.
+
+#include <beaker/prelude.hpp>
+
+#include <vector>
+
+
+struct Effects
+{
+  bool captures(std::size_t) const;
+
+  bool reads    = true;  // Reads memory
+  bool writes   = true;  // Writes memory
+  bool unwinds  = true;  // May unwind
+  bool recurses = true;  // May call itself
+  bool returns  = false; // Always returns
+
+  // For each parameter, true if the parameter may be
+  // captured; that is, its value may outlive the call.
+  // Only reference parameters are analyzed.
+  std::vector<bool> capture;
+};
+
+
+// Returns true if the nth parameter may be captured.
+inline bool
+Effects::captures(std::size_t n) const
+{
+  return n >= capture.size() || capture[n];
+}
+
+
+void analyze_effects(Module_decl*);
+
+Function_decl const* get_callee(Call_expr const*);
+
+Effects const& get_effects(Function_decl const*);
+Effects const& get_effects(Call_expr const*);
+
+
+#endif
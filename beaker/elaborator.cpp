@@ -9,11 +9,18 @@
 #include "beaker/decl.hpp"
 #include "beaker/stmt.hpp"
 #include "beaker/convert.hpp"
+#include "beaker/layout.hpp"
 #include "beaker/evaluator.hpp"
 #include "beaker/error.hpp"
 
+#include <boost/functional/hash.hpp>
+
 #include <algorithm>
+#include <atomic>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 //
 // -------------------------------------------------------------------------- //
@@ -44,6 +51,10 @@ Elaborator::overload(Overload& ovl, Decl* curr)
   }
 
   ovl.push_back(curr);
+
+  // Previous resolutions may not have considered
+  // the new declaration.
+  resolved.clear();
 }
 
 
@@ -64,8 +75,7 @@ Elaborator::declare(Decl* d)
     return overload(bind->second, d);
 
   // Create a new overload set.
-  Scope::Binding& bind = scope.bind(d->name(), {});
-  Overload& ovl = bind.second;
+  Overload& ovl = stack.bind(d->name());
   ovl.push_back(d);
 }
 
@@ -81,21 +91,18 @@ Elaborator::redeclare(Decl* d)
   if (Scope::Binding* bind = scope.lookup(d->name()))
     ovl = &bind->second;
   else
-    ovl = &scope.bind(d->name(), {}).second;
+    ovl = &stack.bind(d->name());
   ovl->push_back(d);
 }
 
 
 // Perform lookup of an unqualified identifier. This
-// will search enclosing scopes for the innermost
-// binding of the identifier.
+// returns the innermost binding of the identifier,
+// which is maintained by the scope stack.
 Overload*
 Elaborator::unqualified_lookup(Symbol const* sym)
 {
-  if (Scope::Binding* bind = stack.lookup(sym))
-    return &bind->second;
-  else
-    return nullptr;
+  return stack.lookup(sym);
 }
 
 
@@ -116,15 +123,15 @@ Elaborator::qualified_lookup(Scope* s, Symbol const* sym)
 }
 
 
+// Members are found in the flattened member table of the
+// record's layout. The record is defined first, unless
+// this lookup is part of its definition.
 Overload*
 Elaborator::member_lookup(Record_decl* d, Symbol const* sym)
 {
-  do {
-    if (Scope::Binding* bind = d->scope()->lookup(sym))
-      return &bind->second;
-    d = d->base_declaration();
-  } while (d);
-  return nullptr;
+  if (!is_defining(d))
+    elaborate_def(d);
+  return get_layout(d).lookup(sym);
 }
 
 
@@ -219,6 +226,7 @@ Elaborator::elaborate(Id_type const* t)
 
   // Determine if the name is a type declaration.
   Decl* d = ovl->front();
+  depend(d);
   if (Record_decl* r = as<Record_decl>(d))
     return get_record_type(r);
 
@@ -410,13 +418,17 @@ Elaborator::elaborate(Id_expr* e)
   if (!ovl) {
     std::stringstream ss;
     ss << "no matching declaration for '" << *e->symbol() << '\'';
-    throw Lookup_error(locs.get(e), ss.str());
+    throw Lookup_error(loc, ss.str());
+  }
+  for (Decl* d : *ovl) {
+    depend(d);
+    demand(d);
   }
 
   // We can't resolve an overload without context,
   // so return the resolved overload set.
   if (ovl->size() > 1) {
-    Expr* ret = new Overload_expr(ovl);
+    Expr* ret = make<Overload_expr>(ovl);
     locate(ret, loc);
     return ret;
   }
@@ -431,7 +443,7 @@ Elaborator::elaborate(Id_expr* e)
     t = t->ref();
 
   // Return a new expression.
-  Expr* ret = new Decl_expr(t, d);
+  Expr* ret = make<Decl_expr>(t, d);
   locate(ret, loc);
   return ret;
 }
@@ -449,13 +461,18 @@ Expr*
 Elaborator::elaborate(Lambda_expr* e)
 {
   // Create the new lambda expression.
-  Function_decl* f_decl = new Function_decl(e->symbol(), e->type(), e->parameters(), e->body());
+  Function_decl* f_decl = make<Function_decl>(e->symbol(), e->type(), e->parameters(), e->body());
   elaborate_decl(f_decl);
   elaborate_def(f_decl);
 
   // Build the new lambda expression.
-  Decl_expr* d_expr = new Decl_expr(f_decl->type()->ref(), f_decl);
-  lambda_decls_[d_expr] = f_decl;
+  Decl_expr* d_expr = make<Decl_expr>(f_decl->type()->ref(), f_decl);
+  lambdas_.push_back(f_decl);
+
+  // The synthesized function belongs to the enclosing
+  // top-level declaration.
+  if (deps && depender)
+    (*deps)[depender].insert(f_decl);
   return d_expr;
 }
 
@@ -848,27 +865,100 @@ Elaborator::call(Function_decl* d, Expr_seq const& args)
 
   // Update the expression with the return type
   // of the named function.
-  Expr* ref = new Decl_expr(t, d);
-  return new Call_expr(t->return_type(), ref, conv);
+  Expr* ref = make<Decl_expr>(t, d);
+  return make<Call_expr>(t->return_type(), ref, conv);
+}
+
+
+namespace
+{
+
+// Returns true if a function of type t can be called
+// with the given arguments.
+bool
+is_viable(Function_type const* t, Expr_seq const& args)
+{
+  Type_seq const& parms = t->parameter_types();
+  if (parms.size() != args.size())
+    return false;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (rank_conversion(args[i]->type(), parms[i]) == no_rank)
+      return false;
+  }
+  return true;
+}
+
+
+// Returns true if a viable function of type t1 is a
+// better match for the given arguments than one of type
+// t2. This is the case when no argument conversion for
+// t1 is worse than that for t2, and at least one is
+// better.
+bool
+is_better(Function_type const* t1, Function_type const* t2, Expr_seq const& args)
+{
+  Type_seq const& p1 = t1->parameter_types();
+  Type_seq const& p2 = t2->parameter_types();
+  bool better = false;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    Type const* t = args[i]->type();
+    Conversion_rank r1 = rank_conversion(t, p1[i]);
+    Conversion_rank r2 = rank_conversion(t, p2[i]);
+    if (r1 > r2)
+      return false;
+    if (r1 < r2)
+      better = true;
+  }
+  return better;
+}
+
+} // namespace
+
+
+std::size_t
+Call_signature_hash::operator()(Call_signature const& s) const
+{
+  std::size_t seed = boost::hash_value(s.first);
+  for (Type const* t : s.second)
+    boost::hash_combine(seed, t->hash());
+  return seed;
 }
 
 
+// Select the best function in an overload set for the
+// given arguments, and return a call to that function.
+//
+// Candidates are compared by ranking the conversion of
+// each argument, so no expressions are built until a
+// function is selected. The selection is memoized on the
+// overload set and argument types.
 Expr*
 Elaborator::resolve(Overload_expr* ovl, Expr_seq const& args)
 {
-  // Build a set of call expressions to the
-  // declarations in the overload set.
-  Expr_seq cands;
   Overload& decls = ovl->declarations();
-  cands.reserve(decls.size());
+
+  // Use a previous resolution, if any.
+  signature.first = &decls;
+  signature.second.clear();
+  for (Expr const* a : args)
+    signature.second.push_back(a->type());
+  auto iter = resolved.find(signature);
+  if (iter != resolved.end())
+    return call(iter->second, args);
+
+  // Find the best viable function.
+  Function_decl* best = nullptr;
   for (Decl* d : decls) {
-    if (Expr* e = call(cast<Function_decl>(d), args))
-      cands.push_back(e);
+    Function_decl* fn = cast<Function_decl>(d);
+    if (!is_viable(fn->type(), args))
+      continue;
+    if (!best || is_better(fn->type(), best->type(), args))
+      best = fn;
   }
 
   // FIXME: If the call is to a method, then write
   // out the method format for the call. Same as below.
-  if (cands.empty()) {
+  if (!best) {
     Location loc = locate(ovl);
     String msg = format("{}: no matching function for '{}'", loc, *ovl->name());
     std::cerr << msg << '\n';
@@ -879,12 +969,25 @@ Elaborator::resolve(Overload_expr* ovl, Expr_seq const& args)
     throw Type_error(locate(ovl), msg);
   }
 
-  // TODO: Select the best candidate.
-  if (cands.size() > 1) {
-    String msg = format("call to function '{}' is ambiguous", *ovl->name());
+  // The best function must be better than every other
+  // viable function.
+  for (Decl* d : decls) {
+    Function_decl* fn = cast<Function_decl>(d);
+    if (fn == best || !is_viable(fn->type(), args))
+      continue;
+    if (!is_better(best->type(), fn->type(), args)) {
+      Location loc = locate(ovl);
+      String msg = format("{}: call to function '{}' is ambiguous", loc, *ovl->name());
+      std::cerr << msg << '\n';
+      std::cerr << loc << ": candidates are:\n";
+      std::cerr << format("{}: {}\n", locate(best), *best);
+      std::cerr << format("{}: {}\n", locate(fn), *fn);
+      throw Type_error(locate(ovl), msg);
+    }
   }
 
-  return cands.front();
+  resolved.emplace(signature, best);
+  return call(best, args);
 }
 
 
@@ -940,9 +1043,10 @@ Elaborator::elaborate(Call_expr* e)
   // Elaborate the arguments (in place) prior to
   // conversion. Do it now so we don't re-elaborate
   // arguments during overload resolution.
-  Expr_seq& args = e->arguments();
-  for (Expr*& a : args)
-    a = elaborate(a);
+  Expr_seq args;
+  args.reserve(e->arguments().size() + 1);
+  for (Expr* a : e->arguments())
+    args.push_back(elaborate(a));
 
   // If the target is of the form x.m or x.ovl, insert x
   // into the argument list and update the function target.
@@ -986,7 +1090,7 @@ Elaborator::elaborate(Call_expr* e)
     // of the named function.
     e->type_ = t->return_type();
     e->first = f;
-    e->second = conv;
+    e->second = Expr_list(conv);
   }
 
 
@@ -1000,63 +1104,6 @@ Elaborator::elaborate(Call_expr* e)
 }
 
 
-namespace
-{
-
-// Search the base classes for the given field.
-//
-// TODO: Support multiple base classes.
-void
-get_path(Record_decl* r, Field_decl* f, Field_path& p)
-{
-  // Search the record for the given fields.
-  Decl_seq const& fs = r->fields();
-  auto iter = std::find(fs.begin(), fs.end(), f);
-  if (iter != fs.end()) {
-    // Compute the offset adjustment for this member.
-    // A virtual table reference counts as a subobject, and
-    // so does a base class sub-object.
-    int a = 0;
-    if (r->vref())
-      ++a;
-    if (r->base())
-      ++a;
-    p.push_back(std::distance(fs.begin(), iter) + a);
-    return;
-  }
-
-  // Recursively search the base class.
-  if (r->base()) {
-    p.push_back(0);
-    get_path(r->base()->declaration(), f, p);
-  }
-}
-
-
-// Construct a sequence of indexes through the record and
-// up to the given field. The resulting path shall be
-// a non-empty sequence of indexes.
-Field_path
-get_path(Record_decl* r, Field_decl* f)
-{
-  Field_path p;
-  get_path(r, f, p);
-  lingo_assert(!p.empty());
-  return p;
-}
-
-//Method_path
-//get_path(Record_decl* r, Method_decl* m) {
-//  Method_path p;
-//  get_path(r, m, p);
-//  lingo_assert(!p.empty());
-//  return p;
-//}
-
-
-} // namespace
-
-
 // TODO: Document the semantics of member access.
 Expr*
 Elaborator::elaborate(Dot_expr* e)
@@ -1080,6 +1127,7 @@ Elaborator::elaborate(Dot_expr* e)
     throw Type_error({}, ss.str());
   }
   Scope* s = t1->declaration()->scope();
+  depend(t1->declaration());
 
   // We expect the member to be an unresolved id expression.
   // If it isn't, there's not much we can do with it.
@@ -1106,14 +1154,14 @@ Elaborator::elaborate(Dot_expr* e)
   // expression.
   if (ovl->size() == 1) {
     Decl*d = ovl->front();
-    e2 = new Decl_expr(d->type(), d);
+    e2 = make<Decl_expr>(d->type(), d);
     if (Field_decl* f = as<Field_decl>(d)) {
       Type const* t2 = e2->type()->ref();
-      Field_path p = get_path(t1->declaration(), f);
-      return new Field_expr(t2, e1, e2, f, p);
+      Layout const& l = get_layout(t1->declaration());
+      return make<Field_expr>(t2, e1, e2, f, l.field(f)->path);
     }
     if (Method_decl* m = as<Method_decl>(d)) {
-      return new Method_expr(e1, e2, m);
+      return make<Method_expr>(e1, e2, m);
     }
   }
 
@@ -1123,7 +1171,7 @@ Elaborator::elaborate(Dot_expr* e)
   // a function call.
   else {
     e->first = e1;
-    e->second = new Overload_expr(ovl);
+    e->second = make<Overload_expr>(ovl);
     return e;
   }
 
@@ -1251,7 +1299,7 @@ Elaborator::elaborate(Copy_init* e)
   // performing reference initialization. Create
   // a new node and elaborate it.
   if (is<Reference_type>(e->type())) {
-    Reference_init* init = new Reference_init(e->type(), e->value());
+    Reference_init* init = make<Reference_init>(e->type(), e->value());
     return elaborate(init);
   }
 
@@ -1418,7 +1466,7 @@ Elaborator::elaborate(Parameter_decl* d)
     // TODO: What are we actually going to do with
     // this thing?
     if (!fn->vparms_)
-      fn->vparms_ = new Decl_seq {d};
+      fn->vparms_ = make<Decl_seq>(1, d);
     else
       fn->vparms_->push_back(d);
   }
@@ -1455,21 +1503,239 @@ Elaborator::elaborate(Method_decl* d)
 // lookup mechanism.
 Decl*
 Elaborator::elaborate(Module_decl* m)
+{
+  return elaborate(m, Decl_set{});
+}
+
+
+// Elaborate the module, except for the reused
+// declarations. Those have been elaborated by a previous
+// compilation (or imported), and are only declared in
+// the module scope. Reused records are already defined.
+// If dependencies are being tracked, they are recorded for
+// each declaration that is elaborated.
+//
+// Functions are defined after all other declarations,
+// possibly concurrently (see elaborate_functions). In
+// lazy mode, only those reachable from main are defined
+// (see elaborate_reachable).
+Decl*
+Elaborator::elaborate(Module_decl* m, Decl_set const& reused)
 {
   Scope_sentinel scope(*this, m);
-  for (Decl*& d : m->decls_)
+  for (Decl*& d : m->decls_) {
+    if (reused.count(d)) {
+      declare(d);
+      if (is<Record_decl>(d))
+        defined.insert(d);
+      if (d->name() == syms.get("main"))
+        main = as<Function_decl>(d);
+      continue;
+    }
+    depender = d;
     d = elaborate_decl(d);
-  for (Decl*& d : m->decls_)
+  }
+  std::vector<Decl**> fns;
+  for (Decl*& d : m->decls_) {
+    if (reused.count(d))
+      continue;
+    if (is<Function_decl>(d)) {
+      fns.push_back(&d);
+      continue;
+    }
+    depender = d;
     d = elaborate_def(d);
-
-  for (auto && a : lambda_decls_)
-    m->decls_.insert(m->decls_.begin(), a.second);
+  }
+  depender = nullptr;
+  if (lazy && main)
+    elaborate_reachable(m, fns);
+  else
+    elaborate_functions(m, fns);
+
+  // Lambda definitions precede the declarations that
+  // use them.
+  if (!lambdas_.empty()) {
+    Decl_seq ds(lambdas_.begin(), lambdas_.end());
+    ds.insert(ds.end(), m->decls_.begin(), m->decls_.end());
+    m->decls_ = Decl_list(ds, m->arena());
+    lambdas_.clear();
+  }
 
   return m;
 
 }
 
 
+// Elaborate the definitions of the functions fs, which
+// are declared in the module m. Function bodies do not
+// depend on each other, so they are elaborated by a pool
+// of threads. Each thread has its own elaborator, arena,
+// locations, and dependencies. Those are merged when all
+// threads have finished, so the result does not depend on
+// the schedule: lambdas are hoisted in the order of the
+// functions that contain them, and the first error (in
+// declaration order) is rethrown.
+//
+// Threads only read shared state. All records are defined
+// and their layouts computed beforehand.
+void
+Elaborator::elaborate_functions(Module_decl* m, std::vector<Decl**> const& fs)
+{
+  std::size_t n = std::min<std::size_t>(threads, fs.size());
+  if (n <= 1) {
+    for (Decl** d : fs) {
+      depender = *d;
+      *d = elaborate_def(*d);
+    }
+    depender = nullptr;
+    return;
+  }
+
+  for (Decl* d : m->decls_)
+    if (Record_decl* r = as<Record_decl>(d))
+      get_layout(r);
+
+  struct Worker
+  {
+    Worker(Elaborator& e, Arena& a)
+      : arena(a), elab(e, locs)
+    {
+      if (e.deps)
+        elab.track(deps);
+    }
+
+    Arena&         arena;
+    Location_map   locs;
+    Dependency_map deps;
+    Elaborator     elab;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (std::size_t i = 0; i < n; ++i)
+    workers.emplace_back(new Worker(*this, m->make_arena()));
+
+  // Results, for each function.
+  std::vector<std::vector<Decl*>>  lambdas(fs.size());
+  std::vector<std::exception_ptr>  errors(fs.size());
+
+  std::atomic<std::size_t> next(0);
+  std::vector<std::thread> pool;
+  for (std::unique_ptr<Worker>& w : workers) {
+    pool.emplace_back([&fs, &lambdas, &errors, &next](Worker* w) {
+      Arena_sentinel alloc(w->arena);
+      Elaborator& elab = w->elab;
+      for (std::size_t i = next++; i < fs.size(); i = next++) {
+        Decl*& d = *fs[i];
+        elab.depender = d;
+        try {
+          d = elab.elaborate_def(d);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+        lambdas[i].swap(elab.lambdas_);
+        elab.lambdas_.clear();
+      }
+    }, w.get());
+  }
+  for (std::thread& t : pool)
+    t.join();
+
+  for (std::unique_ptr<Worker>& w : workers) {
+    locs.insert(w->locs.begin(), w->locs.end());
+    demanded.insert(demanded.end(), w->elab.demanded.begin(), w->elab.demanded.end());
+    if (deps) {
+      for (auto& x : w->deps)
+        (*deps)[x.first].insert(x.second.begin(), x.second.end());
+    }
+  }
+  for (std::size_t i = 0; i < fs.size(); ++i) {
+    if (errors[i])
+      std::rethrow_exception(errors[i]);
+    lambdas_.insert(lambdas_.end(), lambdas[i].begin(), lambdas[i].end());
+  }
+}
+
+
+// Elaborate the functions in fs that are reachable from
+// main or are foreign (and may be called from outside the
+// program). A function is reached when lookup finds its
+// name in the definition of a reached function or of a
+// variable. Each wave of newly reached functions is
+// elaborated, in declaration order, before the next.
+//
+// The definitions of unreached functions have only been
+// parsed. They are removed from the module, so they are
+// not translated.
+void
+Elaborator::elaborate_reachable(Module_decl* m, std::vector<Decl**> const& fs)
+{
+  std::unordered_map<Decl const*, std::size_t> index;
+  for (std::size_t i = 0; i < fs.size(); ++i) {
+    index.emplace(*fs[i], i);
+    if ((*fs[i])->is_foreign())
+      demanded.push_back(*fs[i]);
+  }
+
+  // Note that the elements of fs point into the module's
+  // declarations, so their order is declaration order.
+  std::vector<bool>   reached(fs.size());
+  std::vector<Decl**> wave;
+  std::size_t         next = 0;
+  while (next < demanded.size()) {
+    wave.clear();
+    for (; next < demanded.size(); ++next) {
+      auto iter = index.find(demanded[next]);
+      if (iter != index.end() && !reached[iter->second]) {
+        reached[iter->second] = true;
+        wave.push_back(fs[iter->second]);
+      }
+    }
+    std::sort(wave.begin(), wave.end());
+    elaborate_functions(m, wave);
+  }
+  demanded.clear();
+
+  Decl_seq ds;
+  for (Decl* d : m->decls_) {
+    auto iter = index.find(d);
+    if (iter == index.end() || reached[iter->second])
+      ds.push_back(d);
+  }
+  m->decls_ = Decl_list(ds, m->arena());
+}
+
+
+// Record that the current top-level declaration depends
+// on the declaration d. If d is a member or local, the
+// dependency is on the top-level declaration enclosing it.
+// Dependencies on locals are not recorded.
+void
+Elaborator::depend(Decl const* d)
+{
+  if (!deps || !depender)
+    return;
+  Decl const* cxt = d->context();
+  while (cxt && !is<Module_decl>(cxt)) {
+    d = cxt;
+    cxt = d->context();
+  }
+  if (!cxt || d == depender)
+    return;
+  (*deps)[depender].insert(d);
+}
+
+
+// Record that the function d is used. In lazy mode, only
+// used functions are defined. This is conservative: each
+// function in an overload set found by lookup is used.
+void
+Elaborator::demand(Decl* d)
+{
+  if (lazy && is<Function_decl>(d))
+    demanded.push_back(d);
+}
+
+
 // -------------------------------------------------------------------------- //
 // Elaboration of declarations (but not definitions)
 
@@ -1646,8 +1912,10 @@ Elaborator::elaborate_decl(Method_decl* d)
   // Actually build the implicit this parameter and add it
   // to the front of the list of parameters.
   Symbol const* name = syms.get("this");
-  Parameter_decl* self = new Parameter_decl(name, type);
-  d->parms_.insert(d->parms_.begin(), self);
+  Parameter_decl* self = make<Parameter_decl>(name, type);
+  Decl_seq ps {self};
+  ps.insert(ps.end(), d->parms_.begin(), d->parms_.end());
+  d->parms_ = Decl_list(ps);
 
 
   // Propagate virtual/abstract specifiers to the class.
@@ -1657,7 +1925,7 @@ Elaborator::elaborate_decl(Method_decl* d)
   if (d->is_abstract())
     rec->spec_ |= abstract_spec;
   if (rec->is_polymorphic() && !vtable)
-    rec->vtbl_ = vtable = new Decl_seq();
+    rec->vtbl_ = vtable = make<Decl_seq>();
 
   // This function may be an override of a previous
   // virtual function -- even if it wasn't declared as
@@ -1821,9 +2089,10 @@ Elaborator::elaborate_def(Record_decl* d)
   }
   Defining_sentinel def(*this, d);
 
-  // Elaborate base class.
+  // Elaborate base class. It is defined before the
+  // derived class so that its vtable and layout are known.
   if (d->base_)
-    d->base_ = elaborate(d->base_);
+    d->base_ = elaborate_type(d->base_);
 
   // If the base class is polymorphic, then so is the
   // derived class. Propagate the virtual table to this
@@ -1839,7 +2108,7 @@ Elaborator::elaborate_def(Record_decl* d)
     if (base->is_abstract())
       d->spec_ |= abstract_spec;
     if (base->is_polymorphic())
-      d->vtbl_ = new Decl_seq(*base->vtable());
+      d->vtbl_ = make<Decl_seq>(*base->vtable());
   }
 
   // Elaborate member declarations, fields first.
@@ -1866,11 +2135,6 @@ Elaborator::elaborate_def(Record_decl* d)
   for (Decl*& m : d->members_)
     m = elaborate_decl(m);
 
-  // Elaborate member definitions. See comments
-  // above about handling member defintions.
-  for (Decl*& m : d->members_)
-    m = elaborate_def(m);
-
   // Determine if we need a vtable reference. This is the case
   // when:
   //    - there is no base class or
@@ -1887,10 +2151,15 @@ Elaborator::elaborate_def(Record_decl* d)
     if (!base || !base->is_polymorphic()) {
       Symbol const* n = syms.get("vref");
       Type const* p = get_reference_type(get_character_type());
-      d->vref_ = new Field_decl(n, p);
+      d->vref_ = make<Field_decl>(n, p);
     }
   }
 
+  // Elaborate member definitions. See comments
+  // above about handling member defintions.
+  for (Decl*& m : d->members_)
+    m = elaborate_def(m);
+
   defined.insert(d);
   return d;
 }
@@ -16,6 +16,7 @@
 #include <beaker/prelude.hpp>
 #include <beaker/location.hpp>
 #include <beaker/scope.hpp>
+#include <beaker/incremental.hpp>
 
 #include <unordered_set>
 #include <unordered_map>
@@ -31,6 +32,22 @@ using Decl_set = std::unordered_set<Decl*>;
 using Decl_stack = std::vector<Decl*>;
 
 
+// A call to an overload set with arguments of the
+// given types.
+using Call_signature = std::pair<Overload const*, Type_seq>;
+
+
+struct Call_signature_hash
+{
+  std::size_t operator()(Call_signature const&) const;
+};
+
+
+// Memoized results of overload resolution. Calls having
+// the same signature resolve to the same function.
+using Resolution_map = std::unordered_map<Call_signature, Function_decl*, Call_signature_hash>;
+
+
 // The elaborator is responsible for the annotation of
 // an AST with type and other information.
 class Elaborator
@@ -39,6 +56,8 @@ class Elaborator
   struct Scope_sentinel;
   struct Defining_sentinel;
 
+  Elaborator(Elaborator&, Location_map&);
+
 public:
   Elaborator(Location_map&, Symbol_table&);
 
@@ -65,7 +84,7 @@ public:
   // NOTE NOTE NOTE
   // ADDITIONS FOR LAMBDAS
   Expr* elaborate(Lambda_expr*);
-  std::unordered_map<Expr*, Function_decl*> lambda_decls_;
+  std::vector<Decl*> lambdas_; // Hoisted in order of elaboration
 
   Expr* elaborate(Add_expr* e);
   Expr* elaborate(Sub_expr* e);
@@ -105,6 +124,9 @@ public:
   Decl* elaborate(Field_decl*);
   Decl* elaborate(Method_decl*);
   Decl* elaborate(Module_decl*);
+  Decl* elaborate(Module_decl*, Decl_set const&);
+  void  elaborate_functions(Module_decl*, std::vector<Decl**> const&);
+  void  elaborate_reachable(Module_decl*, std::vector<Decl**> const&);
 
   // Support for two-phase elaboration.
   Decl* elaborate_decl(Decl*);
@@ -156,15 +178,40 @@ public:
 
   bool is_defining(Decl const*) const;
 
+  // Dependency tracking
+  void track(Dependency_map& m) { deps = &m; }
+  void depend(Decl const*);
+  void demand(Decl*);
+
   // Found symbols.
   Function_decl* main = nullptr;
 
+  // The number of threads used to elaborate function
+  // definitions. The compiler sets this from -j.
+  unsigned threads = 1;
+
+  // If true, only the functions reachable from main are
+  // elaborated; the others are removed from the module.
+  bool lazy = false;
+
 private:
-  Location_map& locs;
-  Symbol_table& syms;
+  Location_map&       locs;
+  Location_map const* shared_locs = nullptr; // Locations of the module
+  Symbol_table&       syms;
   Scope_stack   stack;
   Decl_set      defined;
   Decl_stack    defining;
+
+  // Overload resolution.
+  Resolution_map resolved;
+  Call_signature signature; // Reused for lookup
+
+  // Dependency tracking.
+  Dependency_map* deps = nullptr;     // Recorded dependencies
+  Decl const*     depender = nullptr; // Current top-level declaration
+
+  // Functions found by lookup, in lazy mode.
+  std::vector<Decl*> demanded;
 };
 
 
@@ -174,6 +221,20 @@ Elaborator::Elaborator(Location_map& loc, Symbol_table& s)
 { }
 
 
+// Create an elaborator for definitions in a thread other
+// than that of e. It has a private scope stack within the
+// module scope of e, and records new locations in loc.
+inline
+Elaborator::Elaborator(Elaborator& e, Location_map& loc)
+  : lazy(e.lazy)
+  , locs(loc)
+  , shared_locs(&e.locs)
+  , syms(e.syms)
+  , stack(&e.stack.global())
+  , defined(e.defined)
+{ }
+
+
 inline void
 Elaborator::locate(void const* p, Location l)
 {
@@ -187,6 +248,8 @@ Elaborator::locate(void const* p)
   auto iter = locs.find(p);
   if (iter != locs.end())
     return iter->second;
+  else if (shared_locs)
+    return shared_locs->get(p);
   else
     return {};
 }
@@ -0,0 +1,232 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/emitter.hpp"
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+// Code is only split across jobs with LLVM 7 or later.
+#if LLVM_VERSION_MAJOR >= 7
+#  include <llvm/CodeGen/ParallelCG.h>
+#endif
+
+#if LLVM_VERSION_MAJOR >= 17
+#  include <llvm/TargetParser/Host.h>
+#else
+#  include <llvm/Support/Host.h>
+#endif
+
+#if LLVM_VERSION_MAJOR >= 14
+#  include <llvm/MC/TargetRegistry.h>
+#else
+#  include <llvm/Support/TargetRegistry.h>
+#endif
+
+#if LLVM_VERSION_MAJOR < 4
+#  include <llvm/Support/FormattedStream.h>
+#endif
+
+#include <iostream>
+#include <memory>
+
+
+namespace
+{
+
+#if LLVM_VERSION_MAJOR >= 18
+using Codegen_level = llvm::CodeGenOptLevel;
+using Codegen_file = llvm::CodeGenFileType;
+Codegen_file const asm_type = llvm::CodeGenFileType::AssemblyFile;
+Codegen_file const object_type = llvm::CodeGenFileType::ObjectFile;
+#elif LLVM_VERSION_MAJOR >= 10
+using Codegen_level = llvm::CodeGenOpt::Level;
+using Codegen_file = llvm::CodeGenFileType;
+Codegen_file const asm_type = llvm::CGFT_AssemblyFile;
+Codegen_file const object_type = llvm::CGFT_ObjectFile;
+#else
+using Codegen_level = llvm::CodeGenOpt::Level;
+using Codegen_file = llvm::TargetMachine::CodeGenFileType;
+Codegen_file const asm_type = llvm::TargetMachine::CGFT_AssemblyFile;
+Codegen_file const object_type = llvm::TargetMachine::CGFT_ObjectFile;
+#endif
+
+
+// Code generation has no size level, so -Os generates
+// code as -O2.
+Codegen_level
+get_level(Opt_level l)
+{
+  switch (l) {
+    case o0_opt: return Codegen_level::None;
+    case o1_opt: return Codegen_level::Less;
+    case o2_opt: return Codegen_level::Default;
+    case o3_opt: return Codegen_level::Aggressive;
+    case os_opt: return Codegen_level::Default;
+  }
+  lingo_unreachable();
+}
+
+// Create a target machine for the host. Code is position
+// independent so that it can be linked into programs
+// and shared modules alike.
+std::unique_ptr<llvm::TargetMachine>
+make_target_machine(Opt_level l)
+{
+  std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string err;
+  llvm::Target const* t = llvm::TargetRegistry::lookupTarget(triple, err);
+  if (!t)
+    throw std::runtime_error(err);
+
+  llvm::TargetOptions opts;
+  std::unique_ptr<llvm::TargetMachine> tm(
+    t->createTargetMachine(triple, "generic", "", opts, llvm::Reloc::PIC_));
+  if (!tm)
+    throw std::runtime_error("cannot create a target machine for " + triple);
+#if LLVM_VERSION_MAJOR >= 4
+  tm->setOptLevel(get_level(l));
+#else
+  (void)l;
+#endif
+  return tm;
+}
+
+} // namespace
+
+
+// Register the host target with LLVM. This is done
+// once per process.
+void
+init_native_target()
+{
+  static bool init = [] {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    return true;
+  }();
+  (void)init;
+}
+
+
+// Returns the target triple of the host.
+String
+host_triple()
+{
+  return llvm::sys::getDefaultTargetTriple();
+}
+
+
+Emitter::Emitter(Opt_level l)
+  : level(l)
+{
+  init_native_target();
+  tm = make_target_machine(l);
+}
+
+
+Emitter::~Emitter()
+{ }
+
+
+// Target the module to the host. This should be done
+// before the module is optimized, so that the optimizer
+// knows the sizes and alignments of types.
+void
+Emitter::configure(llvm::Module* m)
+{
+  m->setTargetTriple(tm->getTargetTriple().str());
+#if LLVM_VERSION_MAJOR >= 4
+  m->setDataLayout(tm->createDataLayout());
+#endif
+}
+
+
+// Emit the module to the given file. Returns false
+// if the file cannot be written.
+bool
+Emitter::emit(llvm::Module* m, Path const& p, Emit_kind k)
+{
+  std::error_code ec;
+#if LLVM_VERSION_MAJOR >= 9
+  llvm::raw_fd_ostream os(p.string(), ec, llvm::sys::fs::OF_None);
+#else
+  llvm::raw_fd_ostream os(p.string(), ec, llvm::sys::fs::F_None);
+#endif
+  if (ec) {
+    std::cerr << format("error: cannot write '{}': {}\n", p.string(), ec.message());
+    return false;
+  }
+
+  Codegen_file type = k == asm_emit ? asm_type : object_type;
+  llvm::legacy::PassManager pm;
+#if LLVM_VERSION_MAJOR >= 7
+  bool failed = tm->addPassesToEmitFile(pm, os, nullptr, type);
+#elif LLVM_VERSION_MAJOR >= 4
+  bool failed = tm->addPassesToEmitFile(pm, os, type);
+#else
+  llvm::formatted_raw_ostream fos(os);
+  bool failed = tm->addPassesToEmitFile(pm, fos, type);
+#endif
+  if (failed) {
+    std::cerr << "error: the target cannot emit this file type\n";
+    return false;
+  }
+  pm.run(*m);
+  return true;
+}
+
+
+// Emit the module as n object files named after the output
+// file, and append their paths to objs. The partitions are
+// generated concurrently, each with a target machine of its
+// own. Internal symbols are made external so that references
+// between partitions resolve when the objects are linked.
+//
+// Before LLVM 7, the module is generated serially into a
+// single object file.
+bool
+Emitter::emit(llvm::Module* m, Path const& out, int n, Path_seq& objs)
+{
+#if LLVM_VERSION_MAJOR >= 7
+  Path_seq ps;
+  std::vector<std::unique_ptr<llvm::raw_fd_ostream>> files;
+  std::vector<llvm::raw_pwrite_stream*> streams;
+  for (int i = 0; i < n; ++i) {
+    Path p = out;
+    p.replace_extension(format(".{}{}", i, object_extension()));
+    std::error_code ec;
+#  if LLVM_VERSION_MAJOR >= 9
+    files.emplace_back(new llvm::raw_fd_ostream(p.string(), ec, llvm::sys::fs::OF_None));
+#  else
+    files.emplace_back(new llvm::raw_fd_ostream(p.string(), ec, llvm::sys::fs::F_None));
+#  endif
+    if (ec) {
+      std::cerr << format("error: cannot write '{}': {}\n", p.string(), ec.message());
+      return false;
+    }
+    streams.push_back(files.back().get());
+    ps.push_back(p);
+  }
+
+  Opt_level l = level;
+  llvm::splitCodeGen(*m, streams, {}, [l]() { return make_target_machine(l); }, object_type);
+  objs.insert(objs.end(), ps.begin(), ps.end());
+  return true;
+#else
+  (void)n;
+  Path p = to_object_file(out);
+  if (!emit(m, p, object_emit))
+    return false;
+  objs.push_back(p);
+  return true;
+#endif
+}
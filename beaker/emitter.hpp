@@ -0,0 +1,59 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_EMITTER_HPP
+#define BEAKER_EMITTER_HPP
+
+// Native code emission.
+//
+// The emitter translates an LLVM module in memory to
+// assembly or an object file for the host, without
+// writing textual IR or running llc and the assembler.
+//
+// Object code can also be generated in parallel. The module
+// is split into partitions by function, and each partition
+// is generated into its own object file on its own thread,
+// in its own LLVM context.
+
+#include <beaker/prelude.hpp>
+#include <beaker/file.hpp>
+#include <beaker/optimizer.hpp>
+
+#include <memory>
+
+
+namespace llvm
+{
+class Module;
+class TargetMachine;
+} // namespace llvm
+
+
+// The kinds of files produced by the emitter.
+enum Emit_kind
+{
+  asm_emit,    // Native assembly
+  object_emit, // An object file
+};
+
+
+// The emitter owns a target machine for the host.
+struct Emitter
+{
+  Emitter(Opt_level);
+  ~Emitter();
+
+  void configure(llvm::Module*);
+  bool emit(llvm::Module*, Path const&, Emit_kind);
+  bool emit(llvm::Module*, Path const&, int, Path_seq&);
+
+  Opt_level                            level;
+  std::unique_ptr<llvm::TargetMachine> tm;
+};
+
+
+void init_native_target();
+String host_triple();
+
+
+#endif
@@ -4,66 +4,222 @@
 #include "config.hpp"
 
 #include "beaker/equal.hpp"
+#include "beaker/less.hpp"
 #include "beaker/type.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/decl.hpp"
 
 #include <algorithm>
 
 
-// TODO: Rewrite this to use the lingo node concepts.
-
-template<typename T>
-inline bool
-is_equal(std::vector<T*> const& a, std::vector<T*> const& b)
+// Returns true when a and b have the same structure.
+// The components of a type are canonical, so they are
+// compared by address. Only the outermost structure is
+// inspected.
+bool
+is_equal(Type const* a, Type const* b)
 {
-  auto cmp = [](T const* x, T const* y) { return is_equal(x, y); };
-  return std::equal(a.begin(), a.end(), b.begin(), b.end(), cmp);
+  struct Fn
+  {
+    Type const* b;
+
+    bool operator()(Id_type const* a)
+    {
+      return a->symbol() == cast<Id_type>(b)->symbol();
+    }
+
+    bool operator()(Boolean_type const* a)   { return true; }
+    bool operator()(Character_type const* a) { return true; }
+    bool operator()(Float_type const* a)     { return true; }
+    bool operator()(Double_type const* a)    { return true; }
+
+    bool operator()(Integer_type const* a)
+    {
+      Integer_type const* t = cast<Integer_type>(b);
+      return a->is_signed() == t->is_signed()
+          && a->precision() == t->precision();
+    }
+
+    bool operator()(Function_type const* a)
+    {
+      Function_type const* t = cast<Function_type>(b);
+      return a->parameter_types() == t->parameter_types()
+          && a->return_type() == t->return_type();
+    }
+
+    // Array extents are compared structurally.
+    bool operator()(Array_type const* a)
+    {
+      Array_type const* t = cast<Array_type>(b);
+      return a->type() == t->type()
+          && is_equal(a->extent(), t->extent());
+    }
+
+    bool operator()(Block_type const* a)
+    {
+      return a->type() == cast<Block_type>(b)->type();
+    }
+
+    bool operator()(Reference_type const* a)
+    {
+      return a->type() == cast<Reference_type>(b)->type();
+    }
+
+    bool operator()(Record_type const* a)
+    {
+      return a->declaration() == cast<Record_type>(b)->declaration();
+    }
+  };
+
+  if (a == b)
+    return true;
+  if (a->kind() != b->kind())
+    return false;
+  return dispatch(a, Fn{b});
 }
 
 
+// -------------------------------------------------------------------------- //
+// Equality of expressions
+
+namespace
+{
+
+template<typename T>
 inline bool
-is_equal(Function_type const* a, Function_type const* b)
+is_equal(Span<T> const& a, Span<T> const& b)
 {
-  return is_equal(a->parameter_types(), b->parameter_types())
-      && is_equal(a->return_type(), b->return_type());
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
 }
 
 
 inline bool
-is_equal(Reference_type const* a, Reference_type const* b)
+is_equal(Value const& a, Value const& b)
 {
-  return is_equal(a->first, b->first);
+  return !is_less(a, b) && !is_less(b, a);
 }
 
+} // namespace
+
 
+// Returns true when a and b have the same structure.
+// Two expressions are equal when they have the same kind
+// and type, their operands are equal, and they refer to
+// the same declarations. Lambda expressions are equal
+// only to themselves.
 bool
-is_equal(Type const* a, Type const* b)
+is_equal(Expr const* a, Expr const* b)
 {
   struct Fn
   {
-    Type const* b;
+    Expr const* b;
 
-    bool operator()(Boolean_type const* a)
+    bool operator()(Literal_expr const* a)
     {
-      return true;
+      return is_equal(a->value(), cast<Literal_expr>(b)->value());
     }
 
-    bool operator()(Integer_type const* a)
+    bool operator()(Id_expr const* a)
     {
-      return true;
+      return a->symbol() == cast<Id_expr>(b)->symbol();
     }
 
-    bool operator()(Function_type const* a)
+    bool operator()(Decl_expr const* a)
     {
-      return is_equal(a, cast<Function_type>(b));
+      return a->declaration() == cast<Decl_expr>(b)->declaration();
     }
 
-    bool operator()(Reference_type const* a)
+    bool operator()(Overload_expr const* a)
+    {
+      return &a->declarations() == &cast<Overload_expr>(b)->declarations();
+    }
+
+    bool operator()(Lambda_expr const* a) { return false; }
+
+    bool operator()(Unary_expr const* a)
+    {
+      return is_equal(a->operand(), cast<Unary_expr>(b)->operand());
+    }
+
+    bool operator()(Binary_expr const* a)
+    {
+      Binary_expr const* e = cast<Binary_expr>(b);
+      return is_equal(a->left(), e->left())
+          && is_equal(a->right(), e->right());
+    }
+
+    bool operator()(Call_expr const* a)
+    {
+      Call_expr const* e = cast<Call_expr>(b);
+      if (!is_equal(a->target(), e->target()))
+        return false;
+      if (a->arguments().size() != e->arguments().size())
+        return false;
+      auto cmp = [](Expr const* x, Expr const* y) { return is_equal(x, y); };
+      return std::equal(a->arguments().begin(), a->arguments().end(),
+                        e->arguments().begin(), cmp);
+    }
+
+    bool operator()(Dot_expr const* a)
+    {
+      Dot_expr const* e = cast<Dot_expr>(b);
+      return is_equal(a->container(), e->container())
+          && is_equal(a->member(), e->member());
+    }
+
+    bool operator()(Field_expr const* a)
     {
-      return is_equal(a, cast<Reference_type>(b));
+      Field_expr const* e = cast<Field_expr>(b);
+      return a->var == e->var
+          && is_equal(a->path(), e->path())
+          && is_equal(a->container(), e->container());
+    }
+
+    bool operator()(Method_expr const* a)
+    {
+      Method_expr const* e = cast<Method_expr>(b);
+      return a->fn == e->fn
+          && is_equal(a->container(), e->container());
+    }
+
+    bool operator()(Index_expr const* a)
+    {
+      Index_expr const* e = cast<Index_expr>(b);
+      return is_equal(a->array(), e->array())
+          && is_equal(a->index(), e->index());
+    }
+
+    bool operator()(Conv const* a)
+    {
+      return is_equal(a->source(), cast<Conv>(b)->source());
+    }
+
+    bool operator()(Base_conv const* a)
+    {
+      Base_conv const* e = cast<Base_conv>(b);
+      return is_equal(a->path(), e->path())
+          && is_equal(a->source(), e->source());
+    }
+
+    bool operator()(Default_init const* a) { return true; }
+    bool operator()(Trivial_init const* a) { return true; }
+
+    bool operator()(Copy_init const* a)
+    {
+      return is_equal(a->value(), cast<Copy_init>(b)->value());
+    }
+
+    bool operator()(Reference_init const* a)
+    {
+      return is_equal(a->object(), cast<Reference_init>(b)->object());
     }
   };
 
-  if (typeid(*a) != typeid(*b))
+  if (a == b)
+    return true;
+  if (!a || !b)
+    return false;
+  if (a->kind() != b->kind() || a->type() != b->type())
     return false;
-  return apply(a, Fn{b});
+  return dispatch(a, Fn{b});
 }
@@ -8,6 +8,7 @@
 
 
 bool is_equal(Type const*, Type const*);
+bool is_equal(Expr const*, Expr const*);
 
 
 // A function object that invokes the is_equal function.
@@ -8,8 +8,12 @@
 #include "beaker/expr.hpp"
 #include "beaker/decl.hpp"
 #include "beaker/stmt.hpp"
+#include "beaker/layout.hpp"
+#include "beaker/effects.hpp"
+#include "beaker/ssa.hpp"
 #include "beaker/error.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 
@@ -54,7 +58,16 @@ Evaluator::eval(Expr const* e)
     Value operator()(Init const* e) { lingo_unreachable(); }
   };
 
-  return apply(e, Fn {*this});
+  if (!e->is_shared())
+    return dispatch(e, Fn {*this});
+
+  // Reuse the value of a shared expression.
+  auto iter = cache.find(e);
+  if (iter != cache.end())
+    return iter->second;
+  Value v = dispatch(e, Fn {*this});
+  cache.emplace(e, v);
+  return v;
 }
 
 
@@ -82,7 +95,8 @@ struct Eval_init_fn
 void
 Evaluator::eval_init(Expr const* e, Value& v)
 {
-  apply(e, Eval_init_fn {*this, v});
+  dispatch(e, Eval_init_fn {*this, v});
+  cache.clear();
 }
 
 
@@ -155,7 +169,7 @@ Evaluator::eval(Rem_expr const* e)
   Value v2 = eval(e->right());
   if (v2.get_integer() == 0)
     throw std::runtime_error("division by 0");
-  return v1.get_integer() / v2.get_integer();
+  return v1.get_integer() % v2.get_integer();
 }
 
 
@@ -308,6 +322,29 @@ Evaluator::eval(Call_expr const* e)
   for (Expr const* a : e->arguments())
     args.push_back(eval(a));
 
+  // A function that does not write memory cannot change
+  // the values of the caller's shared expressions. Those
+  // are kept across the call.
+  Value_cache saved;
+  bool keep = !get_effects(f).writes;
+  if (keep)
+    saved.swap(cache);
+
+  Value result = call(f, args);
+  if (keep)
+    cache.swap(saved);
+  return result;
+}
+
+
+// Call f with the given arguments. A function lowered to
+// SSA form is executed in that form.
+Value
+Evaluator::call(Function_decl const* f, Value_seq& args)
+{
+  if (f->ssa_)
+    return exec(f->ssa_, args);
+
   // Build the new call frame by pushing bindings
   // from each parameter to the corresponding argument.
   //
@@ -329,7 +366,6 @@ Evaluator::eval(Call_expr const* e)
   Control ctl = eval(f->body(), result);
   if (ctl != return_ctl)
     throw std::runtime_error("function evaluation failed");
-
   return result;
 }
 
@@ -341,12 +377,15 @@ Evaluator::eval(Dot_expr const* e)
 }
 
 
+// A record object is a tuple of its flattened fields.
 Value
 Evaluator::eval(Field_expr const* e)
 {
   Value obj = eval(e->container());
   Value* ref = obj.get_reference();
-  return &ref->get_tuple().data[e->field()->index()];
+  Record_type const* t = cast<Record_type>(e->container()->type()->nonref());
+  int n = get_layout(t->declaration()).index(e->field());
+  return &ref->get_tuple().data[n];
 }
 
 
@@ -419,10 +458,13 @@ Evaluator::eval(Promote_conv const* e)
 
 }
 
+// The flattened fields of a base class are a prefix of
+// those of the derived class, so the object can be used
+// as its base.
 Value
 Evaluator::eval(Base_conv const* e)
 {
-  throw std::runtime_error("not implemented");
+  return eval(e->source());
 }
 
 
@@ -473,7 +515,7 @@ Evaluator::eval(Decl const* d)
     void operator()(Module_decl const* d) { ev.eval(d); }
   };
 
-  return apply(d, Fn{*this});
+  return dispatch(d, Fn{*this});
 }
 
 
@@ -530,15 +572,14 @@ get_value(Type const* t)
 
     Value operator()(Record_type const* t)
     {
-      Record_decl const* d = t->declaration();
-      Decl_seq const& f = d->fields();
-      Tuple_value v(f.size());
+      Layout const& l = get_layout(t->declaration());
+      Tuple_value v(l.fields.size());
       for (std::size_t i = 0; i < v.len; ++i)
-        v.data[i] = get_value(f[i]->type());
+        v.data[i] = get_value(l.fields[i].field->type());
       return v;
     }
   };
-  return apply(t, Fn{});
+  return dispatch(t, Fn{});
 }
 
 } // namespace
@@ -636,7 +677,7 @@ Evaluator::eval(Stmt const* s, Value& r)
     Control operator()(Declaration_stmt const* s) { return ev.eval(s, r); }
   };
 
-  return apply(s, Fn{*this, r});
+  return dispatch(s, Fn{*this, r});
 }
 
 
@@ -674,6 +715,7 @@ Evaluator::eval(Assign_stmt const* s, Value& r)
   Value lhs = eval(s->object());
   Value rhs = eval(s->value());
   *lhs.get_reference() = rhs;
+  cache.clear();
   return next_ctl;
 }
 
@@ -784,7 +826,7 @@ reduce(Expr const* e)
   // Otherwise, try evaluating.
   try {
     Value v = evaluate(e);
-    return new Literal_expr(e->type(), v);
+    return make<Literal_expr>(e->type(), v);
   } catch (...) {
     return nullptr;
   }
@@ -806,6 +848,8 @@ Evaluator::exec(Function_decl const* fn)
   Module_decl const* m = cast<Module_decl>(fn->context());
   for (Decl const* d : m->declarations())
     eval(d);
+  if (fn->ssa_)
+    return exec(fn->ssa_, {});
 
   // TODO: Check the result code.
   Value result;
@@ -815,3 +859,76 @@ Evaluator::exec(Function_decl const* fn)
 
   return result;
 }
+
+
+// Execute a function in SSA form. The operands of the phi
+// nodes of a block are selected by the block from which
+// control entered, and are read before any are assigned.
+Value
+Evaluator::exec(Ssa_function const* fn, Value_seq const& args)
+{
+  Value_seq vals(fn->size);
+  std::vector<Value> phis;
+  Ssa_block const* prev = nullptr;
+  Ssa_block const* b = fn->entry();
+  while (true) {
+    std::vector<Ssa_inst*> const& is = b->insts;
+    std::size_t n = 0;
+    phis.clear();
+    for (; n < is.size() && is[n]->op == phi_op; ++n) {
+      Ssa_inst const* p = is[n];
+      auto iter = std::find(p->blocks.begin(), p->blocks.end(), prev);
+      phis.push_back(vals[p->ops[iter - p->blocks.begin()]->id]);
+    }
+    for (std::size_t k = 0; k < n; ++k)
+      vals[is[k]->id] = phis[k];
+
+    for (; n < is.size(); ++n) {
+      Ssa_inst const* i = is[n];
+      Value& v = vals[i->id];
+      switch (i->op) {
+        case const_op:
+          v = i->value;
+          break;
+
+        case arg_op:
+          v = args[i->arg];
+          break;
+
+        case neg_op:
+        case not_op:
+          v = apply(i->op, i->ops[0]->type, vals[i->ops[0]->id]);
+          break;
+
+        case call_op: {
+          Function_decl const* f = vals[i->ops[0]->id].get_function();
+          Value_seq xs;
+          for (std::size_t k = 1; k < i->ops.size(); ++k)
+            xs.push_back(vals[i->ops[k]->id]);
+          v = call(f, xs);
+          break;
+        }
+
+        case br_op:
+          prev = b;
+          b = i->blocks[0];
+          break;
+
+        case cond_br_op:
+          prev = b;
+          b = i->blocks[vals[i->ops[0]->id].get_integer() ? 0 : 1];
+          break;
+
+        case ret_op:
+          return vals[i->ops[0]->id];
+
+        case unreachable_op:
+          throw std::runtime_error("function evaluation failed");
+
+        default:
+          v = apply(i->op, i->ops[0]->type, vals[i->ops[0]->id], vals[i->ops[1]->id]);
+          break;
+      }
+    }
+  }
+}
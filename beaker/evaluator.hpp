@@ -8,6 +8,11 @@
 #include <beaker/value.hpp>
 #include <beaker/environment.hpp>
 
+#include <unordered_map>
+
+
+struct Ssa_function;
+
 
 // Dynamic binding of symbols to their values.
 using Store = Environment<Symbol const*, Value>;
@@ -23,6 +28,12 @@ using Store = Environment<Symbol const*, Value>;
 using Store_stack = Stack<Store>;
 
 
+// The values of shared expressions. A value is reused
+// until an assignment, initialization, or call might
+// change it.
+using Value_cache = std::unordered_map<Expr const*, Value>;
+
+
 // Represents the evaluation of a statement.
 // This determines the next action to be
 // taken.
@@ -99,10 +110,14 @@ public:
   Control eval(Expression_stmt const*, Value&);
   Control eval(Declaration_stmt const*, Value&);
 
+  Value call(Function_decl const*, Value_seq&);
+
   Value exec(Function_decl const*);
+  Value exec(Ssa_function const*, Value_seq const&);
 
 private:
   Store_stack stack;
+  Value_cache cache;
 };
 
 
@@ -113,11 +128,13 @@ struct Evaluator::Store_sentinel
     : eval(e)
   {
     eval.stack.push();
+    eval.cache.clear();
   }
 
   ~Store_sentinel()
   {
     eval.stack.pop();
+    eval.cache.clear();
   }
 
   Evaluator& eval;
@@ -11,7 +11,7 @@
 
 
 Decl_expr::Decl_expr(Type const* t, Decl* d)
-  : Id_expr(t, d->name()), decl(d)
+  : Id_expr(node_kind, t, d->name()), decl(d)
 { }
 
 
@@ -10,22 +10,73 @@
 #include <beaker/value.hpp>
 
 
+// The kinds of expressions. Every expression records its
+// kind so that it can be classified without a virtual
+// call.
+//
+// Note that kinds are ordered so that the kinds of an
+// expression and its derived expressions form a
+// contiguous range.
+enum Expr_kind : unsigned char
+{
+  literal_expr,
+  id_expr,
+  decl_expr,
+  overload_expr,
+  lambda_expr,
+  add_expr,
+  sub_expr,
+  mul_expr,
+  div_expr,
+  rem_expr,
+  eq_expr,
+  ne_expr,
+  lt_expr,
+  gt_expr,
+  le_expr,
+  ge_expr,
+  and_expr,
+  or_expr,
+  neg_expr,
+  pos_expr,
+  not_expr,
+  call_expr,
+  dot_expr,
+  field_expr,
+  method_expr,
+  index_expr,
+  value_conv,
+  block_conv,
+  base_conv,
+  promote_conv,
+  default_init,
+  trivial_init,
+  copy_init,
+  reference_init,
+};
+
+
 // The Expr class represents the set of all expressions
 // that defined by the language.
 //
 // Note that every expression has a type. The type is
 // not initialized during parsing, but during elaboration.
+//
+// An expression is shared when common subexpression
+// elimination has found that it occurs more than once
+// in a basic block. The evaluator and code generator
+// may reuse the value of a shared expression.
 struct Expr
 {
   struct Visitor;
   struct Mutator;
 
-  Expr()
-    : type_(nullptr)
+  Expr(Expr_kind k)
+    : kind_(k), shared_(false), type_(nullptr)
   { }
 
-  Expr(Type const* t)
-    : type_(t)
+  Expr(Expr_kind k, Type const* t)
+    : kind_(k), shared_(false), type_(t)
   { }
 
   virtual ~Expr() { }
@@ -33,9 +84,15 @@ struct Expr
   virtual void accept(Visitor&) const = 0;
   virtual void accept(Mutator&) = 0;
 
+  Expr_kind   kind() const        { return kind_; }
   Type const* type() const        { return type_; }
   void        type(Type const* t) { type_ = t; }
 
+  bool is_shared() const { return shared_; }
+  void share()           { shared_ = true; }
+
+  Expr_kind   kind_;
+  bool        shared_;
   Type const* type_;
 };
 
@@ -135,8 +192,10 @@ struct Expr::Mutator
 // of object creation. It cannot be deduced.
 struct Literal_expr : Expr
 {
+  static constexpr Expr_kind node_kind = literal_expr;
+
   Literal_expr(Type const* t, Value const& v)
-    : Expr(t), val(v)
+    : Expr(node_kind, t), val(v)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -152,12 +211,22 @@ struct Literal_expr : Expr
 // is an unresolved expression.
 struct Id_expr : Expr
 {
+  static constexpr Expr_kind node_kind = id_expr;
+
   Id_expr(Symbol const* s)
-    : sym(s)
+    : Expr(node_kind), sym(s)
   { }
 
   Id_expr(Type const* t, Symbol const* s)
-    : Expr(t), sym(s)
+    : Expr(node_kind, t), sym(s)
+  { }
+
+  Id_expr(Expr_kind k, Symbol const* s)
+    : Expr(k), sym(s)
+  { }
+
+  Id_expr(Expr_kind k, Type const* t, Symbol const* s)
+    : Expr(k, t), sym(s)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -174,6 +243,8 @@ struct Id_expr : Expr
 // by the elaboration of id expressions.
 struct Decl_expr : Id_expr
 {
+  static constexpr Expr_kind node_kind = decl_expr;
+
   Decl_expr(Type const*, Decl*);
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -188,8 +259,10 @@ struct Decl_expr : Id_expr
 
 struct Lambda_expr : Expr
 {
+  static constexpr Expr_kind node_kind = lambda_expr;
+
   Lambda_expr(Symbol const * s, Decl_seq const& d, Type const * t, Stmt* const& b)
-    : sym_(s), parms_(d), type_(t), body_(b)
+    : Expr(node_kind), sym_(s), parms_(d), type_(t), body_(b)
   { }
 
   Decl_seq const&      parameters() const { return parms_; }
@@ -219,8 +292,10 @@ struct Lambda_expr : Expr
 // untyped.
 struct Overload_expr : Id_expr
 {
+  static constexpr Expr_kind node_kind = overload_expr;
+
   Overload_expr(Overload* o)
-    : Id_expr(o->name()), ovl(o)
+    : Id_expr(node_kind, o->name()), ovl(o)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -236,8 +311,8 @@ struct Overload_expr : Id_expr
 // A helper class  for unary expressions.
 struct Unary_expr : Expr
 {
-  Unary_expr(Expr* e)
-    : first(e)
+  Unary_expr(Expr_kind k, Expr* e)
+    : Expr(k), first(e)
   { }
 
   Expr* operand() const { return first; }
@@ -249,8 +324,8 @@ struct Unary_expr : Expr
 // A helper function for binary expressions.
 struct Binary_expr : Expr
 {
-  Binary_expr(Expr* e1, Expr* e2)
-    : first(e1), second(e2)
+  Binary_expr(Expr_kind k, Expr* e1, Expr* e2)
+    : Expr(k), first(e1), second(e2)
   { }
 
   Expr* left() const { return first; }
@@ -264,7 +339,11 @@ struct Binary_expr : Expr
 // The expression e1 + e2.
 struct Add_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = add_expr;
+
+  Add_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -274,7 +353,11 @@ struct Add_expr : Binary_expr
 // The expression e1 - e2.
 struct Sub_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = sub_expr;
+
+  Sub_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -284,7 +367,11 @@ struct Sub_expr : Binary_expr
 // The expression e1 * e2.
 struct Mul_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = mul_expr;
+
+  Mul_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -294,7 +381,11 @@ struct Mul_expr : Binary_expr
 // The expression e1 / e2.
 struct Div_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = div_expr;
+
+  Div_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -304,7 +395,11 @@ struct Div_expr : Binary_expr
 // The expression e1 % e2.
 struct Rem_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = rem_expr;
+
+  Rem_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -314,7 +409,11 @@ struct Rem_expr : Binary_expr
 // The expression -e.
 struct Neg_expr : Unary_expr
 {
-  using Unary_expr::Unary_expr;
+  static constexpr Expr_kind node_kind = neg_expr;
+
+  Neg_expr(Expr* e)
+    : Unary_expr(node_kind, e)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -324,7 +423,11 @@ struct Neg_expr : Unary_expr
 // The expression +e.
 struct Pos_expr : Unary_expr
 {
-  using Unary_expr::Unary_expr;
+  static constexpr Expr_kind node_kind = pos_expr;
+
+  Pos_expr(Expr* e)
+    : Unary_expr(node_kind, e)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -334,7 +437,11 @@ struct Pos_expr : Unary_expr
 // The expression e1 == e2.
 struct Eq_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = eq_expr;
+
+  Eq_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -344,7 +451,11 @@ struct Eq_expr : Binary_expr
 // The expression e1 != e2.
 struct Ne_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = ne_expr;
+
+  Ne_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -354,7 +465,11 @@ struct Ne_expr : Binary_expr
 // The expression e1 < e2.
 struct Lt_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = lt_expr;
+
+  Lt_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -364,7 +479,11 @@ struct Lt_expr : Binary_expr
 // The expression e1 > e2.
 struct Gt_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = gt_expr;
+
+  Gt_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -374,7 +493,11 @@ struct Gt_expr : Binary_expr
 // The expression e1 <= e2.
 struct Le_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = le_expr;
+
+  Le_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -384,7 +507,11 @@ struct Le_expr : Binary_expr
 // The expression e1 >= e2.
 struct Ge_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = ge_expr;
+
+  Ge_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -394,7 +521,11 @@ struct Ge_expr : Binary_expr
 // The expression e1 && e2.
 struct And_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = and_expr;
+
+  And_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -404,7 +535,11 @@ struct And_expr : Binary_expr
 // The expression e1 || e2.
 struct Or_expr : Binary_expr
 {
-  using Binary_expr::Binary_expr;
+  static constexpr Expr_kind node_kind = or_expr;
+
+  Or_expr(Expr* e1, Expr* e2)
+    : Binary_expr(node_kind, e1, e2)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -414,7 +549,11 @@ struct Or_expr : Binary_expr
 // The expression !e.
 struct Not_expr : Unary_expr
 {
-  using Unary_expr::Unary_expr;
+  static constexpr Expr_kind node_kind = not_expr;
+
+  Not_expr(Expr* e)
+    : Unary_expr(node_kind, e)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -429,24 +568,26 @@ struct Not_expr : Unary_expr
 // that the target is a decl-expr referring to a function.
 struct Call_expr : Expr
 {
+  static constexpr Expr_kind node_kind = call_expr;
+
   Call_expr(Expr* f, Expr_seq const& a)
-    : first(f), second(a)
+    : Expr(node_kind), first(f), second(a)
   { }
 
-    Call_expr(Type const* t, Expr* f, Expr_seq const& a)
-    : Expr(t), first(f), second(a)
+  Call_expr(Type const* t, Expr* f, Expr_seq const& a)
+    : Expr(node_kind, t), first(f), second(a)
   { }
 
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
 
-  Expr*           target() const    { return first; }
-  Expr_seq const& arguments() const { return second; }
-  Expr_seq&       arguments()       { return second; }
+  Expr*            target() const    { return first; }
+  Expr_list const& arguments() const { return second; }
+  Expr_list&       arguments()       { return second; }
 
-  Expr*    first;
-  Expr_seq second;
+  Expr*     first;
+  Expr_list second;
 };
 
 
@@ -456,12 +597,22 @@ struct Call_expr : Expr
 // The type of the expression is always that of e2.
 struct Dot_expr : Expr
 {
+  static constexpr Expr_kind node_kind = dot_expr;
+
   Dot_expr(Expr* e1, Expr* e2)
-    : Expr(e2->type()), first(e1), second(e2)
+    : Expr(node_kind, e2->type()), first(e1), second(e2)
   { }
 
   Dot_expr(Type const* t, Expr* e1, Expr* e2)
-    : Expr(t), first(e1), second(e2)
+    : Expr(node_kind, t), first(e1), second(e2)
+  { }
+
+  Dot_expr(Expr_kind k, Expr* e1, Expr* e2)
+    : Expr(k, e2->type()), first(e1), second(e2)
+  { }
+
+  Dot_expr(Expr_kind k, Type const* t, Expr* e1, Expr* e2)
+    : Expr(k, t), first(e1), second(e2)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -475,7 +626,8 @@ struct Dot_expr : Expr
 };
 
 
-using Field_path = std::vector<int>;
+// A sequence of subobject indexes.
+using Field_path = Span<int>;
 
 
 // An expression of the form e.f where e has record
@@ -496,8 +648,10 @@ using Field_path = std::vector<int>;
 // inherit members.
 struct Field_expr : Dot_expr
 {
+  static constexpr Expr_kind node_kind = field_expr;
+
   Field_expr(Type const* t, Expr* e1, Expr* e2, Decl* v, Field_path const& p)
-    : Dot_expr(t, e1, e2), var(v), path_(p)
+    : Dot_expr(node_kind, t, e1, e2), var(v), path_(p)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -516,8 +670,10 @@ struct Field_expr : Dot_expr
 // a method in the type of e.
 struct Method_expr : Dot_expr
 {
+  static constexpr Expr_kind node_kind = method_expr;
+
   Method_expr(Expr* e1, Expr* e2, Decl* d)
-    : Dot_expr(e1, e2), fn(d)
+    : Dot_expr(node_kind, e1, e2), fn(d)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -533,8 +689,10 @@ struct Method_expr : Dot_expr
 // has array type.
 struct Index_expr : Expr
 {
+  static constexpr Expr_kind node_kind = index_expr;
+
   Index_expr(Expr* e1, Expr* e2)
-    : first(e1), second(e2)
+    : Expr(node_kind), first(e1), second(e2)
   { }
 
   void accept(Visitor& v) const { v.visit(this); }
@@ -555,8 +713,8 @@ struct Index_expr : Expr
 // a target type.
 struct Conv : Expr
 {
-  Conv(Type const* t, Expr* e)
-    : Expr(t), first(e)
+  Conv(Expr_kind k, Type const* t, Expr* e)
+    : Expr(k, t), first(e)
   { }
 
   Expr*       source() const { return first; }
@@ -569,7 +727,11 @@ struct Conv : Expr
 // Represents the conversion of a reference to a value.
 struct Value_conv : Conv
 {
-  using Conv::Conv;
+  static constexpr Expr_kind node_kind = value_conv;
+
+  Value_conv(Type const* t, Expr* e)
+    : Conv(node_kind, t, e)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -579,7 +741,11 @@ struct Value_conv : Conv
 // Represents the conversion of an array to a block.
 struct Block_conv : Conv
 {
-  using Conv::Conv;
+  static constexpr Expr_kind node_kind = block_conv;
+
+  Block_conv(Type const* t, Expr* e)
+    : Conv(node_kind, t, e)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -588,8 +754,13 @@ struct Block_conv : Conv
 // Represents the conversion of a base class to a derived class
 struct Base_conv : Conv
 {
-  using Method_path = std::vector<int>;
-  using Conv::Conv;
+  static constexpr Expr_kind node_kind = base_conv;
+
+  using Method_path = Span<int>;
+
+  Base_conv(Type const* t, Expr* e)
+    : Conv(node_kind, t, e)
+  { }
 
   Method_path path_;
 
@@ -601,7 +772,11 @@ struct Base_conv : Conv
 // Represents the promoton of a numeric type
 struct Promote_conv : Conv
 {
-  using Conv::Conv;
+  static constexpr Expr_kind node_kind = promote_conv;
+
+  Promote_conv(Type const* t, Expr* e)
+    : Conv(node_kind, t, e)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -632,8 +807,8 @@ struct Promote_conv : Conv
 // well.
 struct Init : Expr
 {
-  Init(Type const* t)
-    : Expr(t)
+  Init(Expr_kind k, Type const* t)
+    : Expr(k, t), decl_(nullptr)
   { }
 
   Decl const* declaration() const { return decl_; }
@@ -650,7 +825,11 @@ struct Init : Expr
 //    (ref T) -> void
 struct Default_init : Init
 {
-  using Init::Init;
+  static constexpr Expr_kind node_kind = default_init;
+
+  Default_init(Type const* t)
+    : Init(node_kind, t)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -661,7 +840,11 @@ struct Default_init : Init
 // of the given type.
 struct Trivial_init : Init
 {
-  using Init::Init;
+  static constexpr Expr_kind node_kind = trivial_init;
+
+  Trivial_init(Type const* t)
+    : Init(node_kind, t)
+  { }
 
   void accept(Visitor& v) const { v.visit(this); }
   void accept(Mutator& v)       { v.visit(this); }
@@ -676,8 +859,10 @@ struct Trivial_init : Init
 //    (ref const T) -> void
 struct Copy_init : Init
 {
+  static constexpr Expr_kind node_kind = copy_init;
+
   Copy_init(Type const* t, Expr* e)
-    : Init(t), first(e)
+    : Init(node_kind, t), first(e)
   { }
 
   Expr* value() const { return first; }
@@ -692,8 +877,10 @@ struct Copy_init : Init
 // Performs reference initialization.
 struct Reference_init : Init
 {
+  static constexpr Expr_kind node_kind = reference_init;
+
   Reference_init(Type const* t, Expr* e)
-    : Init(t), first(e)
+    : Init(node_kind, t), first(e)
   { }
 
   Expr* object() const { return first; }
@@ -832,4 +1019,186 @@ apply(Expr* e, F fn)
 }
 
 
+// -------------------------------------------------------------------------- //
+// Kind dispatch
+
+// The range of kinds of expressions of type T. This is
+// specialized for expressions that have derived expressions.
+template<typename T>
+struct Expr_kinds
+{
+  static constexpr Expr_kind first = T::node_kind;
+  static constexpr Expr_kind last  = T::node_kind;
+};
+
+template<>
+struct Expr_kinds<Expr>
+{
+  static constexpr Expr_kind first = literal_expr;
+  static constexpr Expr_kind last  = reference_init;
+};
+
+template<>
+struct Expr_kinds<Id_expr>
+{
+  static constexpr Expr_kind first = id_expr;
+  static constexpr Expr_kind last  = overload_expr;
+};
+
+template<>
+struct Expr_kinds<Binary_expr>
+{
+  static constexpr Expr_kind first = add_expr;
+  static constexpr Expr_kind last  = or_expr;
+};
+
+template<>
+struct Expr_kinds<Unary_expr>
+{
+  static constexpr Expr_kind first = neg_expr;
+  static constexpr Expr_kind last  = not_expr;
+};
+
+template<>
+struct Expr_kinds<Dot_expr>
+{
+  static constexpr Expr_kind first = dot_expr;
+  static constexpr Expr_kind last  = method_expr;
+};
+
+template<>
+struct Expr_kinds<Conv>
+{
+  static constexpr Expr_kind first = value_conv;
+  static constexpr Expr_kind last  = promote_conv;
+};
+
+template<>
+struct Expr_kinds<Init>
+{
+  static constexpr Expr_kind first = default_init;
+  static constexpr Expr_kind last  = reference_init;
+};
+
+
+// Returns true if e is an expression of type T. This is a
+// comparison of kinds and does not require a dynamic cast.
+template<typename T>
+inline bool
+is(Expr const* e)
+{
+  using R = Expr_kinds<T>;
+  return e && R::first <= e->kind() && e->kind() <= R::last;
+}
+
+
+// Returns e as an expression of type T, or nullptr if e
+// is not a T.
+template<typename T>
+inline T*
+as(Expr* e)
+{
+  return is<T>(e) ? static_cast<T*>(e) : nullptr;
+}
+
+
+template<typename T>
+inline T const*
+as(Expr const* e)
+{
+  return is<T>(e) ? static_cast<T const*>(e) : nullptr;
+}
+
+
+// Apply fn to e, dispatching on its kind. This has the
+// same effect as apply(), but selects the function with
+// a single switch instead of calling through a visitor.
+template<typename F, typename T = typename std::result_of<F(Literal_expr const*)>::type>
+inline T
+dispatch(Expr const* e, F fn)
+{
+  switch (e->kind()) {
+    case literal_expr: return fn(static_cast<Literal_expr const*>(e));
+    case id_expr: return fn(static_cast<Id_expr const*>(e));
+    case decl_expr: return fn(static_cast<Decl_expr const*>(e));
+    case overload_expr: return fn(static_cast<Overload_expr const*>(e));
+    case lambda_expr: return fn(static_cast<Lambda_expr const*>(e));
+    case add_expr: return fn(static_cast<Add_expr const*>(e));
+    case sub_expr: return fn(static_cast<Sub_expr const*>(e));
+    case mul_expr: return fn(static_cast<Mul_expr const*>(e));
+    case div_expr: return fn(static_cast<Div_expr const*>(e));
+    case rem_expr: return fn(static_cast<Rem_expr const*>(e));
+    case eq_expr: return fn(static_cast<Eq_expr const*>(e));
+    case ne_expr: return fn(static_cast<Ne_expr const*>(e));
+    case lt_expr: return fn(static_cast<Lt_expr const*>(e));
+    case gt_expr: return fn(static_cast<Gt_expr const*>(e));
+    case le_expr: return fn(static_cast<Le_expr const*>(e));
+    case ge_expr: return fn(static_cast<Ge_expr const*>(e));
+    case and_expr: return fn(static_cast<And_expr const*>(e));
+    case or_expr: return fn(static_cast<Or_expr const*>(e));
+    case neg_expr: return fn(static_cast<Neg_expr const*>(e));
+    case pos_expr: return fn(static_cast<Pos_expr const*>(e));
+    case not_expr: return fn(static_cast<Not_expr const*>(e));
+    case call_expr: return fn(static_cast<Call_expr const*>(e));
+    case dot_expr: return fn(static_cast<Dot_expr const*>(e));
+    case field_expr: return fn(static_cast<Field_expr const*>(e));
+    case method_expr: return fn(static_cast<Method_expr const*>(e));
+    case index_expr: return fn(static_cast<Index_expr const*>(e));
+    case value_conv: return fn(static_cast<Value_conv const*>(e));
+    case block_conv: return fn(static_cast<Block_conv const*>(e));
+    case base_conv: return fn(static_cast<Base_conv const*>(e));
+    case promote_conv: return fn(static_cast<Promote_conv const*>(e));
+    case default_init: return fn(static_cast<Default_init const*>(e));
+    case trivial_init: return fn(static_cast<Trivial_init const*>(e));
+    case copy_init: return fn(static_cast<Copy_init const*>(e));
+    case reference_init: return fn(static_cast<Reference_init const*>(e));
+  }
+  lingo_unreachable();
+}
+
+
+template<typename F, typename T = typename std::result_of<F(Literal_expr*)>::type>
+inline T
+dispatch(Expr* e, F fn)
+{
+  switch (e->kind()) {
+    case literal_expr: return fn(static_cast<Literal_expr*>(e));
+    case id_expr: return fn(static_cast<Id_expr*>(e));
+    case decl_expr: return fn(static_cast<Decl_expr*>(e));
+    case overload_expr: return fn(static_cast<Overload_expr*>(e));
+    case lambda_expr: return fn(static_cast<Lambda_expr*>(e));
+    case add_expr: return fn(static_cast<Add_expr*>(e));
+    case sub_expr: return fn(static_cast<Sub_expr*>(e));
+    case mul_expr: return fn(static_cast<Mul_expr*>(e));
+    case div_expr: return fn(static_cast<Div_expr*>(e));
+    case rem_expr: return fn(static_cast<Rem_expr*>(e));
+    case eq_expr: return fn(static_cast<Eq_expr*>(e));
+    case ne_expr: return fn(static_cast<Ne_expr*>(e));
+    case lt_expr: return fn(static_cast<Lt_expr*>(e));
+    case gt_expr: return fn(static_cast<Gt_expr*>(e));
+    case le_expr: return fn(static_cast<Le_expr*>(e));
+    case ge_expr: return fn(static_cast<Ge_expr*>(e));
+    case and_expr: return fn(static_cast<And_expr*>(e));
+    case or_expr: return fn(static_cast<Or_expr*>(e));
+    case neg_expr: return fn(static_cast<Neg_expr*>(e));
+    case pos_expr: return fn(static_cast<Pos_expr*>(e));
+    case not_expr: return fn(static_cast<Not_expr*>(e));
+    case call_expr: return fn(static_cast<Call_expr*>(e));
+    case dot_expr: return fn(static_cast<Dot_expr*>(e));
+    case field_expr: return fn(static_cast<Field_expr*>(e));
+    case method_expr: return fn(static_cast<Method_expr*>(e));
+    case index_expr: return fn(static_cast<Index_expr*>(e));
+    case value_conv: return fn(static_cast<Value_conv*>(e));
+    case block_conv: return fn(static_cast<Block_conv*>(e));
+    case base_conv: return fn(static_cast<Base_conv*>(e));
+    case promote_conv: return fn(static_cast<Promote_conv*>(e));
+    case default_init: return fn(static_cast<Default_init*>(e));
+    case trivial_init: return fn(static_cast<Trivial_init*>(e));
+    case copy_init: return fn(static_cast<Copy_init*>(e));
+    case reference_init: return fn(static_cast<Reference_init*>(e));
+  }
+  lingo_unreachable();
+}
+
+
 #endif
@@ -19,6 +19,8 @@ get_file_kind(Path const& p)
   Path ext = p.extension();
   if (ext == ".bkr")
     return beaker_file;
+  if (ext == ".bmi")
+    return interface_file;
   if (ext == ".ll")
     return ir_file;
   if (ext == ".bc")
@@ -46,6 +46,7 @@ enum File_kind
 
   // Input languages
   beaker_file,     // Beaker source text
+  interface_file,  // Binary module interface
   
   // Intermediate languages
   ir_file,         // LLVM source text
@@ -97,6 +98,15 @@ to_asm_file(Path p)
 }
 
 
+// Return a new path by replacing the extension
+// with a .bmi extension.
+inline Path
+to_interface_file(Path p)
+{
+  return p.replace_extension(".bmi");
+}
+
+
 // Return a new path by replacing a .s extension
 // with a .o extension.
 inline Path
@@ -9,7 +9,10 @@
 #include "beaker/stmt.hpp"
 #include "beaker/decl.hpp"
 #include "beaker/mangle.hpp"
+#include "beaker/layout.hpp"
+#include "beaker/effects.hpp"
 #include "beaker/evaluator.hpp"
+#include "beaker/ssa.hpp"
 
 #include "llvm/IR/Type.h"
 #include "llvm/IR/GlobalVariable.h"
@@ -17,6 +20,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Config/llvm-config.h"
 
 #include <iostream>
 
@@ -43,6 +47,19 @@ Generator::get_name(Decl const* d)
 }
 
 
+// Returns the linkage of a declaration. A definition in
+// a whole program has internal linkage, unless it is main
+// or foreign, since those are referenced from outside the
+// module.
+llvm::GlobalValue::LinkageTypes
+Generator::get_linkage(Decl const* d, bool def)
+{
+  if (internal && def && !d->is_foreign() && d->name()->spelling() != "main")
+    return llvm::GlobalValue::InternalLinkage;
+  return llvm::GlobalValue::ExternalLinkage;
+}
+
+
 // -------------------------------------------------------------------------- //
 // Mapping of types
 //
@@ -68,7 +85,7 @@ Generator::get_type(Type const* t)
     llvm::Type* operator()(Reference_type const* t) const { return g.get_type(t); }
     llvm::Type* operator()(Record_type const* t) const { return g.get_type(t); }
   };
-  return apply(t, Fn{*this});
+  return dispatch(t, Fn{*this});
 }
 
 
@@ -241,7 +258,18 @@ Generator::gen(Expr const* e)
     llvm::Value* operator()(Init const* e) const { lingo_unreachable(); }
   };
 
-  return apply(e, Fn{*this});
+  if (!e->is_shared())
+    return dispatch(e, Fn{*this});
+
+  // Reuse the value of a shared expression if it was
+  // computed in the current block. Its value dominates
+  // the remainder of that block.
+  auto iter = shared.find(e);
+  if (iter != shared.end() && iter->second.first == build.GetInsertBlock())
+    return iter->second.second;
+  llvm::Value* v = dispatch(e, Fn{*this});
+  shared[e] = {build.GetInsertBlock(), v};
+  return v;
 }
 
 
@@ -268,7 +296,7 @@ struct Gen_init_fn
 void
 Generator::gen_init(llvm::Value* ptr, Expr const* e)
 {
-  apply(e, Gen_init_fn{*this, ptr});
+  dispatch(e, Gen_init_fn{*this, ptr});
 }
 
 
@@ -551,7 +579,7 @@ Generator::gen(Call_expr const* e)
   // type is known.
   llvm::Value* fn;
   if (Method_decl const* m = calls_virtual_method(e)) {
-    Expr_seq const& args = e->arguments();
+    Expr_list const& args = e->arguments();
 
     // Get (and load) the virtual function pointer.
     llvm::Value* vptr = gen_vptr(args.front());
@@ -568,6 +596,11 @@ Generator::gen(Call_expr const* e)
   std::vector<llvm::Value*> args;
   for (Expr const* a : e->arguments())
     args.push_back(gen(a));
+
+  // The callee may modify any object, unless it is
+  // known not to write memory.
+  if (get_effects(e).writes)
+    shared.clear();
   return build.CreateCall(fn, args);
 }
 
@@ -668,11 +701,25 @@ Generator::gen(Block_conv const* e)
 // Build a GEP to the base class sub-object. Note that
 // for derivation from the first base class, a bit-cast
 // would be appropriate.
+// Convert to a base class by following the base subobjects
+// of each record. An empty base is not stored, so the
+// address of the object is used as the address of the base.
 llvm::Value*
 Generator::gen(Base_conv const* e)
 {
   llvm::Value* a = gen(e->source());
-  std::vector<llvm::Value*> args(e->path().size(), build.getInt32(0));
+  Record_decl* r = cast<Record_type>(e->source()->type()->nonref())->declaration();
+  std::vector<llvm::Value*> args {build.getInt32(0)};
+  for (std::size_t i = 1; i < e->path().size(); ++i) {
+    Layout const& l = get_layout(r);
+    r = r->base_declaration();
+    if (l.base < 0) {
+      llvm::Value* p = build.CreateGEP(a, args);
+      llvm::Type* t = llvm::PointerType::getUnqual(get_type(get_record_type(r)));
+      return build.CreateBitCast(p, t);
+    }
+    args.push_back(build.getInt32(l.base));
+  }
   return build.CreateGEP(a, args);
 }
 
@@ -754,7 +801,7 @@ Generator::gen(Stmt const* s)
     void operator()(Expression_stmt const* s) { g.gen(s); }
     void operator()(Declaration_stmt const* s) { g.gen(s); }
   };
-  apply(s, Fn{*this});
+  dispatch(s, Fn{*this});
 }
 
 
@@ -790,6 +837,7 @@ Generator::gen(Assign_stmt const* s)
   llvm::Value* lhs = gen(s->object());
   llvm::Value* rhs = gen(s->value());
   build.CreateStore(rhs, lhs);
+  shared.clear();
 }
 
 
@@ -943,7 +991,7 @@ Generator::gen(Decl const* d)
     void operator()(Method_decl const* d) { return g.gen(d); }
     void operator()(Module_decl const* d) { return g.gen(d); }
   };
-  return apply(d, Fn{*this});
+  return dispatch(d, Fn{*this});
 }
 
 
@@ -971,7 +1019,8 @@ Generator::gen_local(Variable_decl const* d)
   // happen before initialization. Also, note that
   // polymorphic types cannot be zero-initialized.
   // Only member-wise initialized.
-  if (Record_type const* rt = as<Record_type>(d->type())) {
+  Record_type const* rt = as<Record_type>(d->type());
+  if (rt && !get_layout(rt->declaration()).vref.empty()) {
     Record_decl const* rec = rt->declaration();
     llvm::Value* vtbl = vtables.find(rec)->second;
     llvm::Value* vref = gen_vref(rec, ptr);
@@ -992,7 +1041,7 @@ Generator::gen_global(Variable_decl const* d)
   // then generate that constant. If not, we need dynamic
   // initialization of global variables.
   llvm::Constant* init = nullptr;
-  if (!d->is_foreign())
+  if (!d->is_foreign() && !d->is_imported())
     init = llvm::Constant::getNullValue(type);
 
 
@@ -1005,7 +1054,7 @@ Generator::gen_global(Variable_decl const* d)
     *mod,                                  // owning module
     type,                                  // type
     false,                                 // is constant
-    llvm::GlobalVariable::ExternalLinkage, // linkage,
+    get_linkage(d, init),                  // linkage,
     init,                                  // initializer
     name                                   // name
   );
@@ -1031,6 +1080,42 @@ Generator::gen(Variable_decl const* d)
 }
 
 
+namespace
+{
+
+// Emit the inferred effects of a function as attributes.
+// Before LLVM 5, parameter attributes are numbered from 1.
+void
+set_effects(llvm::Function* fn, Effects const& e)
+{
+  if (!e.reads && !e.writes)
+    fn->setDoesNotAccessMemory();
+  else if (!e.writes)
+    fn->setOnlyReadsMemory();
+  if (!e.unwinds)
+    fn->setDoesNotThrow();
+#if LLVM_VERSION_MAJOR > 3 || LLVM_VERSION_MINOR >= 8
+  if (!e.recurses)
+    fn->addFnAttr(llvm::Attribute::NoRecurse);
+#endif
+#if LLVM_VERSION_MAJOR >= 10
+  if (e.returns)
+    fn->addFnAttr(llvm::Attribute::WillReturn);
+#endif
+  for (std::size_t i = 0; i < e.capture.size(); ++i) {
+    if (e.capture[i])
+      continue;
+#if LLVM_VERSION_MAJOR >= 5
+    fn->addParamAttr(i, llvm::Attribute::NoCapture);
+#else
+    fn->addAttribute(i + 1, llvm::Attribute::NoCapture);
+#endif
+  }
+}
+
+} // namespace
+
+
 void
 Generator::gen(Function_decl const* d)
 {
@@ -1042,7 +1127,7 @@ Generator::gen(Function_decl const* d)
   llvm::FunctionType* ftype = llvm::cast<llvm::FunctionType>(type);
   fn = llvm::Function::Create(
     ftype,                           // function type
-    llvm::Function::ExternalLinkage, // linkage
+    get_linkage(d, d->body()),       // linkage
     name,                            // name
     mod);                            // owning module
 
@@ -1053,6 +1138,14 @@ Generator::gen(Function_decl const* d)
   // do any of this stuff...
   if (!d->body())
     return;
+  set_effects(fn, get_effects(d));
+
+  // A function in SSA form is generated from that form.
+  if (d->ssa_) {
+    gen(d->ssa_);
+    fn = nullptr;
+    return;
+  }
 
   // Establish a new binding environment for declarations
   // related to this function.
@@ -1078,6 +1171,7 @@ Generator::gen(Function_decl const* d)
   }
 
   // Build the entry and exit blocks for the function.
+  shared.clear();
   entry = llvm::BasicBlock::Create(cxt, "entry", fn);
   exit = llvm::BasicBlock::Create(cxt, "exit");
   build.SetInsertPoint(entry);
@@ -1105,6 +1199,104 @@ Generator::gen(Function_decl const* d)
 }
 
 
+// Generate the definition of the current function from
+// its SSA form. Blocks are generated in reverse postorder,
+// so every value is defined before it is used, except in
+// phi nodes. Their operands are added last.
+void
+Generator::gen(Ssa_function const* f)
+{
+  // Function values are pointers to functions.
+  auto value_type = [this](Type const* t) {
+    llvm::Type* r = get_type(t);
+    if (is<Function_type>(t))
+      r = llvm::PointerType::getUnqual(r);
+    return r;
+  };
+
+  std::vector<llvm::BasicBlock*> blocks;
+  for (std::size_t n = 0; n < f->blocks.size(); ++n)
+    blocks.push_back(llvm::BasicBlock::Create(cxt, n ? "" : "entry", fn));
+
+  std::vector<llvm::Value*> vals(f->size);
+  auto ai = fn->arg_begin();
+  for (Ssa_inst const* a : f->args) {
+    vals[a->id] = &*ai;
+    ++ai;
+  }
+
+  for (Ssa_block const* b : f->blocks) {
+    build.SetInsertPoint(blocks[b->id]);
+    for (Ssa_inst const* i : b->insts) {
+      llvm::Value*& v = vals[i->id];
+      auto op = [&vals, i](int n) { return vals[i->ops[n]->id]; };
+      switch (i->op) {
+        case const_op:
+          if (i->value.is_function())
+            v = stack.lookup(i->value.get_function())->second;
+          else if (i->value.is_integer())
+            v = llvm::ConstantInt::get(get_type(i->type), i->value.get_integer());
+          else
+            v = llvm::UndefValue::get(value_type(i->type));
+          break;
+        case arg_op:
+          break;
+        case phi_op:
+          v = build.CreatePHI(value_type(i->type), i->ops.size());
+          break;
+        case add_op: v = build.CreateAdd(op(0), op(1)); break;
+        case sub_op: v = build.CreateSub(op(0), op(1)); break;
+        case mul_op: v = build.CreateMul(op(0), op(1)); break;
+        case div_op: v = build.CreateSDiv(op(0), op(1)); break;
+        case rem_op: v = build.CreateSRem(op(0), op(1)); break;
+        case neg_op: v = build.CreateNeg(op(0)); break;
+        case not_op: v = build.CreateNot(op(0)); break;
+        case eq_op: v = build.CreateICmpEQ(op(0), op(1)); break;
+        case ne_op: v = build.CreateICmpNE(op(0), op(1)); break;
+        case lt_op: v = build.CreateICmpSLT(op(0), op(1)); break;
+        case gt_op: v = build.CreateICmpSGT(op(0), op(1)); break;
+        case le_op: v = build.CreateICmpSLE(op(0), op(1)); break;
+        case ge_op: v = build.CreateICmpSGE(op(0), op(1)); break;
+        case call_op: {
+          std::vector<llvm::Value*> args;
+          for (std::size_t n = 1; n < i->ops.size(); ++n)
+            args.push_back(op(n));
+#if LLVM_VERSION_MAJOR >= 8
+          llvm::FunctionType* t = llvm::cast<llvm::FunctionType>(get_type(i->ops[0]->type));
+          v = build.CreateCall(t, op(0), args);
+#else
+          v = build.CreateCall(op(0), args);
+#endif
+          break;
+        }
+        case br_op:
+          build.CreateBr(blocks[i->blocks[0]->id]);
+          break;
+        case cond_br_op:
+          build.CreateCondBr(op(0), blocks[i->blocks[0]->id], blocks[i->blocks[1]->id]);
+          break;
+        case ret_op:
+          build.CreateRet(op(0));
+          break;
+        case unreachable_op:
+          build.CreateUnreachable();
+          break;
+      }
+    }
+  }
+
+  for (Ssa_block const* b : f->blocks) {
+    for (Ssa_inst const* i : b->insts) {
+      if (i->op != phi_op)
+        break;
+      llvm::PHINode* p = llvm::cast<llvm::PHINode>(vals[i->id]);
+      for (std::size_t n = 0; n < i->ops.size(); ++n)
+        p->addIncoming(vals[i->ops[n]->id], blocks[i->blocks[n]->id]);
+    }
+  }
+}
+
+
 void
 Generator::gen(Parameter_decl const* d)
 {
@@ -1125,31 +1317,31 @@ Generator::gen(Record_decl const* d)
   if (types.lookup(d))
     return;
 
+  // Build the struct from the elements of the record's
+  // layout.
+  Layout const& l = get_layout(d);
   std::vector<llvm::Type*> ts;
-  ts.reserve(16);
+  ts.reserve(l.order.size() + 2);
 
   // If d is the root of a polymorphic type hierarchy,
   // then generate a vptr as its first sub-object. This is
   // represented as an i8* since we haven't generated the
   // the table yet.
-  if (Decl const* vr = d->vref())
-    ts.push_back(get_type(vr->type()));
+  if (l.vptr)
+    ts.push_back(get_type(d->vref()->type()));
 
-  // Add the base class sub-object before fields.
-  //
-  // TODO: Implement the empty base optimization.
-  if (Type const* b = d->base())
-    ts.push_back(get_type(b));
+  // Add the base class sub-object before fields. An
+  // empty base is not stored.
+  if (l.base >= 0)
+    ts.push_back(get_type(d->base()));
 
-  // Construct the type over only the fields. If the record
-  // is empty, generate a struct with exactly one  byte so that
+  // Add the fields in storage order. If the record
+  // is empty, generate a struct with exactly one byte so that
   // we never have a type with 0 size.
-  if (d->fields().empty()) {
+  for (Field_decl const* f : l.order)
+    ts.push_back(get_type(f->type()));
+  if (ts.empty())
     ts.push_back(build.getInt8Ty());
-  } else {
-    for (Decl const* f : d->fields())
-      ts.push_back(get_type(f->type()));
-  }
 
   // This will automatically be added to the module,
   // but if it's not used, then it won't be generated.
@@ -1234,14 +1426,17 @@ Generator::gen_vtable(Record_decl const* d)
   String vtn = "_VT_" + base;
   String vttn = "_VTT_" + base;
   llvm::StructType* vtt = llvm::StructType::create(cxt, types, vttn);
-  llvm::Constant* vti = llvm::ConstantStruct::get(vtt, values);
+  llvm::Constant* vti = nullptr;
+  if (!d->is_imported())
+    vti = llvm::ConstantStruct::get(vtt, values);
 
-  // Generate the vtable global.
+  // Generate the vtable global. The vtable of an imported
+  // record is defined by the module that exported it.
   llvm::GlobalVariable* ret = new llvm::GlobalVariable(
     *mod,                                  // owning module
     vtt,                                   // type
     true,                                  // is constant
-    llvm::GlobalVariable::ExternalLinkage, // linkage,
+    get_linkage(d, vti),                   // linkage,
     vti,                                   // initializer
     vtn                                    // name
   );
@@ -1279,13 +1474,10 @@ Generator::gen_vptr(Record_decl const* r, llvm::Value* obj)
 llvm::Value*
 Generator::gen_vref(Record_decl const* r, llvm::Value* obj)
 {
+  Field_path const& p = get_layout(r).vref;
   std::vector<llvm::Value*> args { build.getInt32(0) };
-  Record_decl const* p = r;
-  while (!p->vref()) {
-    args.push_back(build.getInt32(0));
-    p = p->base_declaration();
-  }
-  args.push_back(build.getInt32(0));
+  for (int n : p)
+    args.push_back(build.getInt32(n));
 
   llvm::Value* ref = build.CreateInBoundsGEP(obj, args);
   llvm::Value* vtbl = vtables.find(r)->second;
@@ -1299,5 +1491,20 @@ Generator::operator()(Decl const* d)
 {
   assert(is<Module_decl>(d));
   gen(d);
+
+  // Internal functions whose addresses are not taken are
+  // only called directly, so they can use the fast calling
+  // convention. Every call must agree with the callee.
+  if (internal) {
+    for (llvm::Function& f : *mod) {
+      if (!f.hasLocalLinkage() || f.hasAddressTaken())
+        continue;
+      f.setCallingConv(llvm::CallingConv::Fast);
+      for (llvm::User* u : f.users()) {
+        if (llvm::CallInst* call = llvm::dyn_cast<llvm::CallInst>(u))
+          call->setCallingConv(llvm::CallingConv::Fast);
+      }
+    }
+  }
   return mod;
 }
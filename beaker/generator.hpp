@@ -14,6 +14,9 @@
 #include <stack>
 
 
+struct Ssa_function;
+
+
 // Used to maintain a mapping of Beaker declarations
 // to their corresponding LLVM declarations. This is
 // used to track the names of globals and parameters.
@@ -46,6 +49,11 @@ using String_env = Environment<String, llvm::Value*>;
 using Vtable_map = std::unordered_map<Decl const*, llvm::GlobalVariable*>;
 
 
+// Associates shared expressions with their values and
+// the blocks in which those values were computed.
+using Value_map = std::unordered_map<Expr const*, std::pair<llvm::BasicBlock*, llvm::Value*>>;
+
+
 struct Generator
 {
   Generator();
@@ -53,6 +61,7 @@ struct Generator
   llvm::Module* operator()(Decl const*);
 
   String get_name(Decl const*);
+  llvm::GlobalValue::LinkageTypes get_linkage(Decl const*, bool);
 
   llvm::Type* get_type(Type const*);
   llvm::Type* get_type(Id_type const*);
@@ -125,6 +134,8 @@ struct Generator
   void gen(Method_decl const*);
   void gen(Module_decl const*);
 
+  void gen(Ssa_function const*);
+
   void gen_local(Variable_decl const*);
   void gen_global(Variable_decl const*);
 
@@ -152,6 +163,11 @@ struct Generator
   Type_env          types;
   String_env        strings;
   Vtable_map        vtables;
+  Value_map         shared;
+
+  // If true, the module is a whole program. Definitions
+  // other than main and foreign declarations are internal.
+  bool              internal;
 
   struct Symbol_sentinel;
   struct Loop_sentinel;
@@ -160,7 +176,7 @@ struct Generator
 
 inline
 Generator::Generator()
-  : cxt(), build(cxt), mod(nullptr)
+  : cxt(), build(cxt), mod(nullptr), internal(false)
 { }
 
 
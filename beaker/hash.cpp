@@ -5,41 +5,300 @@
 
 #include "beaker/hash.hpp"
 #include "beaker/type.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/decl.hpp"
 
-#include <iostream>
+
+namespace
+{
+
+// Returns a hash of an array extent. Extents are hashed
+// structurally so that equal extents hash equally.
+inline std::size_t
+hash_extent(Expr const* e)
+{
+  return e ? hash_value(e) : 0;
+}
+
+} // namespace
 
 
+// Compute the structural hash of a type. The components
+// of a type are canonical, so their cached hashes are
+// combined rather than recomputed.
 std::size_t
 hash_value(Type const* t)
 {
   struct Fn
   {
-    std::hash<void const*> hash_ptr;
-
-    std::size_t operator()(Boolean_type const* t)
+    std::size_t operator()(Id_type const* t)
     {
-      std::size_t h = hash_ptr(t);
-      std::cout << "B: " << h << '\n';
-      return h;
+      return boost::hash_value(t->symbol());
     }
 
+    std::size_t operator()(Boolean_type const* t)   { return 0; }
+    std::size_t operator()(Character_type const* t) { return 0; }
+    std::size_t operator()(Float_type const* t)     { return 0; }
+    std::size_t operator()(Double_type const* t)    { return 0; }
+
     std::size_t operator()(Integer_type const* t)
     {
-      std::size_t h = hash_ptr(t);
-      std::cout << "Z: " << h << '\n';
-      return h;
+      std::size_t seed = 0;
+      boost::hash_combine(seed, t->is_signed());
+      boost::hash_combine(seed, t->precision());
+      return seed;
     }
 
     std::size_t operator()(Function_type const* t)
     {
-      std::size_t seed;
-      boost::hash_combine(seed, t->parameter_types());
-      boost::hash_combine(seed, t->return_type());
+      std::size_t seed = 0;
+      for (Type const* p : t->parameter_types())
+        boost::hash_combine(seed, p->hash());
+      boost::hash_combine(seed, t->return_type()->hash());
+      return seed;
+    }
+
+    std::size_t operator()(Array_type const* t)
+    {
+      std::size_t seed = t->type()->hash();
+      boost::hash_combine(seed, hash_extent(t->extent()));
       return seed;
     }
+
+    std::size_t operator()(Block_type const* t)
+    {
+      return t->type()->hash();
+    }
+
+    std::size_t operator()(Reference_type const* t)
+    {
+      return t->type()->hash();
+    }
+
+    std::size_t operator()(Record_type const* t)
+    {
+      return boost::hash_value(t->declaration());
+    }
   };
 
-  std::size_t h = apply(t, Fn{});
-  std::cout << "H: " << t << ' ' << h << '\n';
+  std::size_t seed = t->kind();
+  boost::hash_combine(seed, dispatch(t, Fn{}));
+  return seed;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Hashing of values
+
+namespace
+{
+
+std::size_t hash_value(Value const&);
+
+
+inline std::size_t
+hash_aggregate(Aggregate_value const& v)
+{
+  std::size_t seed = v.len;
+  for (std::size_t i = 0; i < v.len; ++i)
+    boost::hash_combine(seed, hash_value(v.data[i]));
+  return seed;
+}
+
+
+// Compute the hash of a value. Note that values that
+// are equal under is_less hash to the same value.
+std::size_t
+hash_value(Value const& v)
+{
+  std::size_t seed = v.kind();
+  switch (v.kind()) {
+    case error_value:
+      break;
+    case integer_value:
+      boost::hash_combine(seed, v.get_integer());
+      break;
+    case float_value:
+      boost::hash_combine(seed, v.get_float());
+      break;
+    case function_value:
+      boost::hash_combine(seed, v.get_function());
+      break;
+    case reference_value:
+      boost::hash_combine(seed, v.get_reference());
+      break;
+    case array_value:
+      boost::hash_combine(seed, hash_aggregate(v.get_array()));
+      break;
+    case tuple_value:
+      boost::hash_combine(seed, hash_aggregate(v.get_tuple()));
+      break;
+  }
+  return seed;
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Hashing of expressions
+
+namespace
+{
+
+inline std::size_t
+hash_path(std::size_t seed, Span<int> const& p)
+{
+  for (int n : p)
+    boost::hash_combine(seed, n);
+  return seed;
+}
+
+
+// Computes the hash of an expression node. The hashes of
+// operands are computed by sub.
+template<typename H>
+struct Hash_expr_fn
+{
+  std::size_t operator()(Literal_expr const* e)
+  {
+    return hash_value(e->value());
+  }
+
+  std::size_t operator()(Id_expr const* e)
+  {
+    return boost::hash_value(e->symbol());
+  }
+
+  std::size_t operator()(Decl_expr const* e)
+  {
+    return boost::hash_value(e->declaration());
+  }
+
+  std::size_t operator()(Overload_expr const* e)
+  {
+    return boost::hash_value(&e->declarations());
+  }
+
+  // Lambdas are unique.
+  std::size_t operator()(Lambda_expr const* e)
+  {
+    return boost::hash_value(e);
+  }
+
+  std::size_t operator()(Unary_expr const* e)
+  {
+    return sub(e->operand());
+  }
+
+  std::size_t operator()(Binary_expr const* e)
+  {
+    std::size_t seed = sub(e->left());
+    boost::hash_combine(seed, sub(e->right()));
+    return seed;
+  }
+
+  std::size_t operator()(Call_expr const* e)
+  {
+    std::size_t seed = sub(e->target());
+    for (Expr const* a : e->arguments())
+      boost::hash_combine(seed, sub(a));
+    return seed;
+  }
+
+  std::size_t operator()(Dot_expr const* e)
+  {
+    std::size_t seed = sub(e->container());
+    boost::hash_combine(seed, sub(e->member()));
+    return seed;
+  }
+
+  std::size_t operator()(Field_expr const* e)
+  {
+    std::size_t seed = sub(e->container());
+    boost::hash_combine(seed, e->var);
+    return hash_path(seed, e->path());
+  }
+
+  std::size_t operator()(Method_expr const* e)
+  {
+    std::size_t seed = sub(e->container());
+    boost::hash_combine(seed, e->fn);
+    return seed;
+  }
+
+  std::size_t operator()(Index_expr const* e)
+  {
+    std::size_t seed = sub(e->array());
+    boost::hash_combine(seed, sub(e->index()));
+    return seed;
+  }
+
+  std::size_t operator()(Conv const* e)
+  {
+    return sub(e->source());
+  }
+
+  std::size_t operator()(Base_conv const* e)
+  {
+    return hash_path(sub(e->source()), e->path());
+  }
+
+  std::size_t operator()(Default_init const* e) { return 0; }
+  std::size_t operator()(Trivial_init const* e) { return 0; }
+
+  std::size_t operator()(Copy_init const* e)
+  {
+    return sub(e->value());
+  }
+
+  std::size_t operator()(Reference_init const* e)
+  {
+    return sub(e->object());
+  }
+
+  H sub;
+};
+
+
+// Combine the kind and type of e with the hash of its
+// contents.
+template<typename H>
+std::size_t
+hash_expr(Expr const* e, H sub)
+{
+  std::size_t seed = e->kind();
+  boost::hash_combine(seed, e->type());
+  boost::hash_combine(seed, dispatch(e, Hash_expr_fn<H>{sub}));
+  return seed;
+}
+
+} // namespace
+
+
+// Compute the structural hash of an expression. The hash
+// includes the kind and type of each node, the values of
+// literals, and the identity of referenced declarations.
+// Structurally equal expressions (see is_equal) have the
+// same hash.
+std::size_t
+hash_value(Expr const* e)
+{
+  return hash_expr(e, [](Expr const* x) { return hash_value(x); });
+}
+
+
+// Compute the structural hash of an expression, reusing
+// and recording the hashes of subexpressions in the cache.
+// Each node is hashed once, provided that the expressions
+// in the cache are not modified.
+std::size_t
+hash_value(Expr const* e, Expr_hash_cache& cache)
+{
+  auto iter = cache.find(e);
+  if (iter != cache.end())
+    return iter->second;
+  std::size_t h = hash_expr(e, [&cache](Expr const* x) { return hash_value(x, cache); });
+  cache.emplace(e, h);
   return h;
 }
@@ -13,13 +13,14 @@
 #include <unordered_map>
 
 
-// FIXME: This is broken. The use of boost::hash_combine
-// does not call the appropriate overloads for pointers
-// to AST objects, so equivalent trees produces non-equal
-// hashes.
+std::size_t hash_value(Type const*);
+std::size_t hash_value(Expr const*);
 
 
-std::size_t hash_value(Type const*);
+// Memoized hashes of expressions.
+using Expr_hash_cache = std::unordered_map<Expr const*, std::size_t>;
+
+std::size_t hash_value(Expr const*, Expr_hash_cache&);
 
 
 // A hash function object.
@@ -30,12 +31,13 @@ struct Hash_fn
 };
 
 
+// Hash tables keyed by the structure of nodes.
 template<typename K, typename V>
-using Hash_map = std::unordered_map<K, V, Hash_fn<K>, Equal_fn<K>>;
+using Hash_map = std::unordered_map<K const*, V, Hash_fn<K>, Equal_fn<K>>;
 
 
 template<typename T>
-using Hash_set = std::unordered_set<T, Hash_fn<T>, Equal_fn<T>>;
+using Hash_set = std::unordered_set<T const*, Hash_fn<T>, Equal_fn<T>>;
 
 
 #endif
@@ -0,0 +1,205 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/incremental.hpp"
+#include "beaker/elaborator.hpp"
+#include "beaker/decl.hpp"
+
+#include <boost/functional/hash.hpp>
+
+
+// Compute the fingerprints of the declaration spanning
+// the tokens in [first, last). Token locations are not
+// included, so moving a declaration does not change
+// its fingerprints.
+Fingerprint
+fingerprint(Token_stream::Position first, Token_stream::Position last)
+{
+  Fingerprint fp {0, 0};
+  int entity = 0;    // The entity keyword, once seen
+  bool body = false; // True within a function body
+  for (auto iter = first; iter != last; ++iter) {
+    int k = iter->kind();
+    if (!entity && (k == def_kw || k == var_kw || k == struct_kw))
+      entity = k;
+    if (entity == def_kw && k == lbrace_tok)
+      body = true;
+
+    std::size_t h = k;
+    boost::hash_combine(h, iter->symbol());
+    if (!body)
+      boost::hash_combine(fp.interface, h);
+    boost::hash_combine(fp.definition, h);
+  }
+  return fp;
+}
+
+
+namespace
+{
+
+// Replace the contents of the previously elaborated
+// declaration d0 with those of the newly parsed
+// declaration d1. The identity of d0 is preserved,
+// so that existing references to it remain valid.
+void
+transplant(Decl* d0, Decl* d1)
+{
+  d0->spec_ = d1->spec_;
+  d0->type_ = d1->type_;
+  if (Function_decl* f0 = as<Function_decl>(d0)) {
+    Function_decl* f1 = cast<Function_decl>(d1);
+    f0->parms_ = f1->parms_;
+    f0->body_ = f1->body_;
+    f0->vparms_ = nullptr;
+  } else if (Variable_decl* v0 = as<Variable_decl>(d0)) {
+    v0->init_ = cast<Variable_decl>(d1)->init_;
+  }
+}
+
+
+// Returns true if the node of a declaration can be kept
+// even when its definition must be elaborated again.
+inline bool
+is_transplantable(Decl const* d)
+{
+  return is<Function_decl>(d) || is<Variable_decl>(d);
+}
+
+} // namespace
+
+
+// Elaborate the newly parsed module m, reusing the work
+// of the previous compilation where possible. The prints
+// are the fingerprints of m's declarations. Returns the
+// elaborated module.
+//
+// A new declaration matches a previous declaration with
+// the same name, kind, and interface. A name is changed
+// if it has a declaration that has no match in the other
+// compilation. A matched declaration is clean when its
+// definition is unchanged and none of its dependencies
+// has a changed name. Clean declarations are reused as
+// they are.
+//
+// A matched function or variable that is not clean keeps
+// its node, but takes the contents of the new declaration
+// and is elaborated again. Any other declaration that is
+// not clean is replaced, which changes its name. Because
+// that may affect other records, this is repeated until
+// no more records are replaced.
+Module_decl*
+Build_state::elaborate(std::unique_ptr<Module_decl> mod, Fingerprint_map const& prints, Elaborator& elab)
+{
+  Module_decl* m = mod.get();
+
+  // Index the previous declarations by name.
+  std::unordered_multimap<Symbol const*, Decl*> prev;
+  if (mod_) {
+    for (Decl* d : mod_->declarations())
+      if (prints_.count(d))
+        prev.emplace(d->name(), d);
+  }
+
+  // Match new declarations to previous ones.
+  std::unordered_map<Decl*, Decl*> match;
+  std::unordered_set<Decl const*> matched;
+  std::unordered_set<Symbol const*> changed;
+  for (Decl* d1 : m->declarations()) {
+    auto p1 = prints.find(d1);
+    auto range = prev.equal_range(d1->name());
+    for (auto iter = range.first; iter != range.second; ++iter) {
+      Decl* d0 = iter->second;
+      if (p1 == prints.end() || matched.count(d0))
+        continue;
+      if (d0->kind() != d1->kind())
+        continue;
+      if (prints_.at(d0).interface != p1->second.interface)
+        continue;
+      match.emplace(d1, d0);
+      matched.insert(d0);
+      break;
+    }
+    if (!match.count(d1))
+      changed.insert(d1->name());
+  }
+  for (auto const& x : prev) {
+    if (!matched.count(x.second))
+      changed.insert(x.first);
+  }
+
+  auto is_clean = [&](Decl* d1, Decl* d0) {
+    if (prints_.at(d0).definition != prints.at(d1).definition)
+      return false;
+    for (Decl const* d : deps_[d0])
+      if (changed.count(d->name()))
+        return false;
+    return true;
+  };
+
+  // Replace declarations that cannot be elaborated again
+  // in place.
+  bool again = true;
+  while (again) {
+    again = false;
+    for (auto iter = match.begin(); iter != match.end(); ) {
+      if (!is_transplantable(iter->second) && !is_clean(iter->first, iter->second)) {
+        changed.insert(iter->first->name());
+        iter = match.erase(iter);
+        again = true;
+      } else {
+        ++iter;
+      }
+    }
+  }
+
+  // Build the new list of declarations. Functions
+  // synthesized for the lambdas of clean declarations
+  // are retained, but they are not elaborated again.
+  Decl_seq ds;
+  Decl_seq lambdas;
+  Decl_set reused;
+  Dependency_map deps;
+  Fingerprint_map fps;
+  for (Decl* d1 : m->declarations()) {
+    auto iter = match.find(d1);
+    if (iter == match.end()) {
+      ds.push_back(d1);
+      if (prints.count(d1))
+        fps.emplace(d1, prints.at(d1));
+      continue;
+    }
+
+    Decl* d0 = iter->second;
+    if (is_clean(d1, d0)) {
+      reused.insert(d0);
+      deps[d0] = deps_[d0];
+      for (Decl const* d : deps_[d0]) {
+        if (!prints_.count(d))
+          lambdas.push_back(const_cast<Decl*>(d));
+      }
+    } else {
+      transplant(d0, d1);
+    }
+    ds.push_back(d0);
+    fps.emplace(d0, prints.at(d1));
+  }
+  m->decls_ = Decl_list(ds, m->arena());
+
+  // Elaborate the module, recording the dependencies of
+  // each declaration that is not reused.
+  elab.track(deps);
+  elab.elaborate(m, reused);
+  if (!lambdas.empty()) {
+    lambdas.insert(lambdas.end(), m->decls_.begin(), m->decls_.end());
+    m->decls_ = Decl_list(lambdas, m->arena());
+  }
+
+  mods_.push_back(std::move(mod));
+  mod_ = m;
+  prints_ = std::move(fps);
+  deps_ = std::move(deps);
+  return m;
+}
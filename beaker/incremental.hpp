@@ -0,0 +1,96 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_INCREMENTAL_HPP
+#define BEAKER_INCREMENTAL_HPP
+
+// Support for incremental elaboration.
+//
+// When a module is recompiled, it is parsed anew. Each
+// top-level declaration is matched against the previous
+// compilation by its name and the fingerprint of its
+// interface. A matched declaration keeps its previously
+// elaborated node. Its definition is elaborated again only
+// when its own tokens changed, or when a declaration that
+// it depends on changed.
+//
+// Reused declarations must be exactly as elaboration left
+// them. The inliner, specializer, and other passes rewrite
+// declarations in place, so they must never run on a module
+// retained by a build state. The parse cache keeps build
+// states in the compile server, whose requests run in forked
+// processes (see parse_cache.hpp).
+
+#include <beaker/prelude.hpp>
+#include <beaker/token.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+
+class Elaborator;
+
+
+// The fingerprints of a declaration's tokens. The
+// interface fingerprint covers the tokens that determine
+// how a declaration may be used. For a function, these
+// are the tokens preceding its body. For all other
+// declarations, they are all of its tokens. The
+// definition fingerprint covers all tokens.
+//
+// Note that fingerprints hash the addresses of symbols,
+// and are only comparable within the same symbol table.
+struct Fingerprint
+{
+  std::size_t interface;
+  std::size_t definition;
+};
+
+
+Fingerprint fingerprint(Token_stream::Position, Token_stream::Position);
+
+
+// Associates top-level declarations with their fingerprints.
+using Fingerprint_map = std::unordered_map<Decl const*, Fingerprint>;
+
+
+// Associates each top-level declaration with the set of
+// top-level declarations that its elaboration used. This
+// includes functions, records, and global variables. The
+// functions synthesized for lambda expressions are also
+// recorded.
+using Dependency_set = std::unordered_set<Decl const*>;
+using Dependency_map = std::unordered_map<Decl const*, Dependency_set>;
+
+
+// The state retained between successive compilations of
+// a module.
+//
+// Reused declarations may be allocated in the arena of
+// any previous compilation, so previous modules are only
+// released with the state.
+class Build_state
+{
+public:
+  Build_state()
+    : mod_(nullptr)
+  { }
+
+  Module_decl* elaborate(std::unique_ptr<Module_decl>, Fingerprint_map const&, Elaborator&);
+
+  Module_decl* module() const { return mod_; }
+
+  // Returns the number of compilations retained.
+  std::size_t generations() const { return mods_.size(); }
+
+private:
+  std::vector<std::unique_ptr<Module_decl>> mods_;
+
+  Module_decl*    mod_;    // The current module
+  Fingerprint_map prints_; // Fingerprints of current declarations
+  Dependency_map  deps_;   // Dependencies of current declarations
+};
+
+
+#endif
@@ -0,0 +1,536 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/inliner.hpp"
+#include "beaker/type.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/stmt.hpp"
+#include "beaker/decl.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+
+int limit_ = 16;
+
+// Calls in inlined expressions are inlined to at most
+// this depth.
+constexpr int depth_limit = 8;
+
+
+// Apply fn to each operand of e.
+template<typename F>
+void
+each_operand(Expr* e, F fn)
+{
+  if (Unary_expr* u = as<Unary_expr>(e)) {
+    fn(u->first);
+  } else if (Binary_expr* b = as<Binary_expr>(e)) {
+    fn(b->first);
+    fn(b->second);
+  } else if (Call_expr* c = as<Call_expr>(e)) {
+    fn(c->first);
+    for (Expr*& a : c->second)
+      fn(a);
+  } else if (Dot_expr* d = as<Dot_expr>(e)) {
+    fn(d->first);
+  } else if (Index_expr* x = as<Index_expr>(e)) {
+    fn(x->first);
+    fn(x->second);
+  } else if (Conv* c = as<Conv>(e)) {
+    fn(c->first);
+  } else if (Copy_init* i = as<Copy_init>(e)) {
+    fn(i->first);
+  } else if (Reference_init* i = as<Reference_init>(e)) {
+    fn(i->first);
+  }
+}
+
+
+// Returns the function designated by e, or nullptr if
+// e does not designate a function.
+Function_decl*
+designated_function(Expr* e)
+{
+  if (Value_conv* c = as<Value_conv>(e))
+    e = c->source();
+  if (Decl_expr* d = as<Decl_expr>(e))
+    return as<Function_decl>(d->declaration());
+  return nullptr;
+}
+
+
+// Returns true if e is a literal or designates a function.
+inline bool
+is_constant(Expr* e)
+{
+  return is<Literal_expr>(e) || designated_function(e);
+}
+
+
+// Returns true if e designates the same object wherever
+// it is evaluated. Evaluating e has no effects.
+bool
+is_stable(Expr* e)
+{
+  if (is<Decl_expr>(e))
+    return true;
+  if (Field_expr* f = as<Field_expr>(e))
+    return is_stable(f->container());
+  if (Base_conv* c = as<Base_conv>(e))
+    return is_stable(c->source());
+  if (Index_expr* x = as<Index_expr>(e))
+    return is<Array_type>(x->array()->type()->nonref())
+        && is_stable(x->array())
+        && is<Literal_expr>(x->index());
+  return false;
+}
+
+
+bool
+has_call(Expr* e)
+{
+  if (is<Call_expr>(e))
+    return true;
+  bool r = false;
+  each_operand(e, [&r](Expr*& x) { r = r || has_call(x); });
+  return r;
+}
+
+
+// Returns the index of d in the parameters of f, or -1
+// if d is not a parameter of f.
+int
+parameter_index(Function_decl const* f, Decl const* d)
+{
+  if (!f)
+    return -1;
+  Decl_list const& ps = f->parameters();
+  auto iter = std::find(ps.begin(), ps.end(), d);
+  return iter == ps.end() ? -1 : iter - ps.begin();
+}
+
+
+// Returns the expression returned by f, if the definition
+// of f is a single return statement.
+Expr*
+returned_expr(Function_decl* f)
+{
+  Stmt* s = f->body();
+  if (Block_stmt* b = as<Block_stmt>(s)) {
+    if (b->first.size() != 1)
+      return nullptr;
+    s = b->first[0];
+  }
+  if (Return_stmt* r = as<Return_stmt>(s))
+    return r->first;
+  return nullptr;
+}
+
+
+// Describes the uses of parameters in the expression
+// returned by a function.
+struct Profile
+{
+  Profile(Function_decl* f)
+    : fn(f)
+    , uses(f->parameters().size())
+    , conditional(uses.size())
+    , called(uses.size())
+  { }
+
+  bool analyze(Expr*, bool);
+  void use(int, bool);
+
+  Function_decl*    fn;
+  int               size  = 0;
+  bool              calls = false;
+  std::vector<int>  uses;        // Number of uses
+  std::vector<bool> conditional; // Used in a conditional operand
+  std::vector<bool> called;      // Used as the target of a call
+};
+
+
+void
+Profile::use(int n, bool cond)
+{
+  ++uses[n];
+  if (cond)
+    conditional[n] = true;
+}
+
+
+// Analyze the uses of parameters in e, which is evaluated
+// conditionally if cond is true. Returns false if e cannot
+// be inlined or is too large. The address of a value
+// parameter cannot be substituted.
+bool
+Profile::analyze(Expr* e, bool cond)
+{
+  if (++size > limit_)
+    return false;
+
+  if (Decl_expr* d = as<Decl_expr>(e)) {
+    int n = parameter_index(fn, d->declaration());
+    if (n < 0)
+      return true;
+    if (!is<Reference_type>(d->declaration()->type()))
+      return false;
+    use(n, cond);
+    return true;
+  }
+
+  if (Value_conv* c = as<Value_conv>(e)) {
+    if (Decl_expr* d = as<Decl_expr>(c->source())) {
+      int n = parameter_index(fn, d->declaration());
+      if (n >= 0 && !is<Reference_type>(d->declaration()->type())) {
+        use(n, cond);
+        return true;
+      }
+    }
+    return analyze(c->source(), cond);
+  }
+
+  if (Call_expr* c = as<Call_expr>(e)) {
+    calls = true;
+    bool ok = true;
+    Decl_expr* d = as<Decl_expr>(c->target());
+    int n = d ? parameter_index(fn, d->declaration()) : -1;
+    if (n >= 0 && !is<Reference_type>(d->declaration()->type())) {
+      use(n, cond);
+      called[n] = true;
+    } else {
+      ok = analyze(c->target(), cond);
+    }
+    for (Expr* a : c->arguments())
+      ok = ok && analyze(a, cond);
+    return ok;
+  }
+
+  // The right operand of a logical operator is evaluated
+  // conditionally.
+  if (is<And_expr>(e) || is<Or_expr>(e)) {
+    Binary_expr* b = as<Binary_expr>(e);
+    return analyze(b->first, cond) && analyze(b->second, true);
+  }
+
+  if (is<Literal_expr>(e))
+    return true;
+
+  if (is<Unary_expr>(e) || is<Binary_expr>(e) || is<Field_expr>(e) ||
+      is<Index_expr>(e) || is<Conv>(e)) {
+    bool ok = true;
+    each_operand(e, [&](Expr*& x) { ok = ok && analyze(x, cond); });
+    return ok;
+  }
+
+  return false;
+}
+
+
+// Returns true if the parameters of the function described
+// by p can be replaced by the given arguments. A value
+// argument that is not constant is substituted for its only
+// use. That preserves the order of evaluation when the
+// function calls nothing else, and when at most one such
+// argument has effects.
+bool
+can_substitute(Profile const& p, Expr_list const& args)
+{
+  Decl_list const& ps = p.fn->parameters();
+  if (args.size() != ps.size())
+    return false;
+
+  int  n = 0;
+  bool effects = false;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    Expr* a = args[i];
+    if (is<Reference_type>(ps[i]->type())) {
+      if (!is_stable(a))
+        return false;
+      continue;
+    }
+    if (p.called[i] && !designated_function(a))
+      return false;
+    if (is_constant(a))
+      continue;
+    if (p.calls || p.uses[i] != 1 || p.conditional[i])
+      return false;
+    ++n;
+    effects = effects || has_call(a);
+  }
+  return !effects || n == 1;
+}
+
+
+// Copies an expression, replacing the parameters of a
+// function by its arguments. An argument that replaces
+// more than one use is copied for each additional use.
+struct Substitution
+{
+  Substitution(Function_decl* f, Expr_list const& a)
+    : fn(f), args(a), used(a.size())
+  { }
+
+  Expr* clone(Expr*);
+  Expr* argument(int);
+
+  Function_decl*    fn;
+  Expr_list         args;
+  std::vector<bool> used;
+};
+
+
+struct Clone_fn
+{
+  Substitution& sub;
+
+  template<typename T>
+  Expr* operator()(T* e) { return copy(e); }
+
+  template<typename T>
+  T* copy(T* e)
+  {
+    T* c = make<T>(*e);
+    c->shared_ = false;
+    each_operand(c, [this](Expr*& x) { x = sub.clone(x); });
+    return c;
+  }
+
+  Expr* operator()(Decl_expr* e)
+  {
+    int n = parameter_index(sub.fn, e->declaration());
+    return n < 0 ? copy(e) : sub.argument(n);
+  }
+
+  Expr* operator()(Value_conv* e)
+  {
+    if (Decl_expr* d = as<Decl_expr>(e->source())) {
+      int n = parameter_index(sub.fn, d->declaration());
+      if (n >= 0 && !is<Reference_type>(d->declaration()->type()))
+        return sub.argument(n);
+    }
+    return copy(e);
+  }
+
+  // The arguments are copied into a new list. A call to a
+  // function that was passed as an argument becomes a
+  // direct call.
+  Expr* operator()(Call_expr* e)
+  {
+    Expr* f = sub.clone(e->target());
+    if (Function_decl* d = designated_function(f))
+      f = make<Decl_expr>(d->type(), d);
+    Expr_seq args;
+    for (Expr* a : e->arguments())
+      args.push_back(sub.clone(a));
+    return make<Call_expr>(e->type(), f, args);
+  }
+};
+
+
+Expr*
+Substitution::clone(Expr* e)
+{
+  return dispatch(e, Clone_fn{*this});
+}
+
+
+Expr*
+Substitution::argument(int n)
+{
+  if (!used[n]) {
+    used[n] = true;
+    return args[n];
+  }
+  Substitution sub(nullptr, {});
+  return sub.clone(args[n]);
+}
+
+
+// The inliner replaces calls in each definition. The
+// functions being inlined are not inlined again, which
+// prevents the expansion of recursive calls.
+struct Inliner
+{
+  void  expr(Expr*&, int);
+  Expr* call(Call_expr*, int);
+  void  stmt(Stmt*);
+  void  decl(Decl*);
+
+  std::vector<Function_decl*> active;
+};
+
+
+// Inline calls in e, innermost first.
+void
+Inliner::expr(Expr*& e, int depth)
+{
+  if (!e)
+    return;
+  each_operand(e, [this, depth](Expr*& x) { expr(x, depth); });
+  if (Call_expr* c = as<Call_expr>(e))
+    e = call(c, depth);
+}
+
+
+// Returns the inlined expression of the call e, or e if
+// the call is not inlined.
+Expr*
+Inliner::call(Call_expr* e, int depth)
+{
+  if (depth >= depth_limit)
+    return e;
+
+  Decl_expr* d = as<Decl_expr>(e->target());
+  Function_decl* f = d ? as<Function_decl>(d->declaration()) : nullptr;
+  if (!f || !f->body() || f->is_polymorphic() || f->virtual_parameters())
+    return e;
+  if (std::find(active.begin(), active.end(), f) != active.end())
+    return e;
+
+  Expr* r = returned_expr(f);
+  if (!r)
+    return e;
+  Profile p(f);
+  if (!p.analyze(r, false) || !can_substitute(p, e->arguments()))
+    return e;
+
+  Substitution sub(f, e->arguments());
+  Expr* x = sub.clone(r);
+  active.push_back(f);
+  expr(x, depth + 1);
+  active.pop_back();
+  return x;
+}
+
+
+void
+Inliner::stmt(Stmt* s)
+{
+  struct Fn
+  {
+    Inliner& in;
+
+    void operator()(Empty_stmt* s) { }
+
+    void operator()(Block_stmt* s)
+    {
+      for (Stmt* s1 : s->first)
+        in.stmt(s1);
+    }
+
+    void operator()(Assign_stmt* s)
+    {
+      in.expr(s->first, 0);
+      in.expr(s->second, 0);
+    }
+
+    void operator()(Return_stmt* s)
+    {
+      in.expr(s->first, 0);
+    }
+
+    void operator()(If_then_stmt* s)
+    {
+      in.expr(s->first, 0);
+      in.stmt(s->second);
+    }
+
+    void operator()(If_else_stmt* s)
+    {
+      in.expr(s->first, 0);
+      in.stmt(s->second);
+      in.stmt(s->third);
+    }
+
+    void operator()(While_stmt* s)
+    {
+      in.expr(s->first, 0);
+      in.stmt(s->second);
+    }
+
+    void operator()(Break_stmt* s)    { }
+    void operator()(Continue_stmt* s) { }
+
+    void operator()(Expression_stmt* s)
+    {
+      in.expr(s->first, 0);
+    }
+
+    void operator()(Declaration_stmt* s)
+    {
+      in.decl(s->first);
+    }
+  };
+
+  dispatch(s, Fn{*this});
+}
+
+
+void
+Inliner::decl(Decl* d)
+{
+  struct Fn
+  {
+    Inliner& in;
+
+    void operator()(Variable_decl* d)
+    {
+      in.expr(d->init_, 0);
+    }
+
+    void operator()(Function_decl* d)
+    {
+      if (d->body()) {
+        in.active.push_back(d);
+        in.stmt(d->body());
+        in.active.pop_back();
+      }
+    }
+
+    void operator()(Parameter_decl* d) { }
+    void operator()(Field_decl* d)     { }
+
+    void operator()(Record_decl* d)
+    {
+      for (Decl* m : d->members())
+        in.decl(m);
+    }
+
+    void operator()(Module_decl* d)
+    {
+      for (Decl* d1 : d->declarations())
+        in.decl(d1);
+    }
+  };
+
+  dispatch(d, Fn{*this});
+}
+
+} // namespace
+
+
+// Inline small functions called in d. New nodes are
+// allocated in the current arena.
+void
+inline_calls(Decl* d)
+{
+  if (limit_ <= 0)
+    return;
+  Inliner in;
+  in.decl(d);
+}
+
+
+// Set the maximum cost of an inlined call. A limit of 0
+// disables inlining.
+void
+inline_limit(int n)
+{
+  limit_ = n;
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_INLINER_HPP
+#define BEAKER_INLINER_HPP
+
+// Inlining of small functions.
+//
+// A call to a function whose definition is a single
+// return statement is replaced by a copy of the returned
+// expression, in which each parameter is replaced by its
+// argument. Calls in the copy are inlined in turn. When a
+// lambda (or any function) is passed to a function that
+// calls it, the call becomes direct and the lambda can be
+// inlined as well.
+//
+// A call is inlined only when that does not change the
+// meaning of the program:
+//
+//    - a reference parameter is replaced by its argument
+//      only if that designates the same object wherever
+//      it is evaluated;
+//    - a value parameter is replaced by an argument that
+//      is a literal or a function any number of times;
+//      other arguments are evaluated exactly once and in
+//      the same order relative to any calls.
+//
+// The cost of a call is the size of the returned
+// expression. Calls whose cost exceeds a limit are not
+// inlined. Virtual calls are never inlined.
+
+#include <beaker/prelude.hpp>
+
+
+void inline_calls(Decl*);
+void inline_limit(int);
+
+
+#endif
@@ -0,0 +1,650 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/interface.hpp"
+#include "beaker/symbol.hpp"
+#include "beaker/token.hpp"
+#include "beaker/type.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/decl.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+char const          magic[4] = {'B', 'M', 'I', '\0'};
+std::uint32_t const version  = 1;
+std::uint32_t const no_index = -1;
+
+
+// Kinds of exported declarations.
+enum Entry : std::uint32_t
+{
+  function_entry,
+  variable_entry,
+};
+
+
+[[noreturn]] void
+invalid(Path const& p)
+{
+  throw std::runtime_error(format("invalid module interface '{}'", p.string()));
+}
+
+
+// -------------------------------------------------------------------------- //
+// Writing interfaces
+
+// A section of an interface file.
+struct Section : String
+{
+  void put(std::uint32_t n)
+  {
+    append(reinterpret_cast<char const*>(&n), sizeof(n));
+  }
+};
+
+
+struct Writer
+{
+  std::uint32_t string(Symbol const*);
+  std::uint32_t type(Type const*);
+  std::uint32_t record(Record_decl const*);
+
+  void parameters(Section&, Function_decl const*);
+  void body(Record_decl const*);
+  void decl(Decl const*);
+
+  void write(Path const&);
+
+  std::unordered_map<Symbol const*, std::uint32_t>      string_ids;
+  std::unordered_map<Type const*, std::uint32_t>        type_ids;
+  std::unordered_map<Record_decl const*, std::uint32_t> record_ids;
+  std::vector<Record_decl const*>                       records;
+
+  Section strings;
+  Section names;
+  Section types;
+  Section bodies;
+  Section decls;
+  std::uint32_t ntypes = 0;
+  std::uint32_t ndecls = 0;
+};
+
+
+// Strings are stored as their length followed by
+// their characters. The null symbol has no index.
+std::uint32_t
+Writer::string(Symbol const* s)
+{
+  if (!s)
+    return no_index;
+  auto ins = string_ids.emplace(s, string_ids.size());
+  if (ins.second) {
+    String const& str = s->spelling();
+    strings.put(str.size());
+    strings.append(str);
+  }
+  return ins.first->second;
+}
+
+
+// Types are stored after their components.
+std::uint32_t
+Writer::type(Type const* t)
+{
+  auto iter = type_ids.find(t);
+  if (iter != type_ids.end())
+    return iter->second;
+
+  struct Fn
+  {
+    Writer& w;
+
+    void operator()(Id_type const* t)
+    {
+      throw std::runtime_error("cannot export an unresolved type");
+    }
+
+    void operator()(Boolean_type const* t)   { w.types.put(t->kind()); }
+    void operator()(Character_type const* t) { w.types.put(t->kind()); }
+    void operator()(Float_type const* t)     { w.types.put(t->kind()); }
+    void operator()(Double_type const* t)    { w.types.put(t->kind()); }
+
+    void operator()(Integer_type const* t)
+    {
+      w.types.put(t->kind());
+      w.types.put(t->is_signed());
+      w.types.put(t->precision());
+    }
+
+    void operator()(Function_type const* t)
+    {
+      std::vector<std::uint32_t> ps;
+      for (Type const* p : t->parameter_types())
+        ps.push_back(w.type(p));
+      std::uint32_t r = w.type(t->return_type());
+      w.types.put(t->kind());
+      w.types.put(ps.size());
+      for (std::uint32_t p : ps)
+        w.types.put(p);
+      w.types.put(r);
+    }
+
+    void operator()(Array_type const* t)
+    {
+      std::uint32_t e = w.type(t->type());
+      w.types.put(t->kind());
+      w.types.put(e);
+      w.types.put(t->size());
+    }
+
+    void operator()(Block_type const* t)
+    {
+      std::uint32_t e = w.type(t->type());
+      w.types.put(t->kind());
+      w.types.put(e);
+    }
+
+    void operator()(Reference_type const* t)
+    {
+      std::uint32_t e = w.type(t->type());
+      w.types.put(t->kind());
+      w.types.put(e);
+    }
+
+    void operator()(Record_type const* t)
+    {
+      std::uint32_t r = w.record(t->declaration());
+      w.types.put(t->kind());
+      w.types.put(r);
+    }
+  };
+  dispatch(t, Fn{*this});
+
+  std::uint32_t n = ntypes++;
+  type_ids.emplace(t, n);
+  return n;
+}
+
+
+// Records are named when first referenced. Their
+// bodies are written after all exported declarations.
+std::uint32_t
+Writer::record(Record_decl const* r)
+{
+  auto ins = record_ids.emplace(r, records.size());
+  if (ins.second) {
+    records.push_back(r);
+    names.put(string(r->name()));
+  }
+  return ins.first->second;
+}
+
+
+void
+Writer::parameters(Section& out, Function_decl const* f)
+{
+  out.put(f->parameters().size());
+  for (Decl const* p : f->parameters()) {
+    out.put(string(p->name()));
+    out.put(type(p->type()));
+  }
+}
+
+
+// Write the definition of a record. Each vtable entry
+// is a method of this record or of one of its bases.
+void
+Writer::body(Record_decl const* r)
+{
+  bodies.put(r->specifiers());
+  bodies.put(r->base() ? type(r->base()) : no_index);
+
+  bodies.put(r->fields().size());
+  for (Decl const* f : r->fields()) {
+    bodies.put(f->specifiers());
+    bodies.put(string(f->name()));
+    bodies.put(type(f->type()));
+  }
+
+  bodies.put(r->members().size());
+  for (Decl const* d : r->members()) {
+    Method_decl const* m = as<Method_decl>(d);
+    if (!m)
+      throw std::runtime_error("cannot export a non-method member");
+    bodies.put(m->specifiers());
+    bodies.put(string(m->name()));
+    bodies.put(type(m->type()));
+    parameters(bodies, m);
+    bodies.put(m->vtable_entry());
+  }
+
+  bodies.put(r->vref() != nullptr);
+  if (Decl_seq const* vtbl = r->vtable()) {
+    bodies.put(vtbl->size());
+    for (Decl const* d : *vtbl) {
+      Method_decl const* m = cast<Method_decl>(d);
+      Record_decl const* owner = m->context();
+      Decl_list const& ms = owner->members();
+      bodies.put(record(owner));
+      bodies.put(std::find(ms.begin(), ms.end(), d) - ms.begin());
+    }
+  } else {
+    bodies.put(no_index);
+  }
+}
+
+
+void
+Writer::decl(Decl const* d)
+{
+  if (d->is_imported())
+    return;
+  if (d->name() && d->name()->spelling() == "main")
+    return;
+
+  if (Function_decl const* f = as<Function_decl>(d)) {
+    decls.put(function_entry);
+    decls.put(f->specifiers());
+    decls.put(string(f->name()));
+    decls.put(type(f->type()));
+    parameters(decls, f);
+    ++ndecls;
+  } else if (Variable_decl const* v = as<Variable_decl>(d)) {
+    decls.put(variable_entry);
+    decls.put(v->specifiers());
+    decls.put(string(v->name()));
+    decls.put(type(v->type()));
+    ++ndecls;
+  } else if (Record_decl const* r = as<Record_decl>(d)) {
+    record(r);
+  }
+}
+
+
+void
+Writer::write(Path const& p)
+{
+  Section head;
+  head.append(magic, sizeof(magic));
+  head.put(version);
+  head.put(string_ids.size());
+  head.put(records.size());
+  head.put(ntypes);
+  head.put(ndecls);
+
+  std::ofstream ofs(p.string(), std::ios::binary);
+  ofs << head << strings << names << types << bodies << decls;
+  if (!ofs)
+    throw std::runtime_error(format("cannot write module interface '{}'", p.string()));
+}
+
+
+// -------------------------------------------------------------------------- //
+// Reading interfaces
+
+// A read-only mapping of a file into memory.
+struct Mapping
+{
+  Mapping(Path const& p)
+    : data(nullptr), size(0)
+  {
+    int fd = ::open(p.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error(format("cannot open module interface '{}'", p.string()));
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      size = st.st_size;
+      void* m = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m != MAP_FAILED)
+        data = static_cast<char const*>(m);
+    }
+    ::close(fd);
+    if (!data)
+      invalid(p);
+  }
+
+  ~Mapping()
+  {
+    ::munmap(const_cast<char*>(data), size);
+  }
+
+  char const* data;
+  std::size_t size;
+};
+
+
+// Reads words from a mapped interface.
+struct Cursor
+{
+  Cursor(Path const& p, Mapping const& m)
+    : path(p), first(m.data), last(m.data + m.size)
+  { }
+
+  char const* take(std::size_t n)
+  {
+    if (std::size_t(last - first) < n)
+      invalid(path);
+    char const* p = first;
+    first += n;
+    return p;
+  }
+
+  std::uint32_t get()
+  {
+    std::uint32_t n;
+    std::memcpy(&n, take(sizeof(n)), sizeof(n));
+    return n;
+  }
+
+  Path const& path;
+  char const* first;
+  char const* last;
+};
+
+
+struct Reader
+{
+  Symbol const* string(std::uint32_t);
+  Type const*   type(std::uint32_t);
+  Record_decl*  record(std::uint32_t);
+
+  Decl_seq parameters(Decl*);
+  void     read_type();
+  void     read_body(Record_decl*);
+  Decl*    read_decl();
+
+  Symbol_table&              syms;
+  Cursor&                    in;
+  std::vector<Symbol const*> strings;
+  Type_seq                   types;
+  std::vector<Record_decl*>  records;
+
+  // A vtable whose entries are resolved once all
+  // records have been read.
+  struct Vtable
+  {
+    Record_decl*  rec;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ents;
+  };
+  std::vector<Vtable> vtables;
+};
+
+
+Symbol const*
+Reader::string(std::uint32_t n)
+{
+  if (n == no_index)
+    return nullptr;
+  if (n >= strings.size())
+    invalid(in.path);
+  return strings[n];
+}
+
+
+Type const*
+Reader::type(std::uint32_t n)
+{
+  if (n >= types.size())
+    invalid(in.path);
+  return types[n];
+}
+
+
+Record_decl*
+Reader::record(std::uint32_t n)
+{
+  if (n >= records.size())
+    invalid(in.path);
+  return records[n];
+}
+
+
+void
+Reader::read_type()
+{
+  Type const* t = nullptr;
+  switch (in.get()) {
+    case boolean_type:
+      t = get_boolean_type();
+      break;
+    case character_type:
+      t = get_character_type();
+      break;
+    case float_type:
+      t = get_float_type();
+      break;
+    case double_type:
+      t = get_double_type();
+      break;
+    case integer_type: {
+      bool s = in.get();
+      int p = in.get();
+      t = get_integer_type(s, p);
+      break;
+    }
+    case function_type: {
+      Type_seq ps(in.get());
+      for (Type const*& p : ps)
+        p = type(in.get());
+      t = get_function_type(ps, type(in.get()));
+      break;
+    }
+    case array_type: {
+      Type const* e = type(in.get());
+      Expr* n = make<Literal_expr>(get_integer_type(), Value(int(in.get())));
+      t = get_array_type(e, n);
+      break;
+    }
+    case block_type:
+      t = get_block_type(type(in.get()));
+      break;
+    case reference_type:
+      t = get_reference_type(type(in.get()));
+      break;
+    case record_type:
+      t = get_record_type(record(in.get()));
+      break;
+    default:
+      invalid(in.path);
+  }
+  types.push_back(t);
+}
+
+
+Decl_seq
+Reader::parameters(Decl* f)
+{
+  Decl_seq ps(in.get());
+  for (Decl*& p : ps) {
+    Symbol const* n = string(in.get());
+    p = make<Parameter_decl>(n, type(in.get()));
+    p->cxt_ = f;
+  }
+  return ps;
+}
+
+
+// Read the body of a record into r. If r was already
+// imported, the body is read and discarded.
+void
+Reader::read_body(Record_decl* r)
+{
+  bool fresh = !r->is_imported();
+  Specifier spec = Specifier(in.get() | imported_spec);
+  std::uint32_t base = in.get();
+
+  Decl_seq fs(in.get());
+  for (Decl*& f : fs) {
+    Specifier s = Specifier(in.get());
+    Symbol const* n = string(in.get());
+    f = make<Field_decl>(s, n, type(in.get()));
+    f->cxt_ = r;
+  }
+
+  Decl_seq ms(in.get());
+  for (Decl*& d : ms) {
+    Specifier s = Specifier(in.get() | imported_spec);
+    Symbol const* n = string(in.get());
+    Type const* t = type(in.get());
+    Method_decl* m = make<Method_decl>(s, n, t, Decl_seq{}, nullptr);
+    m->parms_ = Decl_list(parameters(m));
+    m->vtent_ = in.get();
+    m->cxt_ = r;
+    d = m;
+  }
+
+  bool vref = in.get();
+  Vtable vtbl {r, {}};
+  std::uint32_t k = in.get();
+  if (k != no_index) {
+    vtbl.ents.resize(k);
+    for (auto& e : vtbl.ents) {
+      e.first = in.get();
+      e.second = in.get();
+    }
+  }
+  if (!fresh)
+    return;
+
+  r->spec_ = spec;
+  if (base != no_index)
+    r->base_ = type(base);
+  r->fields_ = Decl_list(fs);
+  r->members_ = Decl_list(ms);
+  for (Decl* f : fs)
+    r->scope_[f->name()].push_back(f);
+  for (Decl* m : ms)
+    r->scope_[m->name()].push_back(m);
+  if (vref)
+    r->vref_ = make<Field_decl>(syms.get("vref"), get_reference_type(get_character_type()));
+  if (k != no_index)
+    vtables.push_back(std::move(vtbl));
+}
+
+
+Decl*
+Reader::read_decl()
+{
+  std::uint32_t kind = in.get();
+  Specifier spec = Specifier(in.get() | imported_spec);
+  Symbol const* n = string(in.get());
+  Type const* t = type(in.get());
+  switch (kind) {
+    case function_entry: {
+      Function_decl* f = make<Function_decl>(spec, n, t, Decl_seq{}, nullptr);
+      f->parms_ = Decl_list(parameters(f));
+      return f;
+    }
+    case variable_entry:
+      return make<Variable_decl>(spec, n, t, nullptr);
+    default:
+      invalid(in.path);
+  }
+}
+
+} // namespace
+
+
+void
+write_interface(Module_decl const* m, Path const& p)
+{
+  Writer w;
+  for (Decl const* d : m->declarations())
+    w.decl(d);
+  for (std::size_t i = 0; i < w.records.size(); ++i)
+    w.body(w.records[i]);
+  w.write(p);
+}
+
+
+// Read the interface at p. Every record in the interface
+// is declared by the import, followed by the exported
+// functions and variables. Records that were imported
+// previously are not declared again.
+Decl_seq
+Interface_reader::read(Path const& p)
+{
+  Mapping map(p);
+  Cursor in(p, map);
+  if (std::memcmp(in.take(sizeof(magic)), magic, sizeof(magic)) != 0)
+    invalid(p);
+  if (in.get() != version)
+    throw std::runtime_error(format("module interface '{}' has an unsupported version", p.string()));
+  std::uint32_t nstrings = in.get();
+  std::uint32_t nrecords = in.get();
+  std::uint32_t ntypes = in.get();
+  std::uint32_t ndecls = in.get();
+
+  Reader r {syms, in};
+  for (std::uint32_t i = 0; i < nstrings; ++i) {
+    std::uint32_t n = in.get();
+    char const* s = in.take(n);
+    r.strings.push_back(syms.put<Identifier_sym>(s, s + n, identifier_tok));
+  }
+
+  // Create the records that were not previously imported.
+  Decl_seq ds;
+  for (std::uint32_t i = 0; i < nrecords; ++i) {
+    Symbol const* n = r.string(in.get());
+    Record_decl*& rec = records_[n];
+    if (!rec) {
+      rec = make<Record_decl>(n, Decl_seq{}, Decl_seq{}, nullptr);
+      ds.push_back(rec);
+    }
+    r.records.push_back(rec);
+  }
+
+  for (std::uint32_t i = 0; i < ntypes; ++i)
+    r.read_type();
+
+  // Read record bodies. Note that a record is marked
+  // as imported once its body has been read.
+  for (Record_decl* rec : r.records)
+    r.read_body(rec);
+  for (Reader::Vtable& v : r.vtables) {
+    v.rec->vtbl_ = make<Decl_seq>();
+    for (auto const& e : v.ents) {
+      Decl_list const& ms = r.record(e.first)->members();
+      if (e.second >= ms.size())
+        invalid(p);
+      v.rec->vtbl_->push_back(ms[e.second]);
+    }
+  }
+
+  for (std::uint32_t i = 0; i < ndecls; ++i)
+    ds.push_back(r.read_decl());
+  return ds;
+}
+
+
+Path
+find_interface(String const& n, Path_seq const& dirs)
+{
+  for (Path const& d : dirs) {
+    Path p = d / (n + ".bmi");
+    if (fs::exists(p))
+      return p;
+  }
+  return Path();
+}
+
+
+Path
+find_interface(Symbol const* n, Path_seq const& dirs)
+{
+  return find_interface(n->spelling(), dirs);
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_INTERFACE_HPP
+#define BEAKER_INTERFACE_HPP
+
+// Binary module interfaces.
+//
+// An interface describes the declarations exported by a
+// compiled module: its functions, global variables, and
+// records. Declarations are stored in their elaborated
+// form, along with the types they refer to and the
+// virtual table layout of each record. Importing a
+// module maps its interface into memory and rebuilds
+// those declarations directly; the module's source is
+// never parsed.
+//
+// An interface file has the following sections, in
+// order. All integers are 32 bits, in native byte order.
+//
+//    header  -- magic number, version, section counts
+//    strings -- the names of declarations
+//    records -- the name of each record
+//    types   -- each type after its components
+//    bodies  -- the base, members, and vtable of each record
+//    decls   -- exported functions, variables, and records
+//
+// Records are named before types so that record types
+// can refer to them, and defined after types so that
+// their members can refer to types.
+//
+// Interfaces are not portable between hosts.
+
+#include <beaker/prelude.hpp>
+#include <beaker/file.hpp>
+
+#include <unordered_map>
+
+
+// Write the interface of the module m to the file p.
+// Imported declarations and main are not exported.
+void write_interface(Module_decl const*, Path const&);
+
+
+// Reads module interfaces. A record may appear in the
+// interface of each module that uses it. Records are
+// identified by name, so that importing several of
+// those modules declares each record once.
+//
+// Declarations are allocated in the current arena. They
+// are marked as imported.
+class Interface_reader
+{
+public:
+  Interface_reader(Symbol_table& s)
+    : syms(s)
+  { }
+
+  Decl_seq read(Path const&);
+
+private:
+  Symbol_table& syms;
+  std::unordered_map<Symbol const*, Record_decl*> records_;
+};
+
+
+// Find the interface of the module named n in one
+// of the given directories. Returns an empty path if
+// there is no such interface.
+Path find_interface(String const&, Path_seq const&);
+Path find_interface(Symbol const*, Path_seq const&);
+
+
+#endif
@@ -0,0 +1,17 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/file.hpp"
+#include "beaker/error.hpp"
+
+
+extern int interpreter_main(int, char*[]);
+
+
+int
+main(int argc, char* argv[])
+{
+  return interpreter_main(argc, argv);
+}
@@ -7,8 +7,14 @@
 #include "beaker/parser.hpp"
 #include "beaker/decl.hpp"
 #include "beaker/elaborator.hpp"
+#include "beaker/inliner.hpp"
+#include "beaker/specializer.hpp"
+#include "beaker/cse.hpp"
+#include "beaker/effects.hpp"
+#include "beaker/ssa.hpp"
 #include "beaker/evaluator.hpp"
 #include "beaker/generator.hpp"
+#include "beaker/parse_cache.hpp"
 #include "beaker/error.hpp"
 
 #include <iostream>
@@ -21,44 +27,88 @@
 using namespace std;
 
 
-int
-main(int argc, char* argv[])
+namespace
 {
-  init_colors();
-
-  // Prepare the symbol table.
-  Symbol_table syms;
-  init_symbols(syms);
 
-  Module_decl mod;
+// Parse the input file into the module.
+bool
+parse(Symbol_table& syms, Path const& in, Module_decl& mod, Location_map& locs)
+{
+  // Reuse the resident server's parse of the file,
+  // and its locations, if it has one.
+  if (Parse_cache* cache = parse_cache()) {
+    if (Module_decl* m = cache->get(in, locs)) {
+      mod.decls_ = Decl_list(Decl_seq(m->decls_.begin(), m->decls_.end()), mod.arena());
+      mod.imports_ = m->imports_;
+      return true;
+    }
+  }
 
   // Prepare the input buffer.
-  File src = argv[1];
-  Input_buffer in = src;
+  File src = in.c_str();
+  Input_buffer buf = src;
+
+  // Create the token stream over. This will be populated
+  // by the lexer.
+  Token_stream ts;
+
+  // Build and run the lexer.
+  Lexer lex(syms, buf);
+  if (!lex.lex(ts))
+    return false;
+
+  // Build and run the parser. The location map
+  // is used to save source locations, which are
+  // used to diagnose elaboration errors.
+  Parser parse(syms, ts, locs);
+  return parse.module(&mod);
+}
 
-  try {
-    // Create the token stream over. This will be populated
-    // by the lexer.
-    Token_stream ts;
+} // namespace
 
-    // Build and run the lexer.
-    Lexer lex(syms, in);
-    if (!lex.lex(ts))
-      return -1;
 
-    // Build and run the parser. The location map
-    // is used to save source locations, which are
-    // used to diagnose elaboration errors.
+int
+interpreter_main(int argc, char* argv[])
+{
+  // In a resident server, the global resources have been
+  // initialized, and files are parsed with the symbol
+  // table of the server's parse cache.
+  Symbol_table local;
+  Parse_cache* cache = parse_cache();
+  if (!cache) {
+    init_colors();
+    init_symbols(local);
+  }
+  Symbol_table& syms = cache ? cache->symbols() : local;
+
+  // All nodes are allocated in the module's arena.
+  Module_decl mod;
+  Arena_sentinel alloc(mod.arena());
+
+  if (argc < 2) {
+    std::cerr << "usage: beaker-interpret input-file\n";
+    return -1;
+  }
+
+  try {
     Location_map locs;
-    Parser parse(syms, ts, locs);
-    if (!parse.module(&mod))
+    if (!parse(syms, argv[1], mod, locs))
       return -1;
+    if (!mod.imports().empty()) {
+      std::cerr << "error: imports are not supported by the interpreter\n";
+      return -1;
+    }
 
     // Perform semantic analysis.
     //
     // TODO: Implement a parse-only phase.
     Elaborator elab(locs, syms);
     elab.elaborate(&mod);
+    inline_calls(&mod);
+    specialize_calls(&mod, syms);
+    eliminate_common_subexpressions(&mod);
+    analyze_effects(&mod);
+    lower_module(&mod);
 
     // Find an entry point for evaluation.
     //
@@ -87,4 +137,5 @@ main(int argc, char* argv[])
   }
 
   // FIXME: Do something with the module.
+  return 0;
 }
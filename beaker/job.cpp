@@ -5,31 +5,201 @@
 
 #include "beaker/job.hpp"
 
-#include <cstdlib>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <system_error>
+#include <thread>
+
+
+extern char** environ;
+
 
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+
+// A job that has been started.
+struct Process
+{
+  std::size_t       job;
+  pid_t             pid;
+  int               fd;    // The file holding its output
+  Clock::time_point start;
+};
 
-// Execute the job. If the program cannot be executed,
-// an exception is thrown.
+
+// Start the job, with its output redirected to an unnamed
+// temporary file in TMPDIR. Returns false if the job cannot
+// be started.
+//
+// The file is closed on exec, so that only the job's own
+// output streams refer to it. Otherwise, concurrent jobs
+// would inherit each other's files.
 bool
-Job::run()
+spawn(Job& j, std::size_t n, Process& p)
 {
-  // Build the command string.
-  std::stringstream ss;
-  ss << exec.string() << ' ';
-  for (String const& arg : args)
-    ss << arg << ' ';
-
-  // Actually run the command.
-  //
-  // FIXME: If the error is produced as a result of the
-  // system() call, then diagnose that here. Otherwise,
-  // if the program returned non-zero, then assume that
-  // it's errors have been diagnosed.
-  int err = system(ss.str().c_str());
-  if (err)
+  char const* dir = std::getenv("TMPDIR");
+  String tmpl = String(dir && *dir ? dir : "/tmp") + "/beaker-job-XXXXXX";
+  std::vector<char> name(tmpl.begin(), tmpl.end());
+  name.push_back(0);
+  int fd = ::mkostemp(name.data(), O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << format("error: cannot capture the output of '{}': {}\n",
+                        j.exec.string(), std::strerror(errno));
+    return false;
+  }
+  ::unlink(name.data());
+
+  String exec = j.exec.string();
+  std::vector<char*> argv;
+  argv.push_back(const_cast<char*>(exec.c_str()));
+  for (String const& a : j.args)
+    argv.push_back(const_cast<char*>(a.c_str()));
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t acts;
+  posix_spawn_file_actions_init(&acts);
+  posix_spawn_file_actions_adddup2(&acts, fd, 1);
+  posix_spawn_file_actions_adddup2(&acts, fd, 2);
+  p.start = Clock::now();
+  int err = ::posix_spawnp(&p.pid, exec.c_str(), &acts, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&acts);
+  if (err) {
+    ::close(fd);
+    std::cerr << format("error: cannot execute '{}': {}\n", exec, std::strerror(err));
     return false;
+  }
+  p.job = n;
+  p.fd = fd;
   return true;
 }
+
+
+// Record the results of a job whose process has exited
+// with the given wait status, and forward its output.
+void
+finish(Job& j, Process const& p, int st)
+{
+  j.time = std::chrono::duration<double>(Clock::now() - p.start).count();
+  if (WIFEXITED(st))
+    j.status = WEXITSTATUS(st);
+  else
+    j.status = 128 + WTERMSIG(st);
+
+  char buf[4096];
+  ::lseek(p.fd, 0, SEEK_SET);
+  while (true) {
+    ssize_t k = ::read(p.fd, buf, sizeof(buf));
+    if (k <= 0)
+      break;
+    j.output.append(buf, k);
+  }
+  ::close(p.fd);
+  std::cerr << j.output;
+}
+
+
+// Wait for one of the processes to exit, and return it.
+// Only the given processes are reaped; other children of
+// the process are left to whoever started them. There is
+// no portable way to wait for any of a set of processes,
+// so they are polled unless there is only one.
+std::vector<Process>::iterator
+wait_any(std::vector<Process>& procs, int& st)
+{
+  while (true) {
+    int opts = procs.size() == 1 ? 0 : WNOHANG;
+    for (auto iter = procs.begin(); iter != procs.end(); ++iter) {
+      pid_t pid = ::waitpid(iter->pid, &st, opts);
+      if (pid == iter->pid)
+        return iter;
+      if (pid < 0 && errno != EINTR)
+        throw std::system_error(errno, std::system_category(), "waitpid");
+    }
+    if (opts == WNOHANG)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+} // namespace
+
+
+// Execute the job and wait for it to finish. Returns
+// false if the job cannot be executed or fails. If the
+// program returned non-zero, we assume that its errors
+// have been diagnosed.
+bool
+Job::run()
+{
+  Job_seq jobs {*this};
+  bool ok = ::run(jobs, 1);
+  *this = jobs.front();
+  return ok;
+}
+
+
+// Run the jobs, starting each as soon as its dependencies
+// have succeeded, with at most n running at once. A job
+// whose dependencies fail is not run. Returns true if all
+// of the jobs succeed.
+bool
+run(Job_seq& jobs, int n)
+{
+  enum State { waiting, running, done, failed };
+  std::vector<State> state(jobs.size(), waiting);
+  std::vector<Process> procs;
+  bool ok = true;
+  while (true) {
+    // Start the jobs that are ready. Dependencies precede
+    // their dependents, so failures propagate in one pass.
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+      if (state[i] != waiting)
+        continue;
+      bool ready = true;
+      for (std::size_t d : jobs[i].deps) {
+        if (state[d] == failed) {
+          state[i] = failed;
+          ok = false;
+        }
+        if (state[d] != done)
+          ready = false;
+      }
+      if (!ready || (int)procs.size() >= n)
+        continue;
+      Process p;
+      if (spawn(jobs[i], i, p)) {
+        procs.push_back(p);
+        state[i] = running;
+      } else {
+        state[i] = failed;
+        ok = false;
+      }
+    }
+    if (procs.empty())
+      break;
+
+    // Wait for any of them to finish.
+    int st;
+    auto iter = wait_any(procs, st);
+    Job& j = jobs[iter->job];
+    finish(j, *iter, st);
+    if (j.status == 0) {
+      state[iter->job] = done;
+    } else {
+      state[iter->job] = failed;
+      ok = false;
+    }
+    procs.erase(iter);
+  }
+  return ok;
+}
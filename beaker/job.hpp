@@ -15,6 +15,11 @@ using String_seq =  std::vector<std::string>;
 // A job is a program that is executed to translate an
 // input file into an output file. A job corresponds
 // a subprocess executed by the compiler.
+//
+// Jobs are spawned directly, not through the shell, so
+// each argument is passed to the program as written.
+// The output of a job (both stdout and stderr) is
+// captured and written to std::cerr when it finishes.
 struct Job
 {
   Job(Path const& p, String_seq const& args)
@@ -25,12 +30,25 @@ struct Job
 
   Path       exec;
   String_seq args;
+
+  // The indexes of jobs in the same sequence that must
+  // finish before this one starts.
+  std::vector<std::size_t> deps;
+
+  // The results of running the job.
+  int    status = -1; // The exit status, or -1 if not run
+  String output;      // The captured output
+  double time = 0;    // The wall time in seconds
 };
 
 
 // The job list is the sequence of jobs needed to fully
-// execute the compilation process.
+// execute the compilation process. The dependencies of
+// a job precede it in the sequence.
 using Job_seq = std::vector<Job>;
 
 
+bool run(Job_seq&, int);
+
+
 #endif
@@ -0,0 +1,202 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/layout.hpp"
+#include "beaker/type.hpp"
+#include "beaker/decl.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+
+bool reorder_ = false;
+
+// The size and alignment of pointers on the host.
+constexpr std::size_t pointer_size = sizeof(void*);
+
+
+std::size_t
+align_to(std::size_t n, std::size_t a)
+{
+  return (n + a - 1) / a * a;
+}
+
+
+// Compute the layout of the complete record r.
+void
+compute(Record_decl const* r, Layout& l)
+{
+  l.size = 0;
+  l.align = 1;
+  l.vtable = r->vtable();
+
+  // Place an element of size n and alignment a.
+  int elems = 0;
+  auto place = [&](std::size_t n, std::size_t a) {
+    l.size = align_to(l.size, a);
+    l.align = std::max(l.align, a);
+    std::size_t off = l.size;
+    l.size += n;
+    ++elems;
+    return off;
+  };
+
+  // The vptr is the first element of the root of a
+  // polymorphic hierarchy.
+  l.vptr = r->vref();
+  if (l.vptr) {
+    place(pointer_size, pointer_size);
+    l.vref = {0};
+  }
+
+  // The base subobject, unless it is empty. Inherited
+  // fields are found through the base element.
+  l.base = -1;
+  if (Record_decl const* b = r->base_declaration()) {
+    Layout const& bl = get_layout(b);
+    l.members = bl.members;
+    if (bl.vptr || !bl.fields.empty()) {
+      int n = elems;
+      std::size_t off = place(bl.size, bl.align);
+      l.base = n;
+      for (Field_layout const& f : bl.fields) {
+        std::vector<int> p {n};
+        p.insert(p.end(), f.path.begin(), f.path.end());
+        l.fields.push_back({f.field, Field_path(p), off + f.offset});
+      }
+      if (!bl.vref.empty()) {
+        std::vector<int> p {n};
+        p.insert(p.end(), bl.vref.begin(), bl.vref.end());
+        l.vref = Field_path(p);
+      }
+    }
+  }
+
+  // The record's own fields, in storage order. Note that
+  // the sort is stable so that fields with the same
+  // alignment keep their declared order.
+  for (Decl const* f : r->fields())
+    l.order.push_back(cast<Field_decl>(f));
+  if (reorder_) {
+    std::stable_sort(l.order.begin(), l.order.end(), [](Field_decl const* a, Field_decl const* b) {
+      return get_alignment(a->type()) > get_alignment(b->type());
+    });
+  }
+  std::size_t first = l.fields.size();
+  l.fields.resize(first + l.order.size());
+  for (Field_decl const* f : l.order) {
+    int n = elems;
+    std::size_t off = place(get_size(f->type()), get_alignment(f->type()));
+    l.fields[first + f->index()] = {f, {n}, off};
+  }
+
+  // An object occupies at least one byte.
+  if (elems == 0)
+    place(1, 1);
+  l.size = align_to(l.size, l.align);
+
+  for (std::size_t i = 0; i < l.fields.size(); ++i)
+    l.indexes.emplace(l.fields[i].field, i);
+
+  // A member hides members of the same name in its
+  // bases. Note that the layout refers to the record's
+  // scope, which is not otherwise modified.
+  Scope* s = const_cast<Record_decl*>(r)->scope();
+  for (auto& bind : *s)
+    l.members[bind.first] = &bind.second;
+}
+
+} // namespace
+
+
+// Returns the flattened layout of the field f.
+Field_layout const*
+Layout::field(Decl const* f) const
+{
+  int n = index(f);
+  return n < 0 ? nullptr : &fields[n];
+}
+
+
+// Returns the index of f in the flattened fields, or
+// -1 if f is not a field of the record.
+int
+Layout::index(Decl const* f) const
+{
+  auto iter = indexes.find(f);
+  return iter == indexes.end() ? -1 : iter->second;
+}
+
+
+// Returns the members named by n, or nullptr if there
+// are none.
+Overload*
+Layout::lookup(Symbol const* n) const
+{
+  auto iter = members.find(n);
+  return iter == members.end() ? nullptr : iter->second;
+}
+
+
+// Returns the layout of the record r. The layout is
+// computed on first use, which shall follow the
+// declaration of all members of r and the definition
+// of its base.
+Layout const&
+get_layout(Record_decl const* r)
+{
+  if (!r->layout_) {
+    Layout* l = make<Layout>();
+    compute(r, *l);
+    r->layout_ = l;
+  }
+  return *r->layout_;
+}
+
+
+// Returns the size of objects of type t in bytes.
+std::size_t
+get_size(Type const* t)
+{
+  struct Fn
+  {
+    std::size_t operator()(Id_type const* t)        { lingo_unreachable(); }
+    std::size_t operator()(Boolean_type const* t)   { return 1; }
+    std::size_t operator()(Character_type const* t) { return 1; }
+    std::size_t operator()(Integer_type const* t)   { return t->precision() / 8; }
+    std::size_t operator()(Float_type const* t)     { return 4; }
+    std::size_t operator()(Double_type const* t)    { return 8; }
+    std::size_t operator()(Function_type const* t)  { return pointer_size; }
+    std::size_t operator()(Array_type const* t)     { return t->size() * get_size(t->type()); }
+    std::size_t operator()(Block_type const* t)     { return pointer_size; }
+    std::size_t operator()(Reference_type const* t) { return pointer_size; }
+    std::size_t operator()(Record_type const* t)    { return get_layout(t->declaration()).size; }
+  };
+  return dispatch(t, Fn{});
+}
+
+
+// Returns the alignment of objects of type t in bytes.
+std::size_t
+get_alignment(Type const* t)
+{
+  if (Array_type const* a = as<Array_type>(t))
+    return get_alignment(a->type());
+  if (Record_type const* r = as<Record_type>(t))
+    return get_layout(r->declaration()).align;
+  return get_size(t);
+}
+
+
+// Enable or disable field reordering. Reordering changes
+// the layout of records, so all modules of a program must
+// be compiled with the same setting.
+void
+reorder_fields(bool b)
+{
+  reorder_ = b;
+}
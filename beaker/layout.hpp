@@ -0,0 +1,80 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_LAYOUT_HPP
+#define BEAKER_LAYOUT_HPP
+
+// The layout engine determines how the objects of a
+// record type are stored. A layout is computed once per
+// record and shared by the elaborator (member lookup and
+// field paths), the generator (struct types, vptrs) and
+// the evaluator (record values).
+//
+// A record object is stored as a sequence of elements:
+// its vptr (if it is the root of a polymorphic hierarchy),
+// its base subobject, and its fields. An empty base has
+// no storage. When field reordering is enabled, fields
+// are stored in order of decreasing alignment, which
+// minimizes padding.
+//
+// The fields of a record are also flattened: inherited
+// fields precede the record's own fields, each with its
+// path of element indexes and its byte offset. The
+// flattened fields of a base are a prefix of those of
+// any derived record.
+
+#include <beaker/prelude.hpp>
+#include <beaker/expr.hpp>
+
+#include <unordered_map>
+
+
+// The location of a field within a record object.
+struct Field_layout
+{
+  Field_decl const* field;
+  Field_path        path;   // Element indexes to the field
+  std::size_t       offset; // Offset in bytes
+};
+
+
+struct Layout
+{
+  Field_layout const* field(Decl const*) const;
+  int                 index(Decl const*) const;
+  Overload*           lookup(Symbol const*) const;
+
+  std::size_t size;
+  std::size_t align;
+
+  // The stored elements.
+  bool                           vptr;  // Stores a vptr
+  int                            base;  // Element of the base, or -1
+  std::vector<Field_decl const*> order; // Fields in storage order
+
+  // The path to the vptr in this record, which may be
+  // in a base subobject. Empty if the record is not
+  // polymorphic.
+  Field_path vref;
+
+  // The virtual table slots, or nullptr if the record
+  // is not polymorphic.
+  Decl_seq const* vtable;
+
+  // Flattened fields and members. A member hides the
+  // members of its bases with the same name.
+  std::vector<Field_layout>                   fields;
+  std::unordered_map<Decl const*, int>        indexes;
+  std::unordered_map<Symbol const*, Overload*> members;
+};
+
+
+Layout const& get_layout(Record_decl const*);
+
+std::size_t get_size(Type const*);
+std::size_t get_alignment(Type const*);
+
+void reorder_fields(bool);
+
+
+#endif
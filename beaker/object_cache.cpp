@@ -0,0 +1,395 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/object_cache.hpp"
+#include "beaker/interface.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+
+namespace
+{
+
+// The SHA-1 hash of a sequence of strings (FIPS 180-4).
+// This does not depend on LLVM, whose SHA-1 is not in every
+// version that we support.
+class Sha1
+{
+public:
+  Sha1()
+    : h_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0}, n_(0)
+  { }
+
+  void update(String const&);
+
+  String digest();
+
+private:
+  void block();
+
+  std::uint32_t h_[5];
+  std::uint8_t  buf_[64];
+  std::uint64_t n_;  // Bytes hashed
+};
+
+
+inline std::uint32_t
+rotate(std::uint32_t x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+
+void
+Sha1::update(String const& s)
+{
+  for (char c : s) {
+    buf_[n_++ % 64] = c;
+    if (n_ % 64 == 0)
+      block();
+  }
+}
+
+
+// Pad the message, and return the digest in hexadecimal.
+// The hash cannot be updated after this.
+String
+Sha1::digest()
+{
+  std::uint64_t bits = n_ * 8;
+  update(String(1, '\x80'));
+  while (n_ % 64 != 56)
+    update(String(1, '\0'));
+  for (int i = 7; i >= 0; --i)
+    update(String(1, char(bits >> (i * 8))));
+
+  static char const* digits = "0123456789abcdef";
+  String r;
+  for (std::uint32_t h : h_) {
+    for (int i = 28; i >= 0; i -= 4)
+      r += digits[(h >> i) & 0xf];
+  }
+  return r;
+}
+
+
+// Hash the buffered block.
+void
+Sha1::block()
+{
+  std::uint32_t w[80];
+  for (int i = 0; i < 16; ++i)
+    w[i] = std::uint32_t(buf_[i * 4]) << 24
+         | std::uint32_t(buf_[i * 4 + 1]) << 16
+         | std::uint32_t(buf_[i * 4 + 2]) << 8
+         | std::uint32_t(buf_[i * 4 + 3]);
+  for (int i = 16; i < 80; ++i)
+    w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+  std::uint32_t a = h_[0], b = h_[1], c = h_[2], d = h_[3], e = h_[4];
+  for (int i = 0; i < 80; ++i) {
+    std::uint32_t f, k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5a827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8f1bbcdc;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6;
+    }
+    std::uint32_t t = rotate(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotate(b, 30);
+    b = a;
+    a = t;
+  }
+  h_[0] += a;
+  h_[1] += b;
+  h_[2] += c;
+  h_[3] += d;
+  h_[4] += e;
+}
+
+
+// Add the contents of the file to the hash. A missing
+// file contributes only its name.
+void
+hash_file(Sha1& sha, Path const& p)
+{
+  sha.update(p.filename().string());
+  std::ifstream f(p.string(), std::ios::binary);
+  String s((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  sha.update(format("{}:", s.size()));
+  sha.update(s);
+}
+
+
+// Copy the file through a temporary in the destination's
+// directory, and rename it into place.
+void
+copy_atomic(Path const& from, Path const& to)
+{
+  Path tmp = to;
+  tmp += format(".tmp{}", ::getpid());
+  fs::copy_file(from, tmp, fs::copy_option::overwrite_if_exists);
+  fs::rename(tmp, to);
+}
+
+
+// The manifest for a key lists the modules imported by
+// the sources, one per line.
+inline Path
+manifest(Path const& dir, String const& key)
+{
+  return dir / (key + ".imports");
+}
+
+
+bool
+read_manifest(Path const& p, std::vector<String>& names)
+{
+  std::ifstream f(p.string());
+  if (!f)
+    return false;
+  String line;
+  while (std::getline(f, line))
+    names.push_back(line);
+  return true;
+}
+
+
+void
+write_manifest(Path const& p, std::vector<String> const& names)
+{
+  Path tmp = p;
+  tmp += format(".tmp{}", ::getpid());
+  {
+    std::ofstream f(tmp.string());
+    for (String const& n : names)
+      f << n << '\n';
+  }
+  fs::rename(tmp, p);
+}
+
+
+// Returns the key of the manifest for an entry, given
+// the path of its object.
+inline String
+manifest_key(Path const& obj)
+{
+  String s = obj.stem().string();
+  return s.substr(0, s.find('-'));
+}
+
+
+inline Path
+entry_object(Path const& dir, String const& key)
+{
+  return dir / (key + object_extension());
+}
+
+
+inline Path
+entry_interface(Path const& dir, String const& key)
+{
+  return dir / (key + ".bmi");
+}
+
+} // namespace
+
+
+// Open the cache in the given directory, creating it if
+// needed. The limit is the size of the cache in bytes.
+Object_cache::Object_cache(Path const& p, std::uintmax_t n)
+  : dir_(p), limit_(n)
+{
+  fs::create_directories(dir_);
+}
+
+
+// Compute the key for translating the sources with the
+// given options. This addresses the manifest of the
+// sources' imports; see entry().
+String
+Object_cache::key(Path_seq const& srcs, String const& opts) const
+{
+  Sha1 sha;
+  sha.update(PACKAGE_STRING);
+  sha.update(opts);
+  for (Path const& p : srcs)
+    hash_file(sha, p);
+  return sha.digest();
+}
+
+
+// Compute the key of the entry for the given key, whose
+// sources import the modules named by names. Each module's
+// interface is found in the directories dirs. The interface
+// iface, written by the translation itself, is skipped.
+String
+Object_cache::entry(String const& key, std::vector<String> const& names, Path_seq const& dirs, Path const& iface) const
+{
+  Sha1 sha;
+  sha.update(key);
+  for (String const& n : names) {
+    sha.update(n + ':');
+    Path p = find_interface(n, dirs);
+    if (p.empty())
+      continue;
+    if (!iface.empty() && fs::exists(iface) && fs::equivalent(p, iface))
+      continue;
+    hash_file(sha, p);
+  }
+  return key + '-' + sha.digest();
+}
+
+
+// Copy the cached object for the key to obj, and its
+// interface, if any, to iface. The interface is ignored
+// if iface is empty. Imported interfaces are found in the
+// directories dirs. Returns false on a miss. A hit makes
+// the entry the most recently used.
+bool
+Object_cache::get(String const& key, Path_seq const& dirs, Path const& obj, Path const& iface)
+{
+  std::vector<String> names;
+  if (!read_manifest(manifest(dir_, key), names)) {
+    record("miss");
+    return false;
+  }
+  String k = entry(key, names, dirs, iface);
+  Path o = entry_object(dir_, k);
+  Path i = entry_interface(dir_, k);
+  boost::system::error_code ec;
+  fs::last_write_time(o, std::time(nullptr), ec);
+  if (ec) {
+    record("miss");
+    return false;
+  }
+  if (!iface.empty() && fs::exists(i))
+    copy_atomic(i, iface);
+  copy_atomic(o, obj);
+  record("hit");
+  return true;
+}
+
+
+// Store the object and its interface, if iface is not
+// empty and exists, for the key. The sources import the
+// modules named by names, whose interfaces are found in
+// the directories dirs. The object is renamed into place
+// last, since its presence marks the entry as complete.
+void
+Object_cache::put(String const& key, std::vector<String> const& names, Path_seq const& dirs, Path const& obj, Path const& iface)
+{
+  String k = entry(key, names, dirs, iface);
+  write_manifest(manifest(dir_, key), names);
+  if (!iface.empty() && fs::exists(iface))
+    copy_atomic(iface, entry_interface(dir_, k));
+  copy_atomic(obj, entry_object(dir_, k));
+  evict();
+}
+
+
+// Each lookup appends a line to the statistics file.
+// Small appends are atomic, so concurrent builds do not
+// lose counts.
+void
+Object_cache::record(char const* what)
+{
+  String line = format("{}\n", what);
+  int fd = ::open((dir_ / "stats").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    return;
+  ssize_t n = ::write(fd, line.data(), line.size());
+  (void)n;
+  ::close(fd);
+}
+
+
+// Remove the least recently used entries until the cache
+// is within its limit. An entry may be removed by another
+// build while we look at it, so errors are ignored. The
+// manifest of a removed entry is removed with it; other
+// entries for the same sources are then found only after
+// they are rebuilt.
+void
+Object_cache::evict()
+{
+  struct Entry
+  {
+    std::time_t    time;
+    std::uintmax_t size;
+    Path           path;
+  };
+  std::vector<Entry> entries;
+  std::uintmax_t total = 0;
+  boost::system::error_code ec;
+  for (fs::directory_iterator i(dir_), e; i != e; ++i) {
+    Path const& p = i->path();
+    if (get_file_kind(p) != object_file)
+      continue;
+    Path iface = Path(p).replace_extension(".bmi");
+    std::uintmax_t size = fs::file_size(p, ec);
+    if (fs::exists(iface))
+      size += fs::file_size(iface, ec);
+    entries.push_back({fs::last_write_time(p, ec), size, p});
+    total += size;
+  }
+  if (total <= limit_)
+    return;
+
+  std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) {
+    return a.time < b.time;
+  });
+  for (Entry const& e : entries) {
+    if (total <= limit_)
+      break;
+    fs::remove(e.path, ec);
+    fs::remove(Path(e.path).replace_extension(".bmi"), ec);
+    fs::remove(manifest(dir_, manifest_key(e.path)), ec);
+    total -= e.size;
+  }
+}
+
+
+Cache_stats
+Object_cache::stats() const
+{
+  Cache_stats s;
+  std::ifstream f((dir_ / "stats").string());
+  String line;
+  while (std::getline(f, line)) {
+    if (line == "hit")
+      ++s.hits;
+    else if (line == "miss")
+      ++s.misses;
+  }
+
+  boost::system::error_code ec;
+  for (fs::directory_iterator i(dir_), e; i != e; ++i) {
+    Path const& p = i->path();
+    File_kind k = get_file_kind(p);
+    if (k == object_file)
+      ++s.entries;
+    if (k == object_file || k == interface_file)
+      s.bytes += fs::file_size(p, ec);
+  }
+  return s;
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_OBJECT_CACHE_HPP
+#define BEAKER_OBJECT_CACHE_HPP
+
+// The object cache retains the object files produced by
+// the compiler on disk, across processes. An entry is
+// addressed by a hash of everything that determines the
+// object: the bytes of the sources and of the interfaces
+// they import, the compiler version, the target, and the
+// options that affect translation.
+//
+// Imports are not known until the sources are parsed. A
+// lookup is keyed by the sources and options alone. That
+// key names a manifest, which lists the modules imported
+// by the sources, and is written with the entry. The entry
+// itself is keyed by that key and the bytes of the
+// interfaces that the imported modules currently resolve
+// to. The interface written with an entry is never part
+// of its own key.
+//
+// Entries are written to a temporary file and renamed
+// into place, so concurrent builds sharing a cache never
+// see a partial entry. When the cache exceeds its size
+// limit, the least recently used entries are removed.
+
+#include <beaker/prelude.hpp>
+#include <beaker/file.hpp>
+
+#include <cstdint>
+#include <vector>
+
+
+// Statistics for a cache directory.
+struct Cache_stats
+{
+  std::size_t   hits = 0;
+  std::size_t   misses = 0;
+  std::size_t   entries = 0;
+  std::uintmax_t bytes = 0;
+};
+
+
+class Object_cache
+{
+public:
+  Object_cache(Path const&, std::uintmax_t);
+
+  String key(Path_seq const&, String const&) const;
+
+  bool get(String const&, Path_seq const&, Path const&, Path const&);
+  void put(String const&, std::vector<String> const&, Path_seq const&, Path const&, Path const&);
+
+  Cache_stats stats() const;
+
+private:
+  String entry(String const&, std::vector<String> const&, Path_seq const&, Path const&) const;
+
+  void record(char const*);
+  void evict();
+
+  Path           dir_;
+  std::uintmax_t limit_;
+};
+
+
+#endif
@@ -0,0 +1,142 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "beaker/optimizer.hpp"
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Module.h>
+
+#if LLVM_VERSION_MAJOR >= 14
+#  include <llvm/Passes/PassBuilder.h>
+#else
+#  include <llvm/IR/LegacyPassManager.h>
+#  include <llvm/Transforms/IPO.h>
+#  include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#endif
+
+
+// Parse the argument of -O. Returns false if the
+// argument does not name a level.
+bool
+parse_opt_level(String const& s, Opt_level& l)
+{
+  if (s == "0")
+    l = o0_opt;
+  else if (s == "1")
+    l = o1_opt;
+  else if (s == "2")
+    l = o2_opt;
+  else if (s == "3")
+    l = o3_opt;
+  else if (s == "s")
+    l = os_opt;
+  else
+    return false;
+  return true;
+}
+
+
+// Returns the flag that selects the corresponding
+// code generation level in llc. Code generation has
+// no size level, so -Os generates code as -O2.
+char const*
+llc_opt_flag(Opt_level l)
+{
+  switch (l) {
+    case o0_opt: return "-O0";
+    case o1_opt: return "-O1";
+    case o2_opt: return "-O2";
+    case o3_opt: return "-O3";
+    case os_opt: return "-O2";
+  }
+  lingo_unreachable();
+}
+
+
+#if LLVM_VERSION_MAJOR >= 14
+
+namespace
+{
+
+llvm::OptimizationLevel
+get_level(Opt_level l)
+{
+  switch (l) {
+    case o0_opt: return llvm::OptimizationLevel::O0;
+    case o1_opt: return llvm::OptimizationLevel::O1;
+    case o2_opt: return llvm::OptimizationLevel::O2;
+    case o3_opt: return llvm::OptimizationLevel::O3;
+    case os_opt: return llvm::OptimizationLevel::Os;
+  }
+  lingo_unreachable();
+}
+
+} // namespace
+
+
+// Run the default module pipeline for the given level.
+// The analysis managers must be registered with each
+// other before the pipeline is built. A whole program is
+// optimized as by link-time optimization: the pre-link
+// pipeline, then the interprocedural one.
+void
+optimize_module(llvm::Module* m, Opt_level l, bool whole)
+{
+  if (l == o0_opt)
+    return;
+
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  llvm::PassBuilder pb;
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  if (whole) {
+    llvm::ModulePassManager pre = pb.buildLTOPreLinkDefaultPipeline(get_level(l));
+    pre.run(*m, mam);
+    llvm::ModulePassManager lto = pb.buildLTODefaultPipeline(get_level(l), nullptr);
+    lto.run(*m, mam);
+    return;
+  }
+  llvm::ModulePassManager mpm = pb.buildPerModuleDefaultPipeline(get_level(l));
+  mpm.run(*m, mam);
+}
+
+#else
+
+// Run the function passes over each definition, and
+// then the module passes, as configured for the given
+// level by the pass manager builder. A whole program
+// also gets the link-time passes.
+void
+optimize_module(llvm::Module* m, Opt_level l, bool whole)
+{
+  if (l == o0_opt)
+    return;
+
+  llvm::PassManagerBuilder pmb;
+  pmb.OptLevel = l == os_opt ? 2 : l;
+  pmb.SizeLevel = l == os_opt ? 1 : 0;
+  pmb.Inliner = llvm::createFunctionInliningPass(pmb.OptLevel, pmb.SizeLevel);
+
+  llvm::legacy::FunctionPassManager fpm(m);
+  llvm::legacy::PassManager mpm;
+  pmb.populateFunctionPassManager(fpm);
+  pmb.populateModulePassManager(mpm);
+  if (whole)
+    pmb.populateLTOPassManager(mpm);
+
+  fpm.doInitialization();
+  for (llvm::Function& f : *m)
+    fpm.run(f);
+  fpm.doFinalization();
+  mpm.run(*m);
+}
+
+#endif
@@ -0,0 +1,41 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_OPTIMIZER_HPP
+#define BEAKER_OPTIMIZER_HPP
+
+// Optimization of generated LLVM modules.
+//
+// The optimizer runs LLVM's standard module and function
+// pass pipelines in-process on the output of the generator.
+// At level 0, the module is left unchanged. A module
+// that is a whole program is also optimized across
+// functions, as by link-time optimization.
+
+#include <beaker/prelude.hpp>
+
+
+namespace llvm
+{
+class Module;
+} // namespace llvm
+
+
+// The optimization levels selected by -O.
+enum Opt_level
+{
+  o0_opt,  // No optimization
+  o1_opt,  // Optimizations that are cheap to run
+  o2_opt,  // Most optimizations
+  o3_opt,  // Optimizations that may increase code size
+  os_opt,  // Optimize for size
+};
+
+
+bool parse_opt_level(String const&, Opt_level&);
+char const* llc_opt_flag(Opt_level);
+
+void optimize_module(llvm::Module*, Opt_level, bool = false);
+
+
+#endif
@@ -0,0 +1,223 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/parse_cache.hpp"
+#include "beaker/lexer.hpp"
+#include "beaker/parser.hpp"
+#include "beaker/elaborator.hpp"
+#include "beaker/error.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+namespace
+{
+
+Parse_cache* cache_ = nullptr;
+
+
+// The number of compilations retained by a build state.
+// Nodes reused from a previous compilation may live in the
+// arena of any of them. When this many are retained, the
+// state is discarded and the file is elaborated anew, which
+// releases them all.
+constexpr std::size_t max_generations = 16;
+
+
+// Captures the diagnostics written while parsing a cached
+// file. Those are not reported by the cache; a file that
+// does not parse cleanly is not cached, so the compilation
+// that uses it parses it again and reports them.
+struct Diagnostic_sentinel
+{
+  Diagnostic_sentinel()
+    : prev(std::cerr.rdbuf(buf.rdbuf()))
+  { }
+
+  ~Diagnostic_sentinel()
+  {
+    std::cerr.rdbuf(prev);
+  }
+
+  bool empty() { return buf.tellp() <= 0; }
+
+  std::stringstream buf;
+  std::streambuf*   prev;
+};
+
+
+String
+read(Path const& p)
+{
+  std::ifstream ifs(p.string(), std::ios::binary);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+
+// Parse the text of f into its module, fingerprinting
+// its declarations.
+bool
+parse(Symbol_table& syms, Parsed_file& f, String const& text, Fingerprint_map& prints)
+{
+  Arena_sentinel alloc(f.module->arena());
+  Diagnostic_sentinel diags;
+  try {
+    Input_buffer buf = text;
+    Token_stream ts;
+    Lexer lex(syms, buf);
+    if (!lex.lex(ts))
+      return false;
+
+    Parser parse(syms, ts, f.locs, prints);
+    parse.module(f.module.get());
+  } catch (Translation_error&) {
+    return false;
+  }
+  return diags.empty();
+}
+
+
+// Elaborate the module of f, reusing the previous
+// elaboration retained by e. On success, the module is
+// owned by e's build state. Otherwise, the module and the
+// state may be partially elaborated, and neither can be
+// used again.
+bool
+elaborate(Symbol_table& syms, Elaborated_file& e, Parsed_file& f, Fingerprint_map const& prints)
+{
+  Arena_sentinel alloc(f.module->arena());
+  Diagnostic_sentinel diags;
+  try {
+    Elaborator elab(f.locs, syms);
+    e.state.elaborate(std::move(f.module), prints, elab);
+  } catch (Translation_error&) {
+    return false;
+  }
+  if (!diags.empty())
+    return false;
+  e.locs.insert(f.locs.begin(), f.locs.end());
+  f.elaborated = true;
+  return true;
+}
+
+} // namespace
+
+
+// Ensure that the cache holds the current parse of the
+// file at p. Returns false if the file cannot be read or
+// does not parse cleanly.
+bool
+Parse_cache::load(Path const& p)
+{
+  Path path;
+  std::time_t time;
+  try {
+    path = fs::canonical(p);
+    time = fs::last_write_time(path);
+  } catch (fs::filesystem_error&) {
+    return false;
+  }
+
+  auto iter = files_.find(path.string());
+  if (iter != files_.end() && iter->second->mtime == time)
+    return true;
+
+  // The file was touched. Only reparse if its
+  // contents actually changed.
+  String text = read(path);
+  std::size_t hash = std::hash<String>()(text);
+  if (iter != files_.end() && iter->second->hash == hash) {
+    iter->second->mtime = time;
+    return true;
+  }
+
+  if (iter != files_.end())
+    files_.erase(iter);
+
+  std::unique_ptr<Parsed_file> f(new Parsed_file(path));
+  f->mtime = time;
+  f->hash = hash;
+  f->module.reset(new Module_decl());
+  Fingerprint_map prints;
+  if (!parse(syms, *f, text, prints))
+    return false;
+
+  // Elaborate a file that imports nothing. If that fails,
+  // the file is parsed again, and the compilation that uses
+  // it elaborates it and reports the errors.
+  if (f->module->imports().empty()) {
+    Elaborated_file& e = states_[path.string()];
+    if (e.state.generations() >= max_generations)
+      e = Elaborated_file();
+    if (!elaborate(syms, e, *f, prints)) {
+      e = Elaborated_file();
+      f->locs.clear();
+      f->module.reset(new Module_decl());
+      prints.clear();
+      parse(syms, *f, text, prints);
+    }
+  }
+  files_.emplace(path.string(), std::move(f));
+  return true;
+}
+
+
+// Returns the cached module for the file at p, or
+// nullptr if the file is not cached or was elaborated.
+// The locations of its nodes are added to locs. This does
+// not check that the entry is current; see load().
+Module_decl*
+Parse_cache::get(Path const& p, Location_map& locs)
+{
+  try {
+    auto iter = files_.find(fs::canonical(p).string());
+    if (iter == files_.end() || !iter->second->module)
+      return nullptr;
+    Parsed_file& f = *iter->second;
+    locs.insert(f.locs.begin(), f.locs.end());
+    return f.module.get();
+  } catch (fs::filesystem_error&) { }
+  return nullptr;
+}
+
+
+// Returns the elaborated module for the file at p, or
+// nullptr if the file is not cached or was not elaborated.
+// The locations of its nodes are added to locs.
+//
+// Records in the module were laid out without reordering
+// their fields, and all of its functions are defined.
+Module_decl*
+Parse_cache::elaborated(Path const& p, Location_map& locs)
+{
+  try {
+    String path = fs::canonical(p).string();
+    auto iter = files_.find(path);
+    if (iter == files_.end() || !iter->second->elaborated)
+      return nullptr;
+    Elaborated_file& e = states_.at(path);
+    locs.insert(e.locs.begin(), e.locs.end());
+    return e.state.module();
+  } catch (fs::filesystem_error&) { }
+  return nullptr;
+}
+
+
+Parse_cache*
+parse_cache()
+{
+  return cache_;
+}
+
+
+void
+parse_cache(Parse_cache* c)
+{
+  cache_ = c;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_PARSE_CACHE_HPP
+#define BEAKER_PARSE_CACHE_HPP
+
+// The parse cache retains the parsed form of source files
+// across compilations in a long-lived process. An entry is
+// reused while the file's modification time is unchanged.
+// When the time changes, the file is read and its contents
+// hashed; the entry is reparsed only if the hash differs.
+//
+// A file that imports no modules is also elaborated when it
+// is loaded, reusing its previous elaboration where possible
+// (see Build_state). Elaboration only annotates the parsed
+// declarations; the passes that rewrite them run in the
+// processes that use the cache, which are forked from its
+// owner. Those see a copy of the elaborated module, so the
+// cached module is never modified by them.
+
+#include <beaker/prelude.hpp>
+#include <beaker/file.hpp>
+#include <beaker/location.hpp>
+#include <beaker/decl.hpp>
+#include <beaker/incremental.hpp>
+
+#include <ctime>
+#include <memory>
+#include <unordered_map>
+
+
+// A parsed source file. The module owns the nodes
+// produced by the parser. When the file is elaborated,
+// its module is given to the file's build state.
+struct Parsed_file
+{
+  Parsed_file(Path const& p)
+    : file(p.c_str()), elaborated(false)
+  { }
+
+  File                         file;
+  std::time_t                  mtime;
+  std::size_t                  hash;
+  Location_map                 locs;
+  std::unique_ptr<Module_decl> module;
+  bool                         elaborated;
+};
+
+
+// The elaboration retained for a source file, and the
+// locations of every node that it may refer to.
+struct Elaborated_file
+{
+  Build_state  state;
+  Location_map locs;
+};
+
+
+// The cache owns the parsed files. A file that is reparsed
+// (or fails to parse) is destroyed. Nothing else in the
+// owning process refers to its nodes: canonical types do not
+// refer to nodes in any arena, and the compilations that use
+// the cache run in forked processes, each with its own copy.
+class Parse_cache
+{
+public:
+  Parse_cache(Symbol_table& s)
+    : syms(s)
+  { }
+
+  bool         load(Path const&);
+  Module_decl* get(Path const&, Location_map&);
+  Module_decl* elaborated(Path const&, Location_map&);
+
+  Symbol_table& symbols() { return syms; }
+
+private:
+  Symbol_table& syms;
+  std::unordered_map<String, std::unique_ptr<Parsed_file>> files_;
+  std::unordered_map<String, Elaborated_file>              states_;
+};
+
+
+// Returns the parse cache installed for this process,
+// or nullptr if there is none.
+Parse_cache* parse_cache();
+
+void parse_cache(Parse_cache*);
+
+
+#endif
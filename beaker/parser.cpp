@@ -140,151 +140,89 @@ Parser::unary_expr()
 }
 
 
-// Parse a multiplicative expression.
-//
-//    multiplicative-expr -> multiplicative-expr '*' unary-expr
-//                         | multiplicative-expr '/' unary-expr
-//                         | multiplicative-expr '%' unary-expr
-//                         | unary-expr
-Expr*
-Parser::multiplicative_expr()
+// Binary operators are described by a precedence and the
+// action that builds the expression. Higher precedences
+// bind more tightly. All binary operators are left
+// associative.
+struct Parser::Binary_op
 {
-  Expr* e1 = unary_expr();
-  while (true) {
-    if (match_if(star_tok)) {
-      Expr* e2 = unary_expr();
-      e1 = on_mul(e1, e2);
-    } else if (match_if(slash_tok)) {
-      Expr* e2 = unary_expr();
-      e1 = on_div(e1, e2);
-    } else if (match_if(percent_tok)) {
-      Expr* e2 = unary_expr();
-      e1 = on_rem(e1, e2);
-    } else {
-      break;
-    }
-  }
-  return e1;
-}
+  int prec;
+  Expr* (Parser::*action)(Expr*, Expr*);
+};
 
 
-// Parse an additive expression.
+// Returns the binary operator for the token kind k, or
+// nullptr if k does not name a binary operator. The table
+// is indexed by token kind.
 //
-//    additive-expr -> additive-expr '*' multiplicative-expr
-//                   | additive-expr '/' multiplicative-expr
-//                   | multiplicative-expr
-Expr*
-Parser::additive_expr()
-{
-  Expr* e1 = multiplicative_expr();
-  while (true) {
-    if (match_if(plus_tok)) {
-      Expr* e2 = multiplicative_expr();
-      e1 = on_add(e1, e2);
-    } else if (match_if(minus_tok)) {
-      Expr* e2 = multiplicative_expr();
-      e1 = on_sub(e1, e2);
-    } else {
-      break;
-    }
-  }
-  return e1;
-}
-
-
-// Parse an additive expression.
+// Adding a new binary operator only requires a new entry
+// in this table.
+Parser::Binary_op const*
+Parser::binary_op(Token_kind k)
+{
+  static Binary_op const* table = []() {
+    static Binary_op t[identifier_tok + 1] {};
+    t[or_tok]      = {1, &Parser::on_or};
+    t[and_tok]     = {2, &Parser::on_and};
+    t[eq_tok]      = {3, &Parser::on_eq};
+    t[ne_tok]      = {3, &Parser::on_ne};
+    t[lt_tok]      = {4, &Parser::on_lt};
+    t[gt_tok]      = {4, &Parser::on_gt};
+    t[le_tok]      = {4, &Parser::on_le};
+    t[ge_tok]      = {4, &Parser::on_ge};
+    t[plus_tok]    = {5, &Parser::on_add};
+    t[minus_tok]   = {5, &Parser::on_sub};
+    t[star_tok]    = {6, &Parser::on_mul};
+    t[slash_tok]   = {6, &Parser::on_div};
+    t[percent_tok] = {6, &Parser::on_rem};
+    return t;
+  }();
+
+  if (k < 0 || k > identifier_tok)
+    return nullptr;
+  Binary_op const* op = &table[k];
+  return op->prec ? op : nullptr;
+}
+
+
+// Parse a binary expression whose operators have at
+// least the given precedence. This is a precedence
+// climbing parser over the following grammar.
+//
+//    logical-or-expr -> logical-or-expr '||' logical-and-expr
+//                     | logical-and-expr
+//
+//    logical-and-expr -> logical-and-expr '&&' equality-expr
+//                      | equality-expr
+//
+//    equality-expr -> equality-expr '==' ordering-expr
+//                   | equality-expr '!=' ordering-expr
+//                   | ordering-expr
 //
 //    ordering-expr -> ordering-expr '<' additive-expr
 //                   | ordering-expr '>' additive-expr
 //                   | ordering-expr '<=' additive-expr
 //                   | ordering-expr '>=' additive-expr
 //                   | additive-expr
-Expr*
-Parser::ordering_expr()
-{
-  Expr* e1 = additive_expr();
-  while (true) {
-    if (match_if(lt_tok)) {
-      Expr* e2 = additive_expr();
-      e1 = on_lt(e1, e2);
-    } else if (match_if(gt_tok)) {
-      Expr* e2 = additive_expr();
-      e1 = on_gt(e1, e2);
-    } else if (match_if(le_tok)) {
-      Expr* e2 = additive_expr();
-      e1 = on_le(e1, e2);
-    } else if (match_if(ge_tok)) {
-      Expr* e2 = additive_expr();
-      e1 = on_ge(e1, e2);
-    } else {
-      break;
-    }
-  }
-  return e1;
-}
-
-
-// Parse an equality expression.
-//
-//    equality-expr -> equality-expr '<' ordering-expr
-//                   | equality-expr '>' ordering-expr
-//                   | equality-expr '<=' ordering-expr
-//                   | equality-expr '>=' ordering-expr
-//                   | ordering-expr
-Expr*
-Parser::equality_expr()
-{
-  Expr* e1 = ordering_expr();
-  while (true) {
-    if (match_if(eq_tok)) {
-      Expr* e2 = ordering_expr();
-      e1 = on_eq(e1, e2);
-    } else if (match_if(ne_tok)) {
-      Expr* e2 = ordering_expr();
-      e1 = on_ne(e1, e2);
-    } else {
-      break;
-    }
-  }
-  return e1;
-}
-
-
-// Parse a logical and expression.
 //
-//    logical-and-expr -> logical-and-expr '&&' equality-expr
-//                      | equality-expr
-Expr*
-Parser::logical_and_expr()
-{
-  Expr* e1 = equality_expr();
-  while (true) {
-    if (match_if(and_tok)) {
-      Expr* e2 = equality_expr();
-      e1 = on_and(e1, e2);
-    } else {
-      break;
-    }
-  }
-  return e1;
-}
-
-
-// Parse an logical or expression.
+//    additive-expr -> additive-expr '+' multiplicative-expr
+//                   | additive-expr '-' multiplicative-expr
+//                   | multiplicative-expr
 //
-//    logical-or-expr -> logical-or-expr '&&' logical-and-expr
-//                     | logical-and-expr
+//    multiplicative-expr -> multiplicative-expr '*' unary-expr
+//                         | multiplicative-expr '/' unary-expr
+//                         | multiplicative-expr '%' unary-expr
+//                         | unary-expr
 Expr*
-Parser::logical_or_expr()
+Parser::binary_expr(int prec)
 {
-  Expr* e1 = logical_and_expr();
-  while (true) {
-    if (match_if(or_tok)) {
-      Expr* e2 = logical_and_expr();
-      e1 = on_or(e1, e2);
-    } else {
+  Expr* e1 = unary_expr();
+  while (Binary_op const* op = binary_op(lookahead())) {
+    if (op->prec < prec)
       break;
-    }
+    accept();
+    Expr* e2 = binary_expr(op->prec + 1);
+    e1 = (this->*op->action)(e1, e2);
   }
   return e1;
 }
@@ -332,7 +270,7 @@ Parser::lambda_expr()
 Expr*
 Parser::expr()
 {
-  return logical_or_expr();
+  return binary_expr(1);
 }
 
 
@@ -968,12 +906,33 @@ Parser::stmt()
 // Top level parsing
 
 
+// Parse an import declaration.
+//
+//    import-decl -> 'import' identifier ';'
+//
+// The import is recorded in the module. It is resolved
+// by the compiler before elaboration.
+void
+Parser::import_decl(Module_decl* m)
+{
+  require(import_kw);
+  Token n = match(identifier_tok);
+  match(semicolon_tok);
+  on_import(m, n);
+}
+
+
 // Parse a module.
 //
 //    module -> decl-seq | <empty>
 //
 //    decl-seq -> decl | decl-seq
 //
+//    decl -> import-decl
+//
+// If a fingerprint map was given, the tokens of each
+// top-level declaration are fingerprinted.
+//
 // TODO: Return an empty module.
 Decl*
 Parser::module(Module_decl* m)
@@ -981,8 +940,15 @@ Parser::module(Module_decl* m)
   Decl_seq decls;
   while (!ts_.eof()) {
     try {
+      if (lookahead() == import_kw) {
+        import_decl(m);
+        continue;
+      }
+      Token_stream::Position first = ts_.position();
       Decl* d = decl();
       decls.push_back(d);
+      if (prints_)
+        prints_->emplace(d, fingerprint(first, ts_.position()));
     } catch (Translation_error& err) {
       diagnose(err);
       consume_thru(term_);
@@ -1187,7 +1153,7 @@ Parser::on_str(Token tok)
   // explicitly more than the length of the string,
   // and includes the null character.
   Type const* z = get_integer_type();
-  Expr* n = new Literal_expr(z, v.len + 1);
+  Expr* n = make<Literal_expr>(z, v.len + 1);
 
   // Create the array type.
   Type const* c = get_character_type();
@@ -1200,132 +1166,132 @@ Parser::on_str(Token tok)
 Expr*
 Parser::on_add(Expr* e1, Expr* e2)
 {
-  return new Add_expr(e1, e2);
+  return make<Add_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_sub(Expr* e1, Expr* e2)
 {
-  return new Sub_expr(e1, e2);
+  return make<Sub_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_mul(Expr* e1, Expr* e2)
 {
-  return new Mul_expr(e1, e2);
+  return make<Mul_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_div(Expr* e1, Expr* e2)
 {
-  return new Div_expr(e1, e2);
+  return make<Div_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_rem(Expr* e1, Expr* e2)
 {
-  return new Rem_expr(e1, e2);
+  return make<Rem_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_neg(Expr* e)
 {
-  return new Neg_expr(e);
+  return make<Neg_expr>(e);
 }
 
 
 Expr*
 Parser::on_pos(Expr* e)
 {
-  return new Pos_expr(e);
+  return make<Pos_expr>(e);
 }
 
 
 Expr*
 Parser::on_eq(Expr* e1, Expr* e2)
 {
-  return new Eq_expr(e1, e2);
+  return make<Eq_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_ne(Expr* e1, Expr* e2)
 {
-  return new Ne_expr(e1, e2);
+  return make<Ne_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_lt(Expr* e1, Expr* e2)
 {
-  return new Lt_expr(e1, e2);
+  return make<Lt_expr>(e1, e2);
 }
 
 Expr*
 Parser::on_gt(Expr* e1, Expr* e2)
 {
-  return new Gt_expr(e1, e2);
+  return make<Gt_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_le(Expr* e1, Expr* e2)
 {
-  return new Le_expr(e1, e2);
+  return make<Le_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_ge(Expr* e1, Expr* e2)
 {
-  return new Ge_expr(e1, e2);
+  return make<Ge_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_and(Expr* e1, Expr* e2)
 {
-  return new And_expr(e1, e2);
+  return make<And_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_or(Expr* e1, Expr* e2)
 {
-  return new Or_expr(e1, e2);
+  return make<Or_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_not(Expr* e)
 {
-  return new Not_expr(e);
+  return make<Not_expr>(e);
 }
 
 
 Expr*
 Parser::on_call(Expr* e, Expr_seq const& a)
 {
-  return new Call_expr(e, a);
+  return make<Call_expr>(e, a);
 }
 
 
 Expr*
 Parser::on_index(Expr* e1, Expr* e2)
 {
-  return new Index_expr(e1, e2);
+  return make<Index_expr>(e1, e2);
 }
 
 
 Expr*
 Parser::on_dot(Expr* e1, Expr* e2)
 {
-  return new Dot_expr(e1, e2);
+  return make<Dot_expr>(e1, e2);
 }
 
 
@@ -1348,8 +1314,8 @@ Parser::on_lambda(Token tok, Decl_seq const& p, Type const* t, Stmt* b)
 Decl*
 Parser::on_variable(Specifier spec, Token tok, Type const* t)
 {
-  Expr* init = new Default_init(t);
-  Decl* decl = new Variable_decl(spec, tok.symbol(), t, init);
+  Expr* init = make<Default_init>(t);
+  Decl* decl = make<Variable_decl>(spec, tok.symbol(), t, init);
   locate(decl, tok.location());
   return decl;
 }
@@ -1358,8 +1324,8 @@ Parser::on_variable(Specifier spec, Token tok, Type const* t)
 Decl*
 Parser::on_variable(Specifier spec, Token tok, Type const* t, Token_kind tk)
 {
-  Expr* init = new Trivial_init(t);
-  Decl* decl = new Variable_decl(spec, tok.symbol(), t, init);
+  Expr* init = make<Trivial_init>(t);
+  Decl* decl = make<Variable_decl>(spec, tok.symbol(), t, init);
   locate(decl, tok.location());
   return decl;
 }
@@ -1368,8 +1334,8 @@ Parser::on_variable(Specifier spec, Token tok, Type const* t, Token_kind tk)
 Decl*
 Parser::on_variable(Specifier spec, Token tok, Type const* t, Expr* e)
 {
-  Expr* init = new Copy_init(t, e);
-  Decl* decl = new Variable_decl(spec, tok.symbol(), t, init);
+  Expr* init = make<Copy_init>(t, e);
+  Decl* decl = make<Variable_decl>(spec, tok.symbol(), t, init);
   locate(decl, tok.location());
   return decl;
 }
@@ -1381,14 +1347,14 @@ Parser::on_parameter(Specifier spec, Type const* t)
 {
   // Create (or get) an empty identifier.
   Symbol const* s = syms_.put<Identifier_sym>("", identifier_tok);
-  return new Parameter_decl(spec, s, t);
+  return make<Parameter_decl>(spec, s, t);
 }
 
 
 Decl*
 Parser::on_parameter(Specifier spec, Token tok, Type const* t)
 {
-  return new Parameter_decl(spec, tok.symbol(), t);
+  return make<Parameter_decl>(spec, tok.symbol(), t);
 }
 
 
@@ -1398,7 +1364,7 @@ Decl*
 Parser::on_function(Specifier spec, Token tok, Decl_seq const& p, Type const* t)
 {
   Type const* f = get_function_type(p, t);
-  return new Function_decl(spec, tok.symbol(), f, p, nullptr);
+  return make<Function_decl>(spec, tok.symbol(), f, p, nullptr);
 }
 
 
@@ -1406,7 +1372,7 @@ Decl*
 Parser::on_function(Specifier spec, Token tok, Decl_seq const& p, Type const* t, Stmt* b)
 {
   Type const* f = get_function_type(p, t);
-  Decl* decl = new Function_decl(tok.symbol(), f, p, b);
+  Decl* decl = make<Function_decl>(tok.symbol(), f, p, b);
   locate(decl, tok.location());
   return decl;
 }
@@ -1418,7 +1384,7 @@ Parser::on_function(Specifier spec, Token tok, Decl_seq const& p, Type const* t,
 Decl*
 Parser::on_record(Specifier spec, Token n, Decl_seq const& fs, Decl_seq const& ms, Type const* base)
 {
-  Decl* decl = new Record_decl(n.symbol(), fs, ms, base);
+  Decl* decl = make<Record_decl>(n.symbol(), fs, ms, base);
   locate(decl, n.location());
   return decl;
 }
@@ -1428,7 +1394,7 @@ Decl*
 Parser::on_method(Specifier spec, Token tok, Decl_seq const& p, Type const* t, Stmt* b)
 {
   Type const* f = get_function_type(p, t);
-  Decl* decl = new Method_decl(spec, tok.symbol(), f, p, b);
+  Decl* decl = make<Method_decl>(spec, tok.symbol(), f, p, b);
   locate(decl, tok.location());
   return decl;
 }
@@ -1437,7 +1403,7 @@ Parser::on_method(Specifier spec, Token tok, Decl_seq const& p, Type const* t, S
 Decl*
 Parser::on_field(Specifier spec, Token n, Type const* t)
 {
-  Decl* decl = new Field_decl(n.symbol(), t);
+  Decl* decl = make<Field_decl>(n.symbol(), t);
   locate(decl, n.location());
   return decl;
 }
@@ -1448,84 +1414,93 @@ Parser::on_field(Specifier spec, Token n, Type const* t)
 Decl*
 Parser::on_module(Module_decl* m, Decl_seq const& d)
 {
-  Decl_seq& d0 = m->decls_;
+  Decl_seq d0(m->decls_.begin(), m->decls_.end());
   d0.insert(d0.end(), d.begin(), d.end());
+  m->decls_ = Decl_list(d0, m->arena());
   return m;
 }
 
 
+// Record the import of the module named by n.
+void
+Parser::on_import(Module_decl* m, Token n)
+{
+  m->imports_.push_back(n.symbol());
+}
+
+
 Stmt*
 Parser::on_empty()
 {
-  return new Empty_stmt();
+  return make<Empty_stmt>();
 }
 
 
 Stmt*
-Parser::on_block(std::vector<Stmt*> const& s)
+Parser::on_block(Stmt_seq const& s)
 {
-  return new Block_stmt(s);
+  return make<Block_stmt>(s);
 }
 
 
 Stmt*
 Parser::on_assign(Expr* e1, Expr* e2)
 {
-  return new Assign_stmt(e1, e2);
+  return make<Assign_stmt>(e1, e2);
 }
 
 
 Stmt*
 Parser::on_return(Expr* e)
 {
-  return new Return_stmt(e);
+  return make<Return_stmt>(e);
 }
 
 
 Stmt*
 Parser::on_if_then(Expr* e, Stmt* s)
 {
-  return new If_then_stmt(e, s);
+  return make<If_then_stmt>(e, s);
 }
 
 
 Stmt*
 Parser::on_if_else(Expr* e, Stmt* s1, Stmt* s2)
 {
-  return new If_else_stmt(e, s1, s2);
+  return make<If_else_stmt>(e, s1, s2);
 }
 
 
 Stmt*
 Parser::on_while(Expr* c, Stmt* s)
 {
-  return new While_stmt(c, s);
+  return make<While_stmt>(c, s);
 }
 
 
 Stmt*
 Parser::on_break()
 {
-  return new Break_stmt();
+  return make<Break_stmt>();
 }
 
 
 Stmt*
 Parser::on_continue()
 {
-  return new Continue_stmt();
+  return make<Continue_stmt>();
 }
 
 
 Stmt*
 Parser::on_expression(Expr* e)
 {
-  return new Expression_stmt(e);
+  return make<Expression_stmt>(e);
 }
 
 
 Stmt*
 Parser::on_declaration(Decl* d)
 {
-  return new Declaration_stmt(d);
+  return make<Declaration_stmt>(d);
 }
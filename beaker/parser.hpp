@@ -9,6 +9,7 @@
 #include <beaker/decl.hpp>
 #include <beaker/specifier.hpp>
 #include <beaker/token.hpp>
+#include <beaker/incremental.hpp>
 
 
 class Input_buffer;
@@ -20,6 +21,7 @@ class Parser
 public:
   Parser(Symbol_table&, Token_stream&);
   Parser(Symbol_table&, Token_stream&, Location_map&);
+  Parser(Symbol_table&, Token_stream&, Location_map&, Fingerprint_map&);
 
   // Expression parsers
   Expr* primary_expr();
@@ -31,12 +33,7 @@ public:
   Expr* call_expr();
   Expr* postfix_expr();
   Expr* unary_expr();
-  Expr* multiplicative_expr();
-  Expr* additive_expr();
-  Expr* ordering_expr();
-  Expr* equality_expr();
-  Expr* logical_and_expr();
-  Expr* logical_or_expr();
+  Expr* binary_expr(int);
   Expr* expr();
 
   // Type parsers
@@ -56,6 +53,7 @@ public:
   Decl* record_decl(Specifier);
   Decl* field_decl(Specifier);
   Decl* method_decl(Specifier);
+  void  import_decl(Module_decl*);
   Specifier specifier_seq();
 
   // Statement parsers
@@ -131,6 +129,7 @@ private:
   //Decl* on_ctor(Specifier, Token, Decl_seq const&, Type const* Stmt*);
   //Decl* on_dtor(Specifier, Token, Decl_seq const&, Type const* Stmt*);
   Decl* on_module(Module_decl*, Decl_seq const&);
+  void  on_import(Module_decl*, Token);
 
   // FIXME: Remove _stmt from handlers.
   Stmt* on_empty();
@@ -145,6 +144,10 @@ private:
   Stmt* on_expression(Expr*);
   Stmt* on_declaration(Decl*);
 
+  // Binary operators
+  struct Binary_op;
+  static Binary_op const* binary_op(Token_kind);
+
   // Parsing support
   Token_kind lookahead() const;
   Token_kind lookahead(int) const;
@@ -170,6 +173,7 @@ private:
   Symbol_table& syms_;
   Token_stream& ts_;
   Location_map* locs_;
+  Fingerprint_map* prints_; // Fingerprints of top-level declarations
 
   Specifier spec_;  // Current specifeirs
 
@@ -182,12 +186,17 @@ private:
 
 inline
 Parser::Parser(Symbol_table& s, Token_stream& t)
-  : syms_(s), ts_(t), locs_(nullptr), errs_(0), term_()
+  : syms_(s), ts_(t), locs_(nullptr), prints_(nullptr), errs_(0), term_()
 { }
 
 inline
 Parser::Parser(Symbol_table& s, Token_stream& t, Location_map& l)
-  : syms_(s), ts_(t), locs_(&l), errs_(0), term_()
+  : syms_(s), ts_(t), locs_(&l), prints_(nullptr), errs_(0), term_()
+{ }
+
+inline
+Parser::Parser(Symbol_table& s, Token_stream& t, Location_map& l, Fingerprint_map& f)
+  : syms_(s), ts_(t), locs_(&l), prints_(&f), errs_(0), term_()
 { }
 
 
@@ -216,14 +225,15 @@ Parser::locate(void* p, Location l)
 
 
 // A helper function to create nodes and record their
-// source location.
+// source location. Nodes are allocated in the current
+// arena.
 //
 // TODO: Put this in the .cpp file? It is private.
 template<typename T, typename... Args>
 inline T*
 Parser::init(Location loc, Args&&... args)
 {
-  T* t = new T(std::forward<Args>(args)...);
+  T* t = make<T>(std::forward<Args>(args)...);
   locs_->emplace(t, loc);
   return t;
 }
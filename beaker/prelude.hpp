@@ -10,6 +10,9 @@
 #include <lingo/print.hpp>
 #include <lingo/io.hpp>
 
+#include <beaker/arena.hpp>
+#include <beaker/span.hpp>
+
 #include <iosfwd>
 #include <vector>
 #include <stdexcept>
@@ -103,13 +106,26 @@ struct Continue_stmt;
 struct Expression_stmt;
 struct Declaration_stmt;
 
+struct Overload;
+
 
+// Sequences are used to build the operands of nodes,
+// and are then copied into a span. They are ordinary
+// heap vectors, so that temporaries and reallocations
+// do not consume arena memory.
 using Expr_seq = std::vector<Expr*>;
 using Type_seq = std::vector<Type const*>;
 using Decl_seq = std::vector<Decl*>;
 using Stmt_seq = std::vector<Stmt*>;
 
 
+// Nodes store their operands in fixed-length spans.
+// Sequences are used to build them.
+using Expr_list = Span<Expr*>;
+using Decl_list = Span<Decl*>;
+using Stmt_list = Span<Stmt*>;
+
+
 #include <beaker/symbol.hpp> // TODO: Do I need this?
 #include <beaker/print.hpp>
 
@@ -0,0 +1,322 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/remote.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace
+{
+
+// Initialize a socket address for the path p. Returns
+// false if the path is too long.
+bool
+make_address(std::string const& p, sockaddr_un& addr)
+{
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (p.size() >= sizeof(addr.sun_path))
+    return false;
+  std::strcpy(addr.sun_path, p.c_str());
+  return true;
+}
+
+
+// Returns the directory part of the path p.
+std::string
+parent(std::string const& p)
+{
+  std::string::size_type n = p.rfind('/');
+  if (n == std::string::npos)
+    return ".";
+  if (n == 0)
+    return "/";
+  return p.substr(0, n);
+}
+
+
+// Ensure that the directory d exists and that only
+// the current user can create or remove files in it.
+// Otherwise, another user could replace the socket.
+bool
+make_private_dir(std::string const& d)
+{
+  if (::mkdir(d.c_str(), 0700) < 0 && errno != EEXIST)
+    return false;
+  struct stat st;
+  if (::lstat(d.c_str(), &st) < 0)
+    return false;
+  return S_ISDIR(st.st_mode)
+      && st.st_uid == ::getuid()
+      && (st.st_mode & 022) == 0;
+}
+
+
+// Remove a socket left at the path p by a server that
+// is no longer running. Returns false if there is a live
+// server, or if p names something other than a socket.
+bool
+remove_stale_socket(std::string const& p, sockaddr_un const& addr)
+{
+  struct stat st;
+  if (::lstat(p.c_str(), &st) < 0)
+    return errno == ENOENT;
+  if (!S_ISSOCK(st.st_mode))
+    return false;
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return false;
+  bool live = ::connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) == 0;
+  ::close(fd);
+  return !live && ::unlink(p.c_str()) == 0;
+}
+
+
+bool
+write_all(int fd, void const* p, std::size_t n)
+{
+  char const* s = static_cast<char const*>(p);
+  while (n) {
+    ssize_t k = ::write(fd, s, n);
+    if (k <= 0)
+      return false;
+    s += k;
+    n -= k;
+  }
+  return true;
+}
+
+
+bool
+read_all(int fd, void* p, std::size_t n)
+{
+  char* s = static_cast<char*>(p);
+  while (n) {
+    ssize_t k = ::read(fd, s, n);
+    if (k <= 0)
+      return false;
+    s += k;
+    n -= k;
+  }
+  return true;
+}
+
+
+// Strings are written as a 32-bit length followed
+// by their characters.
+void
+put(std::string& buf, std::string const& s)
+{
+  std::uint32_t n = s.size();
+  buf.append(reinterpret_cast<char const*>(&n), sizeof(n));
+  buf.append(s);
+}
+
+
+bool
+get(int fd, std::string& s)
+{
+  std::uint32_t n;
+  if (!read_all(fd, &n, sizeof(n)))
+    return false;
+  s.resize(n);
+  return n == 0 || read_all(fd, &s[0], n);
+}
+
+} // namespace
+
+
+// Returns the path of the server's socket. This is given
+// by the BEAKER_SERVER environment variable. Otherwise, the
+// socket is in the user's runtime directory or, if there
+// is none, in a directory under /tmp private to the user.
+std::string
+default_socket()
+{
+  if (char const* p = std::getenv("BEAKER_SERVER"))
+    return p;
+  if (char const* d = std::getenv("XDG_RUNTIME_DIR"))
+    if (*d)
+      return std::string(d) + "/beaker-serve.sock";
+  return "/tmp/beaker-" + std::to_string(::getuid()) + "/serve.sock";
+}
+
+
+// Returns true if the process at the other end of the
+// connection fd is run by the current user.
+bool
+same_user(int fd)
+{
+#if defined(SO_PEERCRED)
+  ucred cred;
+  socklen_t n = sizeof(cred);
+  if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &n) < 0)
+    return false;
+  return cred.uid == ::getuid();
+#else
+  uid_t uid;
+  gid_t gid;
+  if (::getpeereid(fd, &uid, &gid) < 0)
+    return false;
+  return uid == ::getuid();
+#endif
+}
+
+
+// Create a socket listening at the path p. The socket's
+// directory must be private to the current user; it is
+// created if it does not exist. A stale socket left at p
+// is replaced, but nothing else is. Returns -1 on error.
+int
+listen_socket(std::string const& p)
+{
+  sockaddr_un addr;
+  if (!make_address(p, addr))
+    return -1;
+  if (!make_private_dir(parent(p)) || !remove_stale_socket(p, addr))
+    return -1;
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+      || ::chmod(p.c_str(), 0600) < 0
+      || ::listen(fd, SOMAXCONN) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+// Connect to the server at the path p. Returns -1 if
+// there is no server, or if the server is run by another
+// user; the client's streams are not given to it.
+int
+connect_socket(std::string const& p)
+{
+  sockaddr_un addr;
+  if (!make_address(p, addr))
+    return -1;
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+      || !same_user(fd)) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+// Send a request. The file descriptors are sent as
+// ancillary data with the first byte of the message.
+// The rest of the request follows in a single write.
+bool
+send_request(int fd, Request const& req)
+{
+  char tag = 'R';
+  iovec iov = {&tag, 1};
+
+  char ctl[CMSG_SPACE(sizeof(req.fds))];
+  std::memset(ctl, 0, sizeof(ctl));
+
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctl;
+  msg.msg_controllen = sizeof(ctl);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(req.fds));
+  std::memcpy(CMSG_DATA(cmsg), req.fds, sizeof(req.fds));
+
+  if (::sendmsg(fd, &msg, 0) != 1)
+    return false;
+
+  std::string buf;
+  put(buf, req.command);
+  put(buf, req.cwd);
+  std::uint32_t n = req.args.size();
+  buf.append(reinterpret_cast<char const*>(&n), sizeof(n));
+  for (std::string const& s : req.args)
+    put(buf, s);
+  return write_all(fd, buf.data(), buf.size());
+}
+
+
+// Receive a request. On success, the caller owns the
+// received file descriptors.
+bool
+receive_request(int fd, Request& req)
+{
+  char tag;
+  iovec iov = {&tag, 1};
+
+  char ctl[CMSG_SPACE(sizeof(req.fds))];
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctl;
+  msg.msg_controllen = sizeof(ctl);
+
+  if (::recvmsg(fd, &msg, 0) != 1 || tag != 'R')
+    return false;
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg
+      || cmsg->cmsg_level != SOL_SOCKET
+      || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN(sizeof(req.fds)))
+    return false;
+  std::memcpy(req.fds, CMSG_DATA(cmsg), sizeof(req.fds));
+
+  std::uint32_t n;
+  bool ok = get(fd, req.command)
+         && get(fd, req.cwd)
+         && read_all(fd, &n, sizeof(n));
+  for (std::uint32_t i = 0; ok && i < n; ++i) {
+    req.args.emplace_back();
+    ok = get(fd, req.args.back());
+  }
+  if (!ok) {
+    for (int f : req.fds)
+      ::close(f);
+  }
+  return ok;
+}
+
+
+bool
+send_status(int fd, int status)
+{
+  std::int32_t n = status;
+  return write_all(fd, &n, sizeof(n));
+}
+
+
+// Receive the exit status of a request. This fails
+// if the server exited without replying.
+bool
+receive_status(int fd, int& status)
+{
+  std::int32_t n;
+  if (!read_all(fd, &n, sizeof(n)))
+    return false;
+  status = n;
+  return true;
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_REMOTE_HPP
+#define BEAKER_REMOTE_HPP
+
+// The protocol between the compile server (beaker-serve)
+// and its client (beaker-client). Requests are made over
+// a Unix domain socket.
+//
+// A request names a command, the client's working
+// directory, and the command's arguments. The client's
+// standard streams are passed along with the request so
+// that the server writes output and diagnostics directly
+// to them. The server replies with the exit status of
+// the command.
+//
+// The socket is private to the user that runs the server,
+// and each end of a connection checks that the other is
+// run by the same user.
+//
+// Note that this header does not depend on the rest of
+// the compiler; the client must stay small.
+
+#include <string>
+#include <vector>
+
+
+struct Request
+{
+  std::string              command;
+  std::string              cwd;
+  std::vector<std::string> args;
+  int                      fds[3];
+};
+
+
+std::string default_socket();
+
+int listen_socket(std::string const&);
+int connect_socket(std::string const&);
+bool same_user(int);
+
+bool send_request(int, Request const&);
+bool receive_request(int, Request&);
+
+bool send_status(int, int);
+bool receive_status(int, int&);
+
+
+#endif
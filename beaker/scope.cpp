@@ -7,6 +7,147 @@
 #include "beaker/decl.hpp"
 
 
+// Create a private stack whose outermost scope is s.
+// The bindings of s are those of its identifiers, and
+// are not rebound.
+Scope_stack::Scope_stack(Scope* s)
+  : local_(true)
+{
+  marks_.push_back(0);
+  push_back(s);
+}
+
+
+// Restore all shadowed bindings and release recycled
+// scopes. Scopes that remain on the stack are owned
+// by their users.
+Scope_stack::~Scope_stack()
+{
+  while (!undo_.empty()) {
+    restore(undo_.back());
+    undo_.pop_back();
+  }
+  for (Scope* s : free_)
+    delete s;
+}
+
+
+// Enter a new scope associated with the declaration d.
+// A recycled scope is used when one is available.
+void
+Scope_stack::push(Decl* d)
+{
+  Scope* s;
+  if (free_.empty()) {
+    s = new Scope(d);
+  } else {
+    s = free_.back();
+    free_.pop_back();
+    s->decl = d;
+  }
+  marks_.push_back(undo_.size());
+  push_back(s);
+}
+
+
+// Re-enter an existing scope (e.g., that of a record).
+// Each of the scope's bindings becomes the innermost
+// binding of its identifier.
+void
+Scope_stack::push(Scope* s)
+{
+  marks_.push_back(undo_.size());
+  push_back(s);
+  for (Scope::Binding& b : *s)
+    shadow(b.first, &b.second);
+}
+
+
+// Leave the current scope. The scope is cleared and
+// retained for reuse.
+void
+Scope_stack::pop()
+{
+  unwind();
+  Scope* s = back();
+  pop_back();
+  s->clear();
+  s->decl = nullptr;
+  free_.push_back(s);
+}
+
+
+// Leave the current scope, and return it. The scope is
+// not destroyed.
+Scope*
+Scope_stack::take()
+{
+  unwind();
+  Scope* s = back();
+  pop_back();
+  return s;
+}
+
+
+// Create an empty overload set for the symbol in the
+// current scope, and make it the symbol's innermost
+// binding. Behavior is undefined if the symbol is
+// already bound in the current scope.
+Overload&
+Scope_stack::bind(Symbol const* sym)
+{
+  Overload& ovl = top().bind(sym, {}).second;
+  shadow(sym, &ovl);
+  return ovl;
+}
+
+
+// Make ovl the innermost binding of sym, saving the
+// previous binding.
+void
+Scope_stack::shadow(Symbol const* sym, Overload* ovl)
+{
+  Identifier_sym const* id = cast<Identifier_sym>(sym);
+  if (local_) {
+    Overload*& b = binds_[id];
+    undo_.push_back({id, b});
+    b = ovl;
+  } else {
+    undo_.push_back({id, id->binding()});
+    id->binding(ovl);
+  }
+}
+
+
+// Restore a shadowed binding. In a private stack, a
+// previous binding of nullptr was made outside of the
+// stack.
+void
+Scope_stack::restore(Shadow const& x)
+{
+  if (!local_)
+    x.sym->binding(x.prev);
+  else if (x.prev)
+    binds_[x.sym] = x.prev;
+  else
+    binds_.erase(x.sym);
+}
+
+
+// Restore the bindings shadowed within the current
+// scope.
+void
+Scope_stack::unwind()
+{
+  std::size_t n = marks_.back();
+  marks_.pop_back();
+  while (undo_.size() > n) {
+    restore(undo_.back());
+    undo_.pop_back();
+  }
+}
+
+
 // Returns the innermost declaration context.
 Decl*
 Scope_stack::context() const
@@ -9,6 +9,8 @@
 #include <beaker/environment.hpp>
 #include <beaker/overload.hpp>
 
+#include <unordered_map>
+
 
 // A scope defines a maximal lexical region of a program
 // where no bindings are destroyed. A scope optionally
@@ -34,8 +36,36 @@ struct Scope : Environment<Symbol const*, Overload>
 // elaboration. It adapts the more general stack to
 // provide more language-specific names for those
 // operations.
+//
+// Unqualified lookup does not search the stack. Each
+// identifier refers directly to its innermost binding
+// (see Identifier_sym). Binding a name in the current
+// scope shadows the previous binding and records it in
+// an undo log. Leaving a scope restores the bindings
+// recorded since that scope was entered.
+//
+// Scopes are recycled when they are popped, so that
+// entering a new scope does not allocate.
+//
+// Identifiers are shared by all threads. A stack that is
+// private to a thread records its bindings in its own
+// table instead, and falls back to the binding of the
+// identifier. The identifiers' bindings must not change
+// while private stacks are in use.
 struct Scope_stack : Stack<Scope>
 {
+  Scope_stack() = default;
+  explicit Scope_stack(Scope*);
+  ~Scope_stack();
+
+  void   push(Decl* = nullptr);
+  void   push(Scope*);
+  void   pop();
+  Scope* take();
+
+  Overload& bind(Symbol const*);
+  Overload* lookup(Symbol const*) const;
+
   Scope&       current()       { return top(); }
   Scope const& current() const { return top(); }
 
@@ -46,7 +76,41 @@ struct Scope_stack : Stack<Scope>
   Module_decl*   module() const;
   Function_decl* function() const;
   Record_decl*   record() const;
+
+private:
+  // A previous binding of an identifier.
+  struct Shadow
+  {
+    Identifier_sym const* sym;
+    Overload*             prev;
+  };
+
+  void shadow(Symbol const*, Overload*);
+  void restore(Shadow const&);
+  void unwind();
+
+  std::vector<Shadow>      undo_;  // Shadowed bindings
+  std::vector<std::size_t> marks_; // Undo log size on scope entry
+  std::vector<Scope*>      free_;  // Recycled scopes
+
+  // Bindings of a private stack.
+  bool                                         local_ = false;
+  std::unordered_map<Symbol const*, Overload*> binds_;
 };
 
 
+// Returns the innermost binding of the identifier, or
+// nullptr if the identifier is not bound.
+inline Overload*
+Scope_stack::lookup(Symbol const* sym) const
+{
+  if (local_) {
+    auto iter = binds_.find(sym);
+    if (iter != binds_.end())
+      return iter->second;
+  }
+  return cast<Identifier_sym>(sym)->binding();
+}
+
+
 #endif
@@ -0,0 +1,149 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+// The compile server (beaker-serve) is a resident process
+// that handles requests from beaker-client. The server
+// initializes the compiler's global resources once, and
+// keeps the parsed form of source files in a parse cache.
+// Files that import nothing are also kept elaborated, and
+// are elaborated incrementally when they change.
+//
+// Each request is handled in a child process forked from
+// the server. The child inherits the initialized state
+// and the cache, and may modify both freely; none of its
+// changes are seen by the server or by other requests.
+//
+// Only the user that runs the server may connect to it.
+
+#include "config.hpp"
+
+#include "beaker/remote.hpp"
+#include "beaker/parse_cache.hpp"
+#include "beaker/emitter.hpp"
+#include "beaker/symbol.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+extern Symbol_table syms;
+
+extern void compiler_init();
+extern int compiler_main(int, char*[]);
+extern int interpreter_main(int, char*[]);
+
+
+namespace
+{
+
+// Refresh the cached parse (and elaboration) of each
+// source file named by a request. This is done in the
+// server so that the child handling the request inherits
+// it.
+void
+preload(Parse_cache& cache, Request const& req)
+{
+  for (std::string const& s : req.args) {
+    Path p = s;
+    if (get_file_kind(p) != beaker_file)
+      continue;
+    if (p.is_relative())
+      p = Path(req.cwd) / p;
+    cache.load(p);
+  }
+}
+
+
+// Execute the request in the child process. The
+// client's standard streams become our own.
+int
+execute(Request& req)
+{
+  if (::chdir(req.cwd.c_str()) < 0) {
+    std::cerr << "error: cannot enter directory '" << req.cwd << "'\n";
+    return -1;
+  }
+  for (int i = 0; i < 3; ++i) {
+    ::dup2(req.fds[i], i);
+    ::close(req.fds[i]);
+  }
+
+  std::vector<char*> argv;
+  for (std::string& s : req.args)
+    argv.push_back(&s[0]);
+  argv.push_back(nullptr);
+  int argc = req.args.size();
+
+  if (req.command == "compile")
+    return compiler_main(argc, argv.data());
+  if (req.command == "run")
+    return interpreter_main(argc, argv.data());
+
+  std::cerr << "error: unknown command '" << req.command << "'\n";
+  return -1;
+}
+
+} // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+  std::string path = argc > 1 ? argv[1] : default_socket();
+
+  // Initialize everything that requests would otherwise
+  // initialize for themselves, including LLVM's targets.
+  compiler_init();
+  init_native_target();
+  Parse_cache cache(syms);
+  parse_cache(&cache);
+
+  int sock = listen_socket(path);
+  if (sock < 0) {
+    std::cerr << "error: cannot listen on '" << path << "'\n";
+    return -1;
+  }
+
+  // Children are reaped automatically. They must restore
+  // the default, since jobs wait on their own children.
+  std::signal(SIGCHLD, SIG_IGN);
+
+  while (true) {
+    int conn = ::accept(sock, nullptr, nullptr);
+    if (conn < 0)
+      continue;
+    if (!same_user(conn)) {
+      ::close(conn);
+      continue;
+    }
+
+    Request req;
+    if (!receive_request(conn, req)) {
+      ::close(conn);
+      continue;
+    }
+    preload(cache, req);
+
+    pid_t pid = ::fork();
+    if (pid == 0) {
+      std::signal(SIGCHLD, SIG_DFL);
+      ::close(sock);
+      int status = execute(req);
+      std::cout.flush();
+      std::cerr.flush();
+      std::fflush(nullptr);
+      send_status(conn, status);
+      ::_exit(0);
+    }
+    if (pid < 0)
+      send_status(conn, -1);
+
+    for (int fd : req.fds)
+      ::close(fd);
+    ::close(conn);
+  }
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_SPAN_HPP
+#define BEAKER_SPAN_HPP
+
+// A span is a compact, fixed-length sequence of objects
+// whose storage is allocated in an arena. Spans are
+// used to store the operands of AST nodes. Unlike a
+// vector, a span has no capacity and never reallocates;
+// it is built from a completed sequence.
+
+#include <beaker/arena.hpp>
+
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+
+template<typename T>
+class Span
+{
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using reference       = T&;
+  using const_reference = T const&;
+  using iterator        = T*;
+  using const_iterator  = T const*;
+
+  Span();
+  Span(Arena&, T const*, T const*);
+  Span(std::initializer_list<T>);
+
+  template<typename R>
+  explicit Span(R const&);
+
+  template<typename R>
+  Span(R const&, Arena&);
+
+  bool        empty() const { return size_ == 0; }
+  std::size_t size() const  { return size_; }
+
+  T&       operator[](std::size_t n)       { return data_[n]; }
+  T const& operator[](std::size_t n) const { return data_[n]; }
+
+  T&       front()       { return data_[0]; }
+  T const& front() const { return data_[0]; }
+  T&       back()        { return data_[size_ - 1]; }
+  T const& back() const  { return data_[size_ - 1]; }
+
+  iterator       begin()       { return data_; }
+  iterator       end()         { return data_ + size_; }
+  const_iterator begin() const { return data_; }
+  const_iterator end() const   { return data_ + size_; }
+
+private:
+  void init(Arena&, T const*, T const*);
+
+  T*            data_;
+  std::uint32_t size_;
+};
+
+
+template<typename T>
+inline
+Span<T>::Span()
+  : data_(nullptr), size_(0)
+{ }
+
+
+// Copy the elements in [first, last) into the arena.
+template<typename T>
+inline
+Span<T>::Span(Arena& a, T const* first, T const* last)
+{
+  init(a, first, last);
+}
+
+
+template<typename T>
+inline
+Span<T>::Span(std::initializer_list<T> list)
+{
+  init(current_arena(), list.begin(), list.end());
+}
+
+
+// Copy the elements of the contiguous sequence r into
+// the current arena.
+template<typename T>
+template<typename R>
+inline
+Span<T>::Span(R const& r)
+{
+  init(current_arena(), r.data(), r.data() + r.size());
+}
+
+
+// Copy the elements of the contiguous sequence r into
+// the arena a.
+template<typename T>
+template<typename R>
+inline
+Span<T>::Span(R const& r, Arena& a)
+{
+  init(a, r.data(), r.data() + r.size());
+}
+
+
+template<typename T>
+inline void
+Span<T>::init(Arena& a, T const* first, T const* last)
+{
+  static_assert(std::is_trivially_destructible<T>::value,
+                "span elements must be trivially destructible");
+  std::size_t n = last - first;
+  if (n > std::numeric_limits<std::uint32_t>::max())
+    throw std::length_error("span too long");
+  size_ = n;
+  if (size_) {
+    data_ = static_cast<T*>(a.allocate(size_ * sizeof(T), alignof(T)));
+    std::uninitialized_copy(first, last, data_);
+  } else {
+    data_ = nullptr;
+  }
+}
+
+
+#endif
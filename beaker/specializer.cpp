@@ -0,0 +1,613 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/specializer.hpp"
+#include "beaker/symbol.hpp"
+#include "beaker/token.hpp"
+#include "beaker/type.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/stmt.hpp"
+#include "beaker/decl.hpp"
+#include "beaker/equal.hpp"
+#include "beaker/evaluator.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace
+{
+
+int budget_ = 256;
+
+// The maximum number of specializations of a function.
+constexpr std::size_t clone_limit = 4;
+
+
+// Apply fn to each operand of e.
+template<typename F>
+void
+each_operand(Expr* e, F fn)
+{
+  if (Unary_expr* u = as<Unary_expr>(e)) {
+    fn(u->first);
+  } else if (Binary_expr* b = as<Binary_expr>(e)) {
+    fn(b->first);
+    fn(b->second);
+  } else if (Call_expr* c = as<Call_expr>(e)) {
+    fn(c->first);
+    for (Expr*& a : c->second)
+      fn(a);
+  } else if (Dot_expr* d = as<Dot_expr>(e)) {
+    fn(d->first);
+  } else if (Index_expr* x = as<Index_expr>(e)) {
+    fn(x->first);
+    fn(x->second);
+  } else if (Conv* c = as<Conv>(e)) {
+    fn(c->first);
+  } else if (Copy_init* i = as<Copy_init>(e)) {
+    fn(i->first);
+  } else if (Reference_init* i = as<Reference_init>(e)) {
+    fn(i->first);
+  }
+}
+
+
+// Apply fn to each statement nested in s, and ex to each
+// expression, with a flag that is true for the condition
+// of an if or while statement.
+template<typename F, typename G>
+void
+each_part(Stmt* s, F fn, G ex)
+{
+  if (Block_stmt* b = as<Block_stmt>(s)) {
+    for (Stmt* s1 : b->first)
+      fn(s1);
+  } else if (Assign_stmt* a = as<Assign_stmt>(s)) {
+    ex(a->first, false);
+    ex(a->second, false);
+  } else if (Return_stmt* r = as<Return_stmt>(s)) {
+    ex(r->first, false);
+  } else if (If_then_stmt* i = as<If_then_stmt>(s)) {
+    ex(i->first, true);
+    fn(i->second);
+  } else if (If_else_stmt* i = as<If_else_stmt>(s)) {
+    ex(i->first, true);
+    fn(i->second);
+    fn(i->third);
+  } else if (While_stmt* w = as<While_stmt>(s)) {
+    ex(w->first, true);
+    fn(w->second);
+  } else if (Expression_stmt* e = as<Expression_stmt>(s)) {
+    ex(e->first, false);
+  } else if (Declaration_stmt* d = as<Declaration_stmt>(s)) {
+    if (Variable_decl* v = as<Variable_decl>(d->first))
+      ex(v->init_, false);
+  }
+}
+
+
+// Returns the index of d in the parameters of f, or -1
+// if d is not a parameter of f.
+int
+parameter_index(Function_decl const* f, Decl const* d)
+{
+  Decl_list const& ps = f->parameters();
+  auto iter = std::find(ps.begin(), ps.end(), d);
+  return iter == ps.end() ? -1 : iter - ps.begin();
+}
+
+
+// Returns true if values of type t can be folded by the
+// evaluator.
+inline bool
+is_integral(Type const* t)
+{
+  return is<Boolean_type>(t) || is<Character_type>(t) || is<Integer_type>(t);
+}
+
+
+// Returns true if e is a literal that can be substituted
+// for a parameter.
+inline bool
+is_constant(Expr const* e)
+{
+  return is<Literal_expr>(e) && is_integral(e->type());
+}
+
+
+// Describes the parameters of a function that can be
+// specialized, and the size of its definition.
+struct Profile
+{
+  Profile(Function_decl* f)
+    : fn(f), fixed(f->parameters().size()), tested(fixed.size())
+  {
+    for (std::size_t i = 0; i < fixed.size(); ++i)
+      fixed[i] = is<Reference_type>(f->parameters()[i]->type());
+  }
+
+  void stmt(Stmt*);
+  void expr(Expr*, bool);
+
+  bool can_specialize(std::size_t n) const { return !fixed[n] && tested[n]; }
+
+  Function_decl*    fn;
+  int               size = 0;
+  std::vector<bool> fixed;  // Assigned or bound to a reference
+  std::vector<bool> tested; // Used in a condition
+};
+
+
+void
+Profile::stmt(Stmt* s)
+{
+  ++size;
+  each_part(s, [this](Stmt* s1) { stmt(s1); },
+               [this](Expr* e, bool c) { expr(e, c); });
+}
+
+
+// Only the value of a specialized parameter can be
+// used. Any other use of the parameter fixes it.
+void
+Profile::expr(Expr* e, bool cond)
+{
+  ++size;
+  if (Value_conv* c = as<Value_conv>(e)) {
+    if (Decl_expr* d = as<Decl_expr>(c->source())) {
+      int n = parameter_index(fn, d->declaration());
+      if (n >= 0) {
+        if (cond)
+          tested[n] = true;
+        return;
+      }
+    }
+  }
+  if (Decl_expr* d = as<Decl_expr>(e)) {
+    int n = parameter_index(fn, d->declaration());
+    if (n >= 0)
+      fixed[n] = true;
+    return;
+  }
+  each_operand(e, [this, cond](Expr*& x) { expr(x, cond); });
+}
+
+
+// A copy of a function in which some parameters are
+// replaced by literals. The values are null for the
+// parameters that are not replaced.
+struct Specialization
+{
+  std::vector<Expr*> values;
+  Function_decl*     fn;
+};
+
+
+// Copies the definition of a function, replacing its
+// specialized parameters by their values and folding the
+// result. Declarations in the definition are copied, and
+// references to them are redirected to the copies.
+struct Cloner
+{
+  Expr* expr(Expr*);
+  Stmt* stmt(Stmt*);
+  Decl* decl(Decl*);
+  Expr* fold(Expr*);
+
+  Decl* cxt = nullptr; // The function being defined
+  std::unordered_map<Decl const*, Decl*> decls;
+  std::unordered_map<Decl const*, Expr*> values;
+};
+
+
+struct Clone_expr_fn
+{
+  Cloner& cl;
+
+  template<typename T>
+  Expr* operator()(T* e) { return copy(e); }
+
+  template<typename T>
+  T* copy(T* e)
+  {
+    T* c = make<T>(*e);
+    c->shared_ = false;
+    each_operand(c, [this](Expr*& x) { x = cl.expr(x); });
+    bind(c);
+    return c;
+  }
+
+  // Initializers refer to the declarations they
+  // initialize.
+  void bind(Expr*) { }
+
+  void bind(Init* e)
+  {
+    auto iter = cl.decls.find(e->decl_);
+    if (iter != cl.decls.end())
+      e->decl_ = iter->second;
+  }
+
+  Expr* operator()(Decl_expr* e)
+  {
+    auto iter = cl.decls.find(e->declaration());
+    if (iter != cl.decls.end())
+      return make<Decl_expr>(e->type(), iter->second);
+    return copy(e);
+  }
+
+  Expr* operator()(Value_conv* e)
+  {
+    if (Decl_expr* d = as<Decl_expr>(e->source())) {
+      auto iter = cl.values.find(d->declaration());
+      if (iter != cl.values.end())
+        return make<Literal_expr>(*cast<Literal_expr>(iter->second));
+    }
+    return copy(e);
+  }
+
+  Expr* operator()(Call_expr* e)
+  {
+    Expr* f = cl.expr(e->target());
+    Expr_seq args;
+    for (Expr* a : e->arguments())
+      args.push_back(cl.expr(a));
+    return make<Call_expr>(e->type(), f, args);
+  }
+};
+
+
+Expr*
+Cloner::expr(Expr* e)
+{
+  if (!e)
+    return nullptr;
+  return fold(dispatch(e, Clone_expr_fn{*this}));
+}
+
+
+// Returns a literal for e if its operands are integral
+// literals. Folding that would fail at run time, such as
+// division by zero, is left to run time.
+Expr*
+Cloner::fold(Expr* e)
+{
+  if (!is_integral(e->type()))
+    return e;
+  if (!is<Unary_expr>(e) && !is<Binary_expr>(e))
+    return e;
+  bool lits = true;
+  each_operand(e, [&lits](Expr*& x) { lits = lits && is_constant(x); });
+  if (!lits)
+    return e;
+  if (Expr* r = reduce(e))
+    return r;
+  return e;
+}
+
+
+// Returns the value of a constant condition: 1 if true,
+// 0 if false, and -1 if the condition is not constant.
+int
+truth(Expr const* e)
+{
+  if (Literal_expr const* l = as<Literal_expr>(e))
+    if (is<Boolean_type>(l->type()))
+      return l->value().get_integer() != 0;
+  return -1;
+}
+
+
+Stmt*
+Cloner::stmt(Stmt* s)
+{
+  struct Fn
+  {
+    Cloner& cl;
+
+    Stmt* operator()(Empty_stmt* s) { return make<Empty_stmt>(); }
+
+    Stmt* operator()(Block_stmt* s)
+    {
+      Stmt_seq ss;
+      for (Stmt* s1 : s->first)
+        ss.push_back(cl.stmt(s1));
+      return make<Block_stmt>(ss);
+    }
+
+    Stmt* operator()(Assign_stmt* s)
+    {
+      Expr* e1 = cl.expr(s->first);
+      Expr* e2 = cl.expr(s->second);
+      return make<Assign_stmt>(e1, e2);
+    }
+
+    Stmt* operator()(Return_stmt* s)
+    {
+      return make<Return_stmt>(cl.expr(s->first));
+    }
+
+    Stmt* operator()(If_then_stmt* s)
+    {
+      Expr* c = cl.expr(s->first);
+      switch (truth(c)) {
+        case 0: return make<Empty_stmt>();
+        case 1: return cl.stmt(s->second);
+      }
+      return make<If_then_stmt>(c, cl.stmt(s->second));
+    }
+
+    Stmt* operator()(If_else_stmt* s)
+    {
+      Expr* c = cl.expr(s->first);
+      switch (truth(c)) {
+        case 0: return cl.stmt(s->third);
+        case 1: return cl.stmt(s->second);
+      }
+      Stmt* s1 = cl.stmt(s->second);
+      Stmt* s2 = cl.stmt(s->third);
+      return make<If_else_stmt>(c, s1, s2);
+    }
+
+    Stmt* operator()(While_stmt* s)
+    {
+      Expr* c = cl.expr(s->first);
+      if (truth(c) == 0)
+        return make<Empty_stmt>();
+      return make<While_stmt>(c, cl.stmt(s->second));
+    }
+
+    Stmt* operator()(Break_stmt* s)    { return make<Break_stmt>(); }
+    Stmt* operator()(Continue_stmt* s) { return make<Continue_stmt>(); }
+
+    Stmt* operator()(Expression_stmt* s)
+    {
+      return make<Expression_stmt>(cl.expr(s->first));
+    }
+
+    Stmt* operator()(Declaration_stmt* s)
+    {
+      return make<Declaration_stmt>(cl.decl(s->first));
+    }
+  };
+
+  return dispatch(s, Fn{*this});
+}
+
+
+// Copy a local declaration. The copy is bound before its
+// initializer is copied, which may refer to it.
+Decl*
+Cloner::decl(Decl* d)
+{
+  if (Variable_decl* v = as<Variable_decl>(d)) {
+    Variable_decl* c = make<Variable_decl>(v->specifiers(), v->name(), v->type(), nullptr);
+    c->cxt_ = cxt;
+    decls.emplace(v, c);
+    c->init_ = expr(v->init_);
+    return c;
+  }
+  return d;
+}
+
+
+// The specializer visits the definitions of a module in
+// order, redirecting calls to functions declared earlier.
+struct Specializer
+{
+  Specializer(Module_decl* m, Symbol_table& s)
+    : mod(m), syms(s)
+  { }
+
+  void run();
+
+  void stmt(Stmt*);
+  void expr(Expr*);
+  void call(Call_expr*);
+
+  Profile const*  profile(Function_decl*);
+  Function_decl*  specialize(Function_decl*, std::vector<Expr*> const&);
+
+  Module_decl*  mod;
+  Symbol_table& syms;
+  int           used = 0;
+
+  // The position of each function in the module.
+  std::unordered_map<Decl const*, std::size_t> order;
+  std::size_t                                  current = 0;
+
+  std::unordered_map<Function_decl*, Profile>                     profiles;
+  std::unordered_map<Function_decl*, std::vector<Specialization>> cache;
+};
+
+
+void
+Specializer::run()
+{
+  Decl_list const& ds = mod->declarations();
+  for (std::size_t i = 0; i < ds.size(); ++i)
+    order.emplace(ds[i], i);
+
+  for (std::size_t i = 0; i < ds.size(); ++i) {
+    current = i;
+    if (Function_decl* f = as<Function_decl>(ds[i])) {
+      if (f->body())
+        stmt(f->body());
+    } else if (Variable_decl* v = as<Variable_decl>(ds[i])) {
+      expr(v->init_);
+    }
+  }
+
+  if (cache.empty())
+    return;
+
+  // Each specialization follows the function it copies.
+  Decl_seq ds1;
+  for (Decl* d : ds) {
+    ds1.push_back(d);
+    if (Function_decl* f = as<Function_decl>(d)) {
+      auto iter = cache.find(f);
+      if (iter != cache.end()) {
+        for (Specialization const& s : iter->second)
+          ds1.push_back(s.fn);
+      }
+    }
+  }
+  mod->decls_ = Decl_list(ds1, mod->arena());
+}
+
+
+void
+Specializer::stmt(Stmt* s)
+{
+  each_part(s, [this](Stmt* s1) { stmt(s1); },
+               [this](Expr* e, bool) { expr(e); });
+}
+
+
+void
+Specializer::expr(Expr* e)
+{
+  if (!e)
+    return;
+  each_operand(e, [this](Expr*& x) { expr(x); });
+  if (Call_expr* c = as<Call_expr>(e))
+    call(c);
+}
+
+
+// Redirect the call e to a specialization of its target,
+// if the target is a function defined earlier in the
+// module and some of its tested parameters are given
+// literal arguments.
+void
+Specializer::call(Call_expr* e)
+{
+  Decl_expr* d = as<Decl_expr>(e->target());
+  Function_decl* f = d ? as<Function_decl>(d->declaration()) : nullptr;
+  if (!f || !f->body() || f->is_polymorphic() || f->virtual_parameters())
+    return;
+  auto pos = order.find(f);
+  if (pos == order.end() || pos->second >= current)
+    return;
+
+  Profile const* p = profile(f);
+  Expr_list const& args = e->arguments();
+  if (args.size() != f->parameters().size())
+    return;
+  std::vector<Expr*> values(args.size());
+  bool any = false;
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (p->can_specialize(i) && is_constant(args[i])) {
+      values[i] = args[i];
+      any = true;
+    }
+  }
+  if (!any)
+    return;
+
+  Function_decl* s = specialize(f, values);
+  if (!s)
+    return;
+
+  Expr_seq rest;
+  for (std::size_t i = 0; i < args.size(); ++i)
+    if (!values[i])
+      rest.push_back(args[i]);
+  e->first = make<Decl_expr>(s->type(), s);
+  e->second = Expr_list(rest);
+}
+
+
+Profile const*
+Specializer::profile(Function_decl* f)
+{
+  auto iter = profiles.find(f);
+  if (iter == profiles.end()) {
+    iter = profiles.emplace(f, Profile(f)).first;
+    iter->second.stmt(f->body());
+  }
+  return &iter->second;
+}
+
+
+// Returns the specialization of f for the given values,
+// creating it if the budget allows. Returns nullptr if
+// the specialization cannot be created.
+Function_decl*
+Specializer::specialize(Function_decl* f, std::vector<Expr*> const& values)
+{
+  std::vector<Specialization>& ss = cache[f];
+  for (Specialization const& s : ss) {
+    bool same = true;
+    for (std::size_t i = 0; same && i < values.size(); ++i) {
+      Expr* a = values[i];
+      Expr* b = s.values[i];
+      same = (!a && !b) || (a && b && is_equal(a, b));
+    }
+    if (same)
+      return s.fn;
+  }
+
+  int n = profile(f)->size;
+  if (ss.size() >= clone_limit || used + n > budget_) {
+    if (ss.empty())
+      cache.erase(f);
+    return nullptr;
+  }
+  used += n;
+
+  Cloner cl;
+  Decl_list const& ps = f->parameters();
+  Decl_seq parms;
+  for (std::size_t i = 0; i < ps.size(); ++i) {
+    if (values[i]) {
+      cl.values.emplace(ps[i], values[i]);
+    } else {
+      Decl* p = make<Parameter_decl>(ps[i]->specifiers(), ps[i]->name(), ps[i]->type());
+      cl.decls.emplace(ps[i], p);
+      parms.push_back(p);
+    }
+  }
+
+  String name = f->name()->spelling() + '.' + std::to_string(ss.size() + 1);
+  Symbol const* sym = syms.put<Identifier_sym>(name, identifier_tok);
+  Type const* t = get_function_type(parms, f->return_type());
+  Function_decl* s = make<Function_decl>(sym, t, parms, nullptr);
+  s->cxt_ = f->cxt_;
+  for (Decl* p : parms)
+    p->cxt_ = s;
+  cl.cxt = s;
+  s->body_ = cl.stmt(f->body());
+
+  ss.push_back({values, s});
+  return s;
+}
+
+} // namespace
+
+
+// Specialize functions called with constant arguments in
+// the module m. Specialization names are added to syms.
+// New nodes are allocated in the current arena.
+void
+specialize_calls(Module_decl* m, Symbol_table& syms)
+{
+  if (budget_ <= 0)
+    return;
+  Specializer spec(m, syms);
+  spec.run();
+}
+
+
+// Set the maximum total size of all specializations, in
+// expressions and statements. A budget of 0 disables
+// specialization.
+void
+specialization_budget(int n)
+{
+  budget_ = n;
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_SPECIALIZER_HPP
+#define BEAKER_SPECIALIZER_HPP
+
+// Specialization of functions on constant arguments.
+//
+// When a function is called with literal arguments for
+// parameters that it tests in the condition of an if or
+// while statement, the call is redirected to a copy of the
+// function in which those parameters are replaced by their
+// values. Constant subexpressions and branches of the copy
+// are folded.
+//
+// Each specialization is created once for each distinct
+// combination of constant arguments, and is shared by all
+// calls with those arguments. Specializations are added to
+// the module after the function they copy, so that both the
+// evaluator and the generator see them as ordinary
+// definitions.
+//
+// A parameter is specialized only if it is never assigned
+// or bound to a reference. The total size of all copies is
+// limited by a budget.
+
+#include <beaker/prelude.hpp>
+
+
+void specialize_calls(Module_decl*, Symbol_table&);
+void specialization_budget(int);
+
+
+#endif
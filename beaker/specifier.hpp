@@ -44,6 +44,11 @@ enum Specifier
   // TODO: Support foreign language linkage for other
   // other languages?
   foreign_spec = 1 << 10,
+
+  // The declaration was imported from a module interface.
+  // It is fully elaborated, and its definition is provided
+  // by another translation unit.
+  imported_spec = 1 << 11,
 };
 
 
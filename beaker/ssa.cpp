@@ -0,0 +1,747 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/ssa.hpp"
+#include "beaker/type.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/stmt.hpp"
+#include "beaker/decl.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+
+// -------------------------------------------------------------------------- //
+// Operations
+
+// Returns the integer n truncated to the precision of the
+// type t, and extended according to its sign. Values of
+// other types are unchanged.
+Integer_value
+wrap(Type const* t, Integer_value n)
+{
+  Integer_type const* i = as<Integer_type>(t);
+  if (!i || i->precision() >= 64)
+    return n;
+  std::uint64_t m = (std::uint64_t(1) << i->precision()) - 1;
+  std::uint64_t u = std::uint64_t(n) & m;
+  if (i->is_signed() && (u >> (i->precision() - 1)))
+    u |= ~m;
+  return Integer_value(u);
+}
+
+
+// Returns true if n is the minimum value of the type t,
+// which must be a signed integer type.
+bool
+is_minimum(Type const* t, Integer_value n)
+{
+  Integer_type const* i = as<Integer_type>(t);
+  if (!i || !i->is_signed())
+    return false;
+  int p = std::min(i->precision(), 64);
+  return n == Integer_value(~std::uint64_t(0) << (p - 1));
+}
+
+
+namespace
+{
+
+inline bool
+is_unsigned(Type const* t)
+{
+  Integer_type const* i = as<Integer_type>(t);
+  return i && !i->is_signed();
+}
+
+} // namespace
+
+
+// Apply the binary operation op to operands of type t.
+// This has the semantics of the corresponding instruction
+// in the generated code: arithmetic wraps to the precision
+// of t. A division that would trap throws.
+//
+// Arithmetic is done on unsigned values, so that it does
+// not overflow in the host.
+Value
+apply(Ssa_op op, Type const* t, Value const& a, Value const& b)
+{
+  if (op == eq_op || op == ne_op) {
+    if (a.is_function() && b.is_function())
+      return (a.get_function() == b.get_function()) == (op == eq_op);
+    return (a.get_integer() == b.get_integer()) == (op == eq_op);
+  }
+
+  Integer_value x = a.get_integer();
+  Integer_value y = b.get_integer();
+  std::uint64_t ux = x;
+  std::uint64_t uy = y;
+  bool u = is_unsigned(t);
+  switch (op) {
+    case add_op: return wrap(t, Integer_value(ux + uy));
+    case sub_op: return wrap(t, Integer_value(ux - uy));
+    case mul_op: return wrap(t, Integer_value(ux * uy));
+    case div_op:
+    case rem_op:
+      if (y == 0)
+        throw std::runtime_error("division by 0");
+      if (u) {
+        if (op == div_op)
+          return wrap(t, Integer_value(ux / uy));
+        return wrap(t, Integer_value(ux % uy));
+      }
+      if (y == -1 && is_minimum(t, x))
+        throw std::runtime_error("division overflow");
+      if (op == div_op)
+        return wrap(t, x / y);
+      return wrap(t, x % y);
+    case lt_op: return u ? ux < uy : x < y;
+    case gt_op: return u ? ux > uy : x > y;
+    case le_op: return u ? ux <= uy : x <= y;
+    case ge_op: return u ? ux >= uy : x >= y;
+    default:
+      lingo_unreachable();
+  }
+}
+
+
+// Apply the unary operation op to an operand of type t.
+Value
+apply(Ssa_op op, Type const* t, Value const& a)
+{
+  switch (op) {
+    case neg_op: return wrap(t, Integer_value(-std::uint64_t(a.get_integer())));
+    case not_op: return !a.get_integer();
+    default:
+      lingo_unreachable();
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Lowering
+
+namespace
+{
+
+// Returns true if values of type t are represented in
+// SSA form.
+bool
+is_ssa_type(Type const* t)
+{
+  return is<Boolean_type>(t)
+      || is<Character_type>(t)
+      || is<Integer_type>(t)
+      || is<Function_type>(t);
+}
+
+
+// Thrown when a function cannot be lowered.
+struct Not_lowered { };
+
+
+// Lowers the definition of a function.
+//
+// Variables are renamed as the definition is lowered, using
+// the method of Braun et al. A block is sealed when all of
+// its predecessors are known. A variable read in a block
+// that is not yet sealed gets an incomplete phi node, whose
+// operands are added when the block is sealed.
+struct Lowering
+{
+  Lowering(Function_decl*);
+
+  Ssa_block* block();
+  Ssa_inst*  emit(Ssa_op, Type const*);
+  Ssa_inst*  constant(Type const*, Value const&);
+  Ssa_inst*  zero(Type const*);
+  void       jump(Ssa_block*);
+  void       branch(Ssa_inst*, Ssa_block*, Ssa_block*);
+  void       enter(Ssa_block*);
+  void       stop();
+  void       seal(Ssa_block*);
+
+  void       write(Decl const*, Ssa_block*, Ssa_inst*);
+  Ssa_inst*  read(Decl const*, Ssa_block*);
+  Ssa_inst*  phi(Decl const*, Ssa_block*);
+  void       fill(Decl const*, Ssa_inst*);
+
+  Ssa_inst*  expr(Expr const*);
+  Ssa_inst*  binary(Ssa_op, Binary_expr const*);
+  Ssa_inst*  logical(Binary_expr const*, bool);
+  Ssa_inst*  call(Call_expr const*);
+  void       stmt(Stmt const*);
+  void       decl(Decl const*);
+
+  Ssa_function* run();
+
+  using Def_map = std::unordered_map<Decl const*, Ssa_inst*>;
+  using Phi_seq = std::vector<std::pair<Decl const*, Ssa_inst*>>;
+
+  Function_decl*                             fn;
+  Ssa_function*                              ssa;
+  Ssa_block*                                 cur;
+  std::vector<Ssa_inst*>                     consts;
+  std::unordered_set<Decl const*>            vars;
+  std::unordered_map<Ssa_block*, Def_map>    defs;
+  std::unordered_set<Ssa_block*>             sealed;
+  std::unordered_map<Ssa_block*, Phi_seq>    incomplete;
+  std::vector<std::pair<Ssa_block*, Ssa_block*>> loops; // Continue and break targets
+};
+
+
+Lowering::Lowering(Function_decl* f)
+  : fn(f), ssa(make<Ssa_function>()), cur(nullptr)
+{
+  ssa->decl = f;
+}
+
+
+// Create a new block.
+Ssa_block*
+Lowering::block()
+{
+  Ssa_block* b = make<Ssa_block>();
+  ssa->blocks.push_back(b);
+  return b;
+}
+
+
+// Append a new instruction to the current block.
+Ssa_inst*
+Lowering::emit(Ssa_op op, Type const* t)
+{
+  Ssa_inst* i = make<Ssa_inst>(op, t);
+  i->block = cur;
+  cur->insts.push_back(i);
+  return i;
+}
+
+
+// Constants are placed in the entry block when lowering
+// is complete.
+Ssa_inst*
+Lowering::constant(Type const* t, Value const& v)
+{
+  Ssa_inst* i = make<Ssa_inst>(const_op, t);
+  i->value = v;
+  consts.push_back(i);
+  return i;
+}
+
+
+// The value of a default-initialized object of type t.
+Ssa_inst*
+Lowering::zero(Type const* t)
+{
+  if (is<Function_type>(t))
+    throw Not_lowered();
+  return constant(t, 0);
+}
+
+
+void
+Lowering::jump(Ssa_block* b)
+{
+  Ssa_inst* i = emit(br_op, nullptr);
+  i->blocks.push_back(b);
+  b->preds.push_back(cur);
+}
+
+
+void
+Lowering::branch(Ssa_inst* c, Ssa_block* t, Ssa_block* f)
+{
+  Ssa_inst* i = emit(cond_br_op, nullptr);
+  i->ops.push_back(c);
+  i->blocks.push_back(t);
+  i->blocks.push_back(f);
+  t->preds.push_back(cur);
+  f->preds.push_back(cur);
+}
+
+
+void
+Lowering::enter(Ssa_block* b)
+{
+  cur = b;
+}
+
+
+// Continue in a new block that has no predecessors. This
+// follows a return, break, or continue.
+void
+Lowering::stop()
+{
+  enter(block());
+  seal(cur);
+}
+
+
+// Seal b, completing the phi nodes of variables read
+// before its predecessors were known.
+void
+Lowering::seal(Ssa_block* b)
+{
+  auto iter = incomplete.find(b);
+  if (iter != incomplete.end()) {
+    for (auto const& p : iter->second)
+      fill(p.first, p.second);
+    incomplete.erase(iter);
+  }
+  sealed.insert(b);
+}
+
+
+void
+Lowering::write(Decl const* d, Ssa_block* b, Ssa_inst* v)
+{
+  defs[b][d] = v;
+}
+
+
+// Returns the value of d at the end of b.
+Ssa_inst*
+Lowering::read(Decl const* d, Ssa_block* b)
+{
+  Def_map& m = defs[b];
+  auto iter = m.find(d);
+  if (iter != m.end())
+    return iter->second;
+
+  Ssa_inst* v;
+  if (!sealed.count(b)) {
+    v = phi(d, b);
+    incomplete[b].emplace_back(d, v);
+  } else if (b->preds.empty()) {
+    // Only unreachable blocks have no predecessors.
+    v = constant(d->type(), Value());
+  } else if (b->preds.size() == 1) {
+    v = read(d, b->preds.front());
+  } else {
+    // The phi is defined before its operands are read
+    // to terminate the search along loops.
+    v = phi(d, b);
+    write(d, b, v);
+    fill(d, v);
+  }
+  write(d, b, v);
+  return v;
+}
+
+
+// Create a phi node at the start of b.
+Ssa_inst*
+Lowering::phi(Decl const* d, Ssa_block* b)
+{
+  Ssa_inst* i = make<Ssa_inst>(phi_op, d->type());
+  i->block = b;
+  b->insts.insert(b->insts.begin(), i);
+  return i;
+}
+
+
+// Add an operand to the phi node p for each predecessor of
+// its block.
+void
+Lowering::fill(Decl const* d, Ssa_inst* p)
+{
+  p->blocks = p->block->preds;
+  for (Ssa_block* b : p->blocks)
+    p->ops.push_back(read(d, b));
+}
+
+
+Ssa_inst*
+Lowering::expr(Expr const* e)
+{
+  if (Literal_expr const* l = as<Literal_expr>(e)) {
+    if (!is_ssa_type(l->type()) || is<Function_type>(l->type()))
+      throw Not_lowered();
+    return constant(l->type(), l->value());
+  }
+
+  // Only functions are referred to directly. Variables
+  // are only read or assigned.
+  if (Decl_expr const* d = as<Decl_expr>(e)) {
+    Function_decl const* f = as<Function_decl>(d->declaration());
+    if (!f || f->is_polymorphic())
+      throw Not_lowered();
+    return constant(f->type(), f);
+  }
+
+  if (Value_conv const* c = as<Value_conv>(e)) {
+    Decl_expr const* d = as<Decl_expr>(c->source());
+    if (!d || !vars.count(d->declaration()))
+      throw Not_lowered();
+    return read(d->declaration(), cur);
+  }
+
+  switch (e->kind()) {
+    case add_expr: return binary(add_op, cast<Binary_expr>(e));
+    case sub_expr: return binary(sub_op, cast<Binary_expr>(e));
+    case mul_expr: return binary(mul_op, cast<Binary_expr>(e));
+    case div_expr: return binary(div_op, cast<Binary_expr>(e));
+    case rem_expr: return binary(rem_op, cast<Binary_expr>(e));
+    case eq_expr: return binary(eq_op, cast<Binary_expr>(e));
+    case ne_expr: return binary(ne_op, cast<Binary_expr>(e));
+    case lt_expr: return binary(lt_op, cast<Binary_expr>(e));
+    case gt_expr: return binary(gt_op, cast<Binary_expr>(e));
+    case le_expr: return binary(le_op, cast<Binary_expr>(e));
+    case ge_expr: return binary(ge_op, cast<Binary_expr>(e));
+    case and_expr: return logical(cast<Binary_expr>(e), true);
+    case or_expr: return logical(cast<Binary_expr>(e), false);
+    case pos_expr: return expr(cast<Unary_expr>(e)->operand());
+    case neg_expr:
+    case not_expr: {
+      Ssa_inst* v = expr(cast<Unary_expr>(e)->operand());
+      Ssa_inst* i = emit(e->kind() == neg_expr ? neg_op : not_op, e->type());
+      i->ops.push_back(v);
+      return i;
+    }
+    case call_expr: return call(cast<Call_expr>(e));
+    default:
+      throw Not_lowered();
+  }
+}
+
+
+Ssa_inst*
+Lowering::binary(Ssa_op op, Binary_expr const* e)
+{
+  Ssa_inst* l = expr(e->left());
+  Ssa_inst* r = expr(e->right());
+  Ssa_inst* i = emit(op, e->type());
+  i->ops.push_back(l);
+  i->ops.push_back(r);
+  return i;
+}
+
+
+// The right operand of a logical operator is evaluated
+// only if the left does not determine the result.
+Ssa_inst*
+Lowering::logical(Binary_expr const* e, bool conj)
+{
+  Ssa_inst* l = expr(e->left());
+  Ssa_block* rhs = block();
+  Ssa_block* join = block();
+  if (conj)
+    branch(l, rhs, join);
+  else
+    branch(l, join, rhs);
+  seal(rhs);
+  enter(rhs);
+  Ssa_inst* r = expr(e->right());
+  jump(join);
+  seal(join);
+  enter(join);
+
+  Ssa_inst* p = make<Ssa_inst>(phi_op, e->type());
+  p->block = join;
+  p->blocks = join->preds;
+  p->ops.push_back(constant(e->type(), !conj));
+  p->ops.push_back(r);
+  join->insts.push_back(p);
+  return p;
+}
+
+
+// Arguments are passed by value. A virtual call takes its
+// object by reference, so it is never lowered.
+Ssa_inst*
+Lowering::call(Call_expr const* e)
+{
+  if (!is_ssa_type(e->type()))
+    throw Not_lowered();
+  Function_type const* t = cast<Function_type>(e->target()->type()->nonref());
+  for (Type const* p : t->parameter_types())
+    if (!is_ssa_type(p))
+      throw Not_lowered();
+
+  Ssa_inst* f = expr(e->target());
+  std::vector<Ssa_inst*> args {f};
+  for (Expr const* a : e->arguments())
+    args.push_back(expr(a));
+  Ssa_inst* i = emit(call_op, e->type());
+  i->ops = std::move(args);
+  return i;
+}
+
+
+void
+Lowering::stmt(Stmt const* s)
+{
+  struct Fn
+  {
+    Lowering& l;
+
+    void operator()(Empty_stmt const* s) { }
+
+    void operator()(Block_stmt const* s)
+    {
+      for (Stmt const* s1 : s->statements())
+        l.stmt(s1);
+    }
+
+    void operator()(Assign_stmt const* s)
+    {
+      Decl_expr const* d = as<Decl_expr>(s->object());
+      if (!d || !l.vars.count(d->declaration()))
+        throw Not_lowered();
+      Ssa_inst* v = l.expr(s->value());
+      l.write(d->declaration(), l.cur, v);
+    }
+
+    void operator()(Return_stmt const* s)
+    {
+      Ssa_inst* v = l.expr(s->value());
+      Ssa_inst* i = l.emit(ret_op, nullptr);
+      i->ops.push_back(v);
+      l.stop();
+    }
+
+    void operator()(If_then_stmt const* s)
+    {
+      Ssa_inst* c = l.expr(s->condition());
+      Ssa_block* then = l.block();
+      Ssa_block* join = l.block();
+      l.branch(c, then, join);
+      l.seal(then);
+      l.enter(then);
+      l.stmt(s->body());
+      l.jump(join);
+      l.seal(join);
+      l.enter(join);
+    }
+
+    void operator()(If_else_stmt const* s)
+    {
+      Ssa_inst* c = l.expr(s->condition());
+      Ssa_block* then = l.block();
+      Ssa_block* other = l.block();
+      Ssa_block* join = l.block();
+      l.branch(c, then, other);
+      l.seal(then);
+      l.seal(other);
+      l.enter(then);
+      l.stmt(s->true_branch());
+      l.jump(join);
+      l.enter(other);
+      l.stmt(s->false_branch());
+      l.jump(join);
+      l.seal(join);
+      l.enter(join);
+    }
+
+    // The header of a loop is sealed after its body,
+    // which contains the back edges.
+    void operator()(While_stmt const* s)
+    {
+      Ssa_block* head = l.block();
+      l.jump(head);
+      l.enter(head);
+      Ssa_inst* c = l.expr(s->condition());
+      Ssa_block* body = l.block();
+      Ssa_block* exit = l.block();
+      l.branch(c, body, exit);
+      l.seal(body);
+      l.enter(body);
+      l.loops.emplace_back(head, exit);
+      l.stmt(s->body());
+      l.loops.pop_back();
+      l.jump(head);
+      l.seal(head);
+      l.seal(exit);
+      l.enter(exit);
+    }
+
+    void operator()(Break_stmt const* s)
+    {
+      l.jump(l.loops.back().second);
+      l.stop();
+    }
+
+    void operator()(Continue_stmt const* s)
+    {
+      l.jump(l.loops.back().first);
+      l.stop();
+    }
+
+    void operator()(Expression_stmt const* s)
+    {
+      l.expr(s->expression());
+    }
+
+    void operator()(Declaration_stmt const* s)
+    {
+      l.decl(s->declaration());
+    }
+  };
+
+  dispatch(s, Fn{*this});
+}
+
+
+// Only scalar variables with value initializers are
+// lowered.
+void
+Lowering::decl(Decl const* d)
+{
+  Variable_decl const* v = as<Variable_decl>(d);
+  if (!v || !is_ssa_type(v->type()))
+    throw Not_lowered();
+
+  Ssa_inst* x;
+  Expr const* e = v->init();
+  if (is<Default_init>(e) || is<Trivial_init>(e))
+    x = zero(v->type());
+  else if (Copy_init const* i = as<Copy_init>(e))
+    x = expr(i->value());
+  else
+    throw Not_lowered();
+  vars.insert(v);
+  write(v, cur, x);
+}
+
+
+Ssa_function*
+Lowering::run()
+{
+  if (!is_ssa_type(fn->return_type()) || fn->virtual_parameters())
+    throw Not_lowered();
+
+  Ssa_block* entry = block();
+  enter(entry);
+  seal(entry);
+  for (std::size_t n = 0; n < fn->parameters().size(); ++n) {
+    Decl const* p = fn->parameters()[n];
+    if (!is_ssa_type(p->type()))
+      throw Not_lowered();
+    Ssa_inst* a = make<Ssa_inst>(arg_op, p->type());
+    a->arg = n;
+    a->block = entry;
+    ssa->args.push_back(a);
+    vars.insert(p);
+    write(p, entry, a);
+  }
+
+  stmt(fn->body());
+  emit(unreachable_op, nullptr);
+
+  // Arguments and constants precede all other instructions
+  // of the entry block.
+  std::vector<Ssa_inst*> is = ssa->args;
+  for (Ssa_inst* c : consts) {
+    c->block = entry;
+    is.push_back(c);
+  }
+  entry->insts.insert(entry->insts.begin(), is.begin(), is.end());
+
+  renumber(*ssa);
+  return ssa;
+}
+
+} // namespace
+
+
+// Returns the SSA form of f, or nullptr if f cannot be
+// lowered.
+Ssa_function*
+lower_function(Function_decl* f)
+{
+  try {
+    Lowering l(f);
+    return l.run();
+  } catch (Not_lowered&) {
+    return nullptr;
+  }
+}
+
+
+// Lower and optimize the functions of m.
+void
+lower_module(Module_decl* m)
+{
+  for (Decl* d : m->declarations()) {
+    Function_decl* f = as<Function_decl>(d);
+    if (!f || !f->body() || is<Method_decl>(f))
+      continue;
+    if (Ssa_function* s = lower_function(f)) {
+      optimize(*s);
+      f->ssa_ = s;
+    }
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Control flow
+
+// Remove one edge from a to b. The corresponding operands
+// of phi nodes in b are removed.
+void
+remove_edge(Ssa_block* a, Ssa_block* b)
+{
+  auto iter = std::find(b->preds.begin(), b->preds.end(), a);
+  std::size_t n = iter - b->preds.begin();
+  b->preds.erase(iter);
+  for (Ssa_inst* i : b->insts) {
+    if (i->op != phi_op)
+      break;
+    i->ops.erase(i->ops.begin() + n);
+    i->blocks.erase(i->blocks.begin() + n);
+  }
+}
+
+
+// Put the blocks of f in reverse postorder and number its
+// blocks and instructions. Blocks that are not reachable
+// from the entry are removed.
+void
+renumber(Ssa_function& f)
+{
+  std::vector<Ssa_block*> post;
+  std::unordered_set<Ssa_block*> seen;
+  std::vector<std::pair<Ssa_block*, std::size_t>> work {{f.entry(), 0}};
+  seen.insert(f.entry());
+  while (!work.empty()) {
+    Ssa_block* b = work.back().first;
+    std::size_t& n = work.back().second;
+    std::vector<Ssa_block*> const& ss = b->successors();
+    if (n < ss.size()) {
+      Ssa_block* s = ss[n++];
+      if (seen.insert(s).second)
+        work.emplace_back(s, 0);
+    } else {
+      post.push_back(b);
+      work.pop_back();
+    }
+  }
+
+  for (Ssa_block* b : f.blocks) {
+    if (!seen.count(b)) {
+      for (Ssa_block* s : b->successors())
+        if (seen.count(s))
+          remove_edge(b, s);
+    }
+  }
+
+  f.blocks.assign(post.rbegin(), post.rend());
+  int n = 0;
+  for (std::size_t i = 0; i < f.blocks.size(); ++i) {
+    Ssa_block* b = f.blocks[i];
+    b->id = i;
+    for (Ssa_inst* x : b->insts) {
+      x->block = b;
+      x->id = n++;
+    }
+  }
+  f.size = n;
+}
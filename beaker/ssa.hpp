@@ -0,0 +1,161 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#ifndef BEAKER_SSA_HPP
+#define BEAKER_SSA_HPP
+
+// The SSA representation of function definitions.
+//
+// A function in SSA form is a control flow graph of basic
+// blocks. Each block is a sequence of instructions: its phi
+// nodes, then ordinary instructions, then a terminator. Each
+// instruction computes at most one value, which is named by
+// the instruction itself. Constants and arguments are
+// instructions in the entry block.
+//
+// Only scalar computations are represented. A function is
+// lowered if its parameters, locals, and result are values
+// of boolean, character, integer, or function type, and if
+// it does not take the address of any of them. Variables
+// are renamed to SSA values during lowering. Other functions
+// are evaluated and generated from their syntax trees.
+//
+// The evaluator and the generator prefer the SSA form of a
+// function when it exists.
+
+#include <beaker/prelude.hpp>
+#include <beaker/value.hpp>
+
+#include <vector>
+
+
+struct Ssa_block;
+
+
+// The operation of an instruction.
+enum Ssa_op
+{
+  const_op,       // A constant value
+  arg_op,         // The nth argument
+  phi_op,         // Selects a value by predecessor
+  add_op,
+  sub_op,
+  mul_op,
+  div_op,
+  rem_op,
+  neg_op,
+  not_op,
+  eq_op,
+  ne_op,
+  lt_op,
+  gt_op,
+  le_op,
+  ge_op,
+  call_op,        // Calls ops[0] with ops[1..n]
+  br_op,          // Jumps to blocks[0]
+  cond_br_op,     // Jumps to blocks[0] if ops[0], else blocks[1]
+  ret_op,         // Returns ops[0]
+  unreachable_op, // Control does not reach the end of a function
+};
+
+
+// An instruction.
+//
+// The operands of a phi node correspond to the predecessors
+// of its block, which are given in blocks. The targets of a
+// branch are also given in blocks.
+struct Ssa_inst
+{
+  Ssa_inst(Ssa_op o, Type const* t)
+    : op(o), type(t)
+  { }
+
+  bool is_terminator() const { return op >= br_op; }
+  bool is_constant() const   { return op == const_op; }
+
+  Function_decl const* callee() const;
+
+  Ssa_op                  op;
+  Type const*             type;   // The type of the value, if any
+  std::vector<Ssa_inst*>  ops;    // Operands
+  std::vector<Ssa_block*> blocks; // Incoming blocks or targets
+  Value                   value;  // The value of a constant
+  int                     arg = -1; // The index of an argument
+  int                     id = -1;  // The position in its function
+  Ssa_block*              block = nullptr;
+};
+
+
+// A basic block.
+struct Ssa_block
+{
+  Ssa_inst*                      terminator() const;
+  std::vector<Ssa_block*> const& successors() const;
+
+  std::vector<Ssa_inst*>  insts;
+  std::vector<Ssa_block*> preds;
+  int                     id = -1;
+};
+
+
+// A function in SSA form. The first block is the entry.
+// Blocks are kept in reverse postorder, so that every
+// block follows its immediate dominator.
+struct Ssa_function
+{
+  Ssa_block* entry() const { return blocks.front(); }
+
+  Function_decl const*    decl;
+  std::vector<Ssa_block*> blocks;
+  std::vector<Ssa_inst*>  args;
+  int                     size = 0; // The number of instructions
+};
+
+
+// Returns the function called by a call instruction, if
+// the target is a constant.
+inline Function_decl const*
+Ssa_inst::callee() const
+{
+  if (ops[0]->is_constant())
+    return ops[0]->value.get_function();
+  return nullptr;
+}
+
+
+inline Ssa_inst*
+Ssa_block::terminator() const
+{
+  return insts.empty() || !insts.back()->is_terminator() ? nullptr : insts.back();
+}
+
+
+// The successors of a block are the targets of its
+// terminator.
+inline std::vector<Ssa_block*> const&
+Ssa_block::successors() const
+{
+  return insts.back()->blocks;
+}
+
+
+Integer_value wrap(Type const*, Integer_value);
+bool          is_minimum(Type const*, Integer_value);
+
+Value apply(Ssa_op, Type const*, Value const&, Value const&);
+Value apply(Ssa_op, Type const*, Value const&);
+
+Ssa_function* lower_function(Function_decl*);
+void          lower_module(Module_decl*);
+
+void          renumber(Ssa_function&);
+void          remove_edge(Ssa_block*, Ssa_block*);
+
+void          devirtualize(Ssa_function&);
+void          number_values(Ssa_function&);
+void          hoist_invariants(Ssa_function&);
+void          eliminate_dead_code(Ssa_function&);
+void          optimize(Ssa_function&);
+
+
+#endif
@@ -0,0 +1,582 @@
+// Copyright (c) 2015 Andrew Sutton
+// All rights reserved
+
+#include "config.hpp"
+
+#include "beaker/ssa.hpp"
+#include "beaker/type.hpp"
+#include "beaker/decl.hpp"
+#include "beaker/effects.hpp"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+
+namespace
+{
+
+using Inst_map = std::unordered_map<Ssa_inst*, Ssa_inst*>;
+
+
+// Returns the instruction that replaces i.
+Ssa_inst*
+resolve(Inst_map const& m, Ssa_inst* i)
+{
+  auto iter = m.find(i);
+  while (iter != m.end()) {
+    i = iter->second;
+    iter = m.find(i);
+  }
+  return i;
+}
+
+
+// Replace the operands of each instruction in f.
+void
+replace_uses(Ssa_function& f, Inst_map const& m)
+{
+  if (m.empty())
+    return;
+  for (Ssa_block* b : f.blocks)
+    for (Ssa_inst* i : b->insts)
+      for (Ssa_inst*& x : i->ops)
+        x = resolve(m, x);
+}
+
+
+// Returns the value of the phi node p if all of its
+// operands, other than p itself, are the same value.
+// Otherwise, returns nullptr.
+Ssa_inst*
+trivial_value(Ssa_inst* p, Inst_map const& m)
+{
+  Ssa_inst* v = nullptr;
+  for (Ssa_inst* x : p->ops) {
+    x = resolve(m, x);
+    if (x == p || x == v)
+      continue;
+    if (v)
+      return nullptr;
+    v = x;
+  }
+  return v;
+}
+
+
+// Remove phi nodes that select a single value.
+void
+remove_trivial_phis(Ssa_function& f)
+{
+  Inst_map m;
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (Ssa_block* b : f.blocks) {
+      for (Ssa_inst* i : b->insts) {
+        if (i->op != phi_op)
+          break;
+        if (m.count(i))
+          continue;
+        if (Ssa_inst* v = trivial_value(i, m)) {
+          m.emplace(i, v);
+          changed = true;
+        }
+      }
+    }
+  }
+  if (m.empty())
+    return;
+  for (Ssa_block* b : f.blocks) {
+    auto last = std::remove_if(b->insts.begin(), b->insts.end(), [&m](Ssa_inst* i) {
+      return m.count(i) != 0;
+    });
+    b->insts.erase(last, b->insts.end());
+  }
+  replace_uses(f, m);
+}
+
+
+// Returns true if i cannot trap: its divisor is a constant
+// other than 0, and other than -1 unless its dividend is a
+// constant other than the minimum of its type.
+inline bool
+is_safe_division(Ssa_inst const* i)
+{
+  Ssa_inst const* n = i->ops[0];
+  Ssa_inst const* d = i->ops[1];
+  if (!d->is_constant() || d->value.get_integer() == 0)
+    return false;
+  if (d->value.get_integer() != -1)
+    return true;
+  return n->is_constant()
+      && n->value.is_integer()
+      && !is_minimum(n->type, n->value.get_integer());
+}
+
+
+// Returns true if i computes a value without effects. Such
+// instructions can be removed when unused and can be moved
+// to any point dominated by their operands.
+bool
+is_pure(Ssa_inst const* i)
+{
+  switch (i->op) {
+    case const_op:
+    case add_op:
+    case sub_op:
+    case mul_op:
+    case neg_op:
+    case not_op:
+    case eq_op:
+    case ne_op:
+    case lt_op:
+    case gt_op:
+    case le_op:
+    case ge_op:
+      return true;
+    case div_op:
+    case rem_op:
+      return is_safe_division(i);
+    default:
+      return false;
+  }
+}
+
+
+// Returns true if i must be kept even if its value is not
+// used.
+bool
+is_needed(Ssa_inst const* i)
+{
+  switch (i->op) {
+    case arg_op:
+      return true;
+    case div_op:
+    case rem_op:
+      return !is_safe_division(i);
+    case call_op: {
+      Function_decl const* f = i->callee();
+      if (!f)
+        return true;
+      Effects const& e = get_effects(f);
+      return e.writes || e.unwinds || !e.returns;
+    }
+    default:
+      return i->is_terminator();
+  }
+}
+
+
+// Returns the immediate dominator of each block in f,
+// indexed by block number. The entry is its own
+// dominator. The blocks of f must be numbered.
+std::vector<Ssa_block*>
+dominators(Ssa_function const& f)
+{
+  std::vector<Ssa_block*> idom(f.blocks.size());
+  idom[0] = f.entry();
+  auto intersect = [&idom](Ssa_block* a, Ssa_block* b) {
+    while (a != b) {
+      while (a->id > b->id)
+        a = idom[a->id];
+      while (b->id > a->id)
+        b = idom[b->id];
+    }
+    return a;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (std::size_t n = 1; n < f.blocks.size(); ++n) {
+      Ssa_block* b = f.blocks[n];
+      Ssa_block* d = nullptr;
+      for (Ssa_block* p : b->preds) {
+        if (!idom[p->id])
+          continue;
+        d = d ? intersect(p, d) : p;
+      }
+      if (idom[n] != d) {
+        idom[n] = d;
+        changed = true;
+      }
+    }
+  }
+  return idom;
+}
+
+
+// Returns true if a dominates b.
+bool
+dominates(std::vector<Ssa_block*> const& idom, Ssa_block const* a, Ssa_block const* b)
+{
+  while (b != a && b->id != 0)
+    b = idom[b->id];
+  return a == b;
+}
+
+
+// The value number of a pure instruction. Constants are
+// identified by their values; other instructions by their
+// operation and operands.
+struct Value_key
+{
+  bool operator<(Value_key const& k) const
+  {
+    return std::tie(op, type, fn, n, ops) < std::tie(k.op, k.type, k.fn, k.n, k.ops);
+  }
+
+  Ssa_op                   op;
+  Type const*              type;
+  Function_decl const*     fn;
+  Integer_value            n;
+  std::vector<Ssa_inst*>   ops;
+};
+
+
+Value_key
+make_key(Ssa_inst* i)
+{
+  Value_key k {i->op, i->type, nullptr, 0, i->ops};
+  if (i->op == const_op) {
+    if (i->value.is_function())
+      k.fn = i->value.get_function();
+    else if (i->value.is_integer())
+      k.n = i->value.get_integer();
+  }
+
+  // Order the operands of commutative operations.
+  switch (i->op) {
+    case add_op:
+    case mul_op:
+    case eq_op:
+    case ne_op:
+      std::sort(k.ops.begin(), k.ops.end(), [](Ssa_inst* a, Ssa_inst* b) {
+        return a->id < b->id;
+      });
+      break;
+    default:
+      break;
+  }
+  return k;
+}
+
+
+// Global value numbering by a walk of the dominator tree.
+// An instruction is replaced by an equivalent instruction
+// that dominates it, or by a constant if its operands are
+// constant.
+struct Numbering
+{
+  Numbering(Ssa_function& f)
+    : fn(f), idom(dominators(f)), kids(f.blocks.size())
+  {
+    for (std::size_t n = 1; n < f.blocks.size(); ++n)
+      kids[idom[n]->id].push_back(f.blocks[n]);
+  }
+
+  void      run();
+  void      visit(Ssa_block*);
+  Ssa_inst* fold(Ssa_inst*);
+
+  Ssa_function&                        fn;
+  std::vector<Ssa_block*>              idom;
+  std::vector<std::vector<Ssa_block*>> kids;
+  std::map<Value_key, Ssa_inst*>       avail;
+  std::vector<Ssa_inst*>               consts; // New constants
+  Inst_map                             repl;
+};
+
+
+void
+Numbering::run()
+{
+  visit(fn.entry());
+
+  // New constants are defined in the entry block, after
+  // the arguments.
+  Ssa_block* e = fn.entry();
+  auto pos = std::find_if(e->insts.begin(), e->insts.end(), [](Ssa_inst* i) {
+    return i->op != arg_op;
+  });
+  for (Ssa_inst* c : consts)
+    c->block = e;
+  e->insts.insert(pos, consts.begin(), consts.end());
+
+  for (Ssa_block* b : fn.blocks) {
+    auto last = std::remove_if(b->insts.begin(), b->insts.end(), [this](Ssa_inst* i) {
+      return repl.count(i) != 0;
+    });
+    b->insts.erase(last, b->insts.end());
+  }
+  replace_uses(fn, repl);
+}
+
+
+// Values available in a block are available in the blocks
+// that it dominates.
+void
+Numbering::visit(Ssa_block* b)
+{
+  std::vector<Value_key> added;
+  for (Ssa_inst* i : b->insts) {
+    for (Ssa_inst*& x : i->ops)
+      x = resolve(repl, x);
+    if (i->op == phi_op || !is_pure(i))
+      continue;
+
+    if (Ssa_inst* c = fold(i)) {
+      repl.emplace(i, c);
+      continue;
+    }
+
+    Value_key k = make_key(i);
+    auto iter = avail.find(k);
+    if (iter != avail.end()) {
+      repl.emplace(i, iter->second);
+    } else {
+      avail.emplace(k, i);
+      added.push_back(std::move(k));
+    }
+  }
+
+  // A constant condition selects one successor.
+  Ssa_inst* t = b->terminator();
+  if (t->op == cond_br_op && t->ops[0]->is_constant() && t->ops[0]->value.is_integer()) {
+    bool c = t->ops[0]->value.get_integer();
+    Ssa_block* keep = t->blocks[c ? 0 : 1];
+    Ssa_block* drop = t->blocks[c ? 1 : 0];
+    remove_edge(b, drop);
+    t->op = br_op;
+    t->ops.clear();
+    t->blocks = {keep};
+  }
+
+  for (Ssa_block* k : kids[b->id])
+    visit(k);
+  for (Value_key const& k : added)
+    avail.erase(k);
+}
+
+
+// Returns a constant for i if its operands are constant.
+// Operations that fail are not folded.
+Ssa_inst*
+Numbering::fold(Ssa_inst* i)
+{
+  if (i->op == const_op)
+    return nullptr;
+  for (Ssa_inst* x : i->ops)
+    if (!x->is_constant() || x->value.is_error())
+      return nullptr;
+
+  Ssa_inst* c = make<Ssa_inst>(const_op, i->type);
+  if (i->ops.size() == 2)
+    c->value = apply(i->op, i->ops[0]->type, i->ops[0]->value, i->ops[1]->value);
+  else
+    c->value = apply(i->op, i->ops[0]->type, i->ops[0]->value);
+  consts.push_back(c);
+
+  // The new constant may equal an existing one.
+  Value_key k = make_key(c);
+  auto iter = avail.find(k);
+  if (iter != avail.end()) {
+    consts.pop_back();
+    return iter->second;
+  }
+  avail.emplace(k, c);
+  return c;
+}
+
+
+// A natural loop: its header and the blocks that reach
+// a back edge without passing through the header.
+struct Loop
+{
+  Ssa_block*                     head;
+  std::unordered_set<Ssa_block*> blocks;
+};
+
+
+std::vector<Loop>
+find_loops(Ssa_function const& f, std::vector<Ssa_block*> const& idom)
+{
+  std::vector<Loop> loops;
+  for (Ssa_block* h : f.blocks) {
+    Loop l {h, {h}};
+    std::vector<Ssa_block*> work;
+    for (Ssa_block* p : h->preds)
+      if (dominates(idom, h, p) && l.blocks.insert(p).second)
+        work.push_back(p);
+    if (l.blocks.size() == 1 && work.empty() &&
+        std::find(h->preds.begin(), h->preds.end(), h) == h->preds.end())
+      continue;
+    while (!work.empty()) {
+      Ssa_block* b = work.back();
+      work.pop_back();
+      for (Ssa_block* p : b->preds)
+        if (l.blocks.insert(p).second)
+          work.push_back(p);
+    }
+    loops.push_back(std::move(l));
+  }
+  return loops;
+}
+
+
+// Returns the unique predecessor of the loop header that
+// is outside the loop, if it jumps only to the header.
+Ssa_block*
+preheader(Loop const& l)
+{
+  Ssa_block* p = nullptr;
+  for (Ssa_block* b : l.head->preds) {
+    if (l.blocks.count(b))
+      continue;
+    if (p)
+      return nullptr;
+    p = b;
+  }
+  if (!p || p->successors().size() != 1)
+    return nullptr;
+  return p;
+}
+
+} // namespace
+
+
+// Resolve indirect calls whose target is known to be a
+// single function. The target may be selected by phi
+// nodes, all of whose operands designate that function.
+void
+devirtualize(Ssa_function& f)
+{
+  for (Ssa_block* b : f.blocks) {
+    for (Ssa_inst* i : b->insts) {
+      if (i->op != call_op || i->ops[0]->op != phi_op)
+        continue;
+
+      Ssa_inst* target = nullptr;
+      bool known = true;
+      std::unordered_set<Ssa_inst*> seen;
+      std::vector<Ssa_inst*> work {i->ops[0]};
+      while (known && !work.empty()) {
+        Ssa_inst* x = work.back();
+        work.pop_back();
+        if (!seen.insert(x).second)
+          continue;
+        if (x->op == phi_op)
+          work.insert(work.end(), x->ops.begin(), x->ops.end());
+        else if (!x->is_constant() || x->value.is_error())
+          known = false;
+        else if (!target)
+          target = x;
+        else
+          known = target->value.get_function() == x->value.get_function();
+      }
+      if (known && target)
+        i->ops[0] = target;
+    }
+  }
+}
+
+
+// Replace redundant computations in f. The blocks of f
+// must be numbered.
+void
+number_values(Ssa_function& f)
+{
+  Numbering gvn(f);
+  gvn.run();
+}
+
+
+// Move computations whose operands are defined outside of
+// a loop to the preheader of the loop. Inner loops are
+// processed first, so that invariants can move out of
+// several loops. The blocks of f must be numbered.
+void
+hoist_invariants(Ssa_function& f)
+{
+  std::vector<Ssa_block*> idom = dominators(f);
+  std::vector<Loop> loops = find_loops(f, idom);
+  for (auto iter = loops.rbegin(); iter != loops.rend(); ++iter) {
+    Loop const& l = *iter;
+    Ssa_block* pre = preheader(l);
+    if (!pre)
+      continue;
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (Ssa_block* b : f.blocks) {
+        if (!l.blocks.count(b))
+          continue;
+        for (auto i = b->insts.begin(); i != b->insts.end();) {
+          Ssa_inst* x = *i;
+          bool inv = is_pure(x) && std::all_of(x->ops.begin(), x->ops.end(), [&l](Ssa_inst* o) {
+            return !l.blocks.count(o->block);
+          });
+          if (!inv) {
+            ++i;
+            continue;
+          }
+          i = b->insts.erase(i);
+          x->block = pre;
+          pre->insts.insert(pre->insts.end() - 1, x);
+          changed = true;
+        }
+      }
+    }
+  }
+}
+
+
+// Remove unreachable blocks, trivial phi nodes, and
+// instructions whose values are not used.
+void
+eliminate_dead_code(Ssa_function& f)
+{
+  renumber(f);
+  remove_trivial_phis(f);
+
+  std::unordered_set<Ssa_inst*> live;
+  std::vector<Ssa_inst*> work;
+  for (Ssa_block* b : f.blocks)
+    for (Ssa_inst* i : b->insts)
+      if (is_needed(i) && live.insert(i).second)
+        work.push_back(i);
+  while (!work.empty()) {
+    Ssa_inst* i = work.back();
+    work.pop_back();
+    for (Ssa_inst* x : i->ops)
+      if (live.insert(x).second)
+        work.push_back(x);
+  }
+
+  for (Ssa_block* b : f.blocks) {
+    auto last = std::remove_if(b->insts.begin(), b->insts.end(), [&live](Ssa_inst* i) {
+      return !live.count(i);
+    });
+    b->insts.erase(last, b->insts.end());
+  }
+  renumber(f);
+}
+
+
+// Optimize f. Value numbering resolves branches on constant
+// conditions, which makes blocks unreachable.
+void
+optimize(Ssa_function& f)
+{
+  devirtualize(f);
+  eliminate_dead_code(f);
+  number_values(f);
+  devirtualize(f);
+  eliminate_dead_code(f);
+  hoist_invariants(f);
+  renumber(f);
+}
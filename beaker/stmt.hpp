@@ -4,6 +4,25 @@
 #ifndef BEAKER_STMT_HPP
 #define BEAKER_STMT_HPP
 
+#include <beaker/prelude.hpp>
+
+
+// The kinds of statements.
+enum Stmt_kind : unsigned char
+{
+  empty_stmt,
+  block_stmt,
+  assign_stmt,
+  return_stmt,
+  if_then_stmt,
+  if_else_stmt,
+  while_stmt,
+  break_stmt,
+  continue_stmt,
+  expression_stmt,
+  declaration_stmt,
+};
+
 
 // The base class of all statements in the language.
 struct Stmt
@@ -11,10 +30,18 @@ struct Stmt
   struct Visitor;
   struct Mutator;
 
+  Stmt(Stmt_kind k)
+    : kind_(k)
+  { }
+
   virtual ~Stmt() { }
 
   virtual void accept(Visitor&) const = 0;
   virtual void accept(Mutator&) = 0;
+
+  Stmt_kind kind() const { return kind_; }
+
+  Stmt_kind kind_;
 };
 
 
@@ -56,6 +83,12 @@ struct Stmt::Mutator
 // The empty statement.
 struct Empty_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = empty_stmt;
+
+  Empty_stmt()
+    : Stmt(node_kind)
+  { }
+
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 };
@@ -64,16 +97,18 @@ struct Empty_stmt : Stmt
 // A block statement.
 struct Block_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = block_stmt;
+
   Block_stmt(Stmt_seq const& s)
-    : first(s)
+    : Stmt(node_kind), first(s)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
 
-  Stmt_seq const& statements() const { return first; }
+  Stmt_list const& statements() const { return first; }
 
-  Stmt_seq first;
+  Stmt_list first;
 };
 
 
@@ -82,8 +117,10 @@ struct Block_stmt : Stmt
 //    e1 = e2
 struct Assign_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = assign_stmt;
+
   Assign_stmt(Expr* e1, Expr* e2)
-    : first(e1), second(e2)
+    : Stmt(node_kind), first(e1), second(e2)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
@@ -100,8 +137,10 @@ struct Assign_stmt : Stmt
 // A return statement.
 struct Return_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = return_stmt;
+
   Return_stmt(Expr* e)
-    : first(e)
+    : Stmt(node_kind), first(e)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
@@ -118,8 +157,10 @@ struct Return_stmt : Stmt
 //    if (e) s
 struct If_then_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = if_then_stmt;
+
   If_then_stmt(Expr* e, Stmt* s)
-    : first(e), second(s)
+    : Stmt(node_kind), first(e), second(s)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
@@ -138,8 +179,10 @@ struct If_then_stmt : Stmt
 //    if (e) s1 else s2
 struct If_else_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = if_else_stmt;
+
   If_else_stmt(Expr* e, Stmt* s1, Stmt* s2)
-    : first(e), second(s1), third(s2)
+    : Stmt(node_kind), first(e), second(s1), third(s2)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
@@ -160,8 +203,10 @@ struct If_else_stmt : Stmt
 //    while (e) s
 struct While_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = while_stmt;
+
   While_stmt(Expr* e, Stmt* s)
-    : first(e), second(s)
+    : Stmt(node_kind), first(e), second(s)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
@@ -178,7 +223,11 @@ struct While_stmt : Stmt
 // A break statement.
 struct Break_stmt : Stmt
 {
-  using Stmt::Stmt;
+  static constexpr Stmt_kind node_kind = break_stmt;
+
+  Break_stmt()
+    : Stmt(node_kind)
+  { }
 
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
@@ -188,7 +237,11 @@ struct Break_stmt : Stmt
 // A break statement.
 struct Continue_stmt : Stmt
 {
-  using Stmt::Stmt;
+  static constexpr Stmt_kind node_kind = continue_stmt;
+
+  Continue_stmt()
+    : Stmt(node_kind)
+  { }
 
   void accept(Visitor& v) const { return v.visit(this); }
   void accept(Mutator& v)       { return v.visit(this); }
@@ -198,8 +251,10 @@ struct Continue_stmt : Stmt
 // An expression statement.
 struct Expression_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = expression_stmt;
+
   Expression_stmt(Expr* e)
-    : first(e)
+    : Stmt(node_kind), first(e)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
@@ -214,8 +269,10 @@ struct Expression_stmt : Stmt
 // A declaration statement.
 struct Declaration_stmt : Stmt
 {
+  static constexpr Stmt_kind node_kind = declaration_stmt;
+
   Declaration_stmt(Decl* d)
-    : first(d)
+    : Stmt(node_kind), first(d)
   { }
 
   void accept(Visitor& v) const { return v.visit(this); }
@@ -294,4 +351,98 @@ apply(Stmt* s, F fn)
 }
 
 
+// -------------------------------------------------------------------------- //
+// Kind dispatch
+
+// The range of kinds of statements of type T. This is
+// specialized for statements that have derived statements.
+template<typename T>
+struct Stmt_kinds
+{
+  static constexpr Stmt_kind first = T::node_kind;
+  static constexpr Stmt_kind last  = T::node_kind;
+};
+
+template<>
+struct Stmt_kinds<Stmt>
+{
+  static constexpr Stmt_kind first = empty_stmt;
+  static constexpr Stmt_kind last  = declaration_stmt;
+};
+
+
+// Returns true if s is a statement of type T. This is a
+// comparison of kinds and does not require a dynamic cast.
+template<typename T>
+inline bool
+is(Stmt const* s)
+{
+  using R = Stmt_kinds<T>;
+  return s && R::first <= s->kind() && s->kind() <= R::last;
+}
+
+
+// Returns s as a statement of type T, or nullptr if s
+// is not a T.
+template<typename T>
+inline T*
+as(Stmt* s)
+{
+  return is<T>(s) ? static_cast<T*>(s) : nullptr;
+}
+
+
+template<typename T>
+inline T const*
+as(Stmt const* s)
+{
+  return is<T>(s) ? static_cast<T const*>(s) : nullptr;
+}
+
+
+// Apply fn to s, dispatching on its kind. This has the
+// same effect as apply(), but selects the function with
+// a single switch instead of calling through a visitor.
+template<typename F, typename T = typename std::result_of<F(Empty_stmt const*)>::type>
+inline T
+dispatch(Stmt const* s, F fn)
+{
+  switch (s->kind()) {
+    case empty_stmt: return fn(static_cast<Empty_stmt const*>(s));
+    case block_stmt: return fn(static_cast<Block_stmt const*>(s));
+    case assign_stmt: return fn(static_cast<Assign_stmt const*>(s));
+    case return_stmt: return fn(static_cast<Return_stmt const*>(s));
+    case if_then_stmt: return fn(static_cast<If_then_stmt const*>(s));
+    case if_else_stmt: return fn(static_cast<If_else_stmt const*>(s));
+    case while_stmt: return fn(static_cast<While_stmt const*>(s));
+    case break_stmt: return fn(static_cast<Break_stmt const*>(s));
+    case continue_stmt: return fn(static_cast<Continue_stmt const*>(s));
+    case expression_stmt: return fn(static_cast<Expression_stmt const*>(s));
+    case declaration_stmt: return fn(static_cast<Declaration_stmt const*>(s));
+  }
+  lingo_unreachable();
+}
+
+
+template<typename F, typename T = typename std::result_of<F(Empty_stmt*)>::type>
+inline T
+dispatch(Stmt* s, F fn)
+{
+  switch (s->kind()) {
+    case empty_stmt: return fn(static_cast<Empty_stmt*>(s));
+    case block_stmt: return fn(static_cast<Block_stmt*>(s));
+    case assign_stmt: return fn(static_cast<Assign_stmt*>(s));
+    case return_stmt: return fn(static_cast<Return_stmt*>(s));
+    case if_then_stmt: return fn(static_cast<If_then_stmt*>(s));
+    case if_else_stmt: return fn(static_cast<If_else_stmt*>(s));
+    case while_stmt: return fn(static_cast<While_stmt*>(s));
+    case break_stmt: return fn(static_cast<Break_stmt*>(s));
+    case continue_stmt: return fn(static_cast<Continue_stmt*>(s));
+    case expression_stmt: return fn(static_cast<Expression_stmt*>(s));
+    case declaration_stmt: return fn(static_cast<Declaration_stmt*>(s));
+  }
+  lingo_unreachable();
+}
+
+
 #endif
@@ -40,12 +40,21 @@ private:
 
 // Represents all identifiers.
 //
-// TODO: Track the innermost binding of the identifier?
+// Each identifier refers to its innermost binding: the
+// overload set of the declarations that an unqualified
+// use of the identifier would find. The binding is
+// maintained by the scope stack during elaboration and
+// is not part of the symbol's value.
 struct Identifier_sym : Symbol
 {
   Identifier_sym(int k)
-    : Symbol(k)
+    : Symbol(k), bind_(nullptr)
   { }
+
+  Overload* binding() const      { return bind_; }
+  void      binding(Overload* b) const { bind_ = b; }
+
+  mutable Overload* bind_;
 };
 
 
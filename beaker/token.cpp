@@ -54,6 +54,7 @@ spelling(Token_kind k)
     case float_kw: return "float";
     case foreign_kw: return "else";
     case if_kw: return "if";
+    case import_kw: return "import";
     case int16_kw: return "int16";
     case int32_kw: return "int32";
     case int64_kw: return "int64";
@@ -127,6 +128,7 @@ init_symbols(Symbol_table& syms)
   syms.put<Symbol>("float", float_kw);
   syms.put<Symbol>("foreign", foreign_kw);
   syms.put<Symbol>("if", if_kw);
+  syms.put<Symbol>("import", import_kw);
   syms.put<Symbol>("int", int_kw);
   syms.put<Symbol>("int16", int16_kw);
   syms.put<Symbol>("int32", int32_kw);
@@ -135,7 +137,7 @@ init_symbols(Symbol_table& syms)
   syms.put<Symbol>("return", return_kw);
   syms.put<Symbol>("short", short_kw);
   syms.put<Symbol>("struct", struct_kw);
-  syms.put<Symbol>("this", this_kw);
+  syms.put<Identifier_sym>("this", this_kw); // Names a parameter
   syms.put<Symbol>("trivial", trivial_kw);
   syms.put<Symbol>("uint", uint_kw);
   syms.put<Symbol>("uint16", uint16_kw);
@@ -152,6 +154,6 @@ init_symbols(Symbol_table& syms)
   syms.put<Boolean_sym>("false", boolean_tok, false);
 
   // Common identifiers
-  syms.put<Symbol>("main", identifier_tok);
-  syms.put<Symbol>("vptr", identifier_tok);
+  syms.put<Identifier_sym>("main", identifier_tok);
+  syms.put<Identifier_sym>("vptr", identifier_tok);
 }
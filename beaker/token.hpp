@@ -66,6 +66,7 @@ enum Token_kind
   float_kw,
   foreign_kw,
   if_kw,
+  import_kw,
   int16_kw,
   int32_kw,
   int64_kw,
@@ -5,11 +5,13 @@
 
 #include "beaker/type.hpp"
 #include "beaker/decl.hpp"
-#include "beaker/less.hpp"
+#include "beaker/expr.hpp"
+#include "beaker/hash.hpp"
 #include "beaker/value.hpp"
 #include "beaker/evaluator.hpp"
 
-#include <set>
+#include <mutex>
+#include <unordered_set>
 
 
 // Return a reference type for this type.
@@ -69,79 +71,116 @@ Array_type::size() const
 // -------------------------------------------------------------------------- //
 // Type accessors
 
+// A hash-consing table for types of class T. Each distinct
+// type is allocated once and never freed, so equivalent
+// types are the same object.
+//
+// The table is divided into shards, each guarded by its
+// own lock, so that types can be created concurrently.
+// A type's structural hash is computed once, before it
+// is inserted, and selects its shard.
 template<typename T>
-struct Type_less
+class Type_table
 {
-  bool operator()(T const& a, T const& b) const
+  static constexpr std::size_t shard_count = 16;
+
+  struct Hash
   {
-    return is_less(&a, &b);
-  }
+    std::size_t operator()(Type const* t) const { return t->hash(); }
+  };
+
+  using Set = std::unordered_set<Type const*, Hash, Equal_fn<Type>>;
+
+  struct Shard
+  {
+    std::mutex mutex;
+    Set        types;
+  };
+
+public:
+  template<typename... Args>
+  T const* get(Args&&...);
+
+private:
+  Shard shards_[shard_count];
 };
 
 
+// Canonical types are never freed, so they must not refer
+// to nodes in an arena, which may be released. An array
+// type owns a copy of its extent, which is a literal.
+// Other types refer only to canonical types, symbols, and
+// declarations that are compared by address.
+inline void
+adopt(Type&)
+{ }
+
+
+inline void
+adopt(Array_type& t)
+{
+  t.second = new Literal_expr(*cast<Literal_expr>(t.second));
+}
+
+
+// Returns the unique type constructed from args.
 template<typename T>
-using Type_set = std::set<T, Type_less<T>>;
+template<typename... Args>
+T const*
+Type_table<T>::get(Args&&... args)
+{
+  T t(std::forward<Args>(args)...);
+  t.hash_ = hash_value(&t);
+
+  Shard& s = shards_[t.hash_ % shard_count];
+  std::lock_guard<std::mutex> lock(s.mutex);
+  auto iter = s.types.find(&t);
+  if (iter != s.types.end())
+    return cast<T>(*iter);
+  T* p = new T(std::move(t));
+  adopt(*p);
+  s.types.insert(p);
+  return p;
+}
 
 
-// Note that id types are not canonicalized.
-// They don't need to be since they never
-// escape elaboration.
 Type const*
 get_id_type(Symbol const* s)
 {
-  return new Id_type(s);
+  static Type_table<Id_type> ts;
+  return ts.get(s);
 }
 
 
 Type const*
 get_boolean_type()
 {
-  static Boolean_type t;
-  return &t;
+  static Type_table<Boolean_type> ts;
+  static Type const* t = ts.get();
+  return t;
 }
 
 
 Type const*
 get_character_type()
 {
-  static Character_type t;
-  return &t;
+  static Type_table<Character_type> ts;
+  static Type const* t = ts.get();
+  return t;
 }
 
 
 Type const*
 get_integer_type(bool is_signed, int precision)
 {
-  static Integer_type st16(16);
-  static Integer_type ut16(false, 16);
-  static Integer_type st32(32);
-  static Integer_type ut32(false);
-  static Integer_type st64(64);
-  static Integer_type ut64(false, 64);
-
-  if (is_signed) {
-    switch (precision) {
-      case 32:
-        return &st32;
-      case 16:
-        return &st16;
-      case 64:
-        return &st64;
-      default:
-        throw std::runtime_error("No integer with precision " + std::to_string(precision));
-    }
-  }
-  else {
-    switch (precision) {
-      case 32:
-        return &ut32;
-      case 16:
-        return &ut16;
-      case 64:
-        return &ut64;
-      default:
-        throw std::runtime_error("No integer with precision " + std::to_string(precision));
-    }
+  static Type_table<Integer_type> ts;
+  switch (precision) {
+    case 16:
+    case 32:
+    case 64:
+      return ts.get(is_signed, precision);
+    default:
+      throw std::runtime_error("No integer with precision " + std::to_string(precision));
   }
 }
 
@@ -149,25 +188,26 @@ get_integer_type(bool is_signed, int precision)
 Type const*
 get_float_type()
 {
-  static Float_type t;
-  return &t;
+  static Type_table<Float_type> ts;
+  static Type const* t = ts.get();
+  return t;
 }
 
 
 Type const*
 get_double_type()
 {
-  static Double_type t;
-  return &t;
+  static Type_table<Double_type> ts;
+  static Type const* t = ts.get();
+  return t;
 }
 
 
 Type const*
 get_function_type(Type_seq const& t, Type const* r)
 {
-  static Type_set<Function_type> fn;
-  auto ins = fn.emplace(t, r);
-  return &*ins.first;
+  static Type_table<Function_type> ts;
+  return ts.get(t, r);
 }
 
 
@@ -182,21 +222,26 @@ get_function_type(Decl_seq const& d, Type const* r)
 }
 
 
+// Returns the array type T[N]. The type is canonical only
+// if N is a literal, i.e., after elaboration. Otherwise,
+// it is allocated in the current arena.
 Type const*
 get_array_type(Type const* t, Expr* n)
 {
-  static Type_set<Array_type> ts;
-  auto ins = ts.emplace(t, n);
-  return &*ins.first;
+  static Type_table<Array_type> ts;
+  if (Literal_expr* l = as<Literal_expr>(n))
+    return ts.get(t, l);
+  Array_type* a = make<Array_type>(t, n);
+  a->hash_ = hash_value(a);
+  return a;
 }
 
 
 Type const*
 get_block_type(Type const* t)
 {
-  static Type_set<Block_type> ts;
-  auto ins = ts.emplace(t);
-  return &*ins.first;
+  static Type_table<Block_type> ts;
+  return ts.get(t);
 }
 
 
@@ -204,18 +249,16 @@ get_block_type(Type const* t)
 Type const*
 get_reference_type(Type const* t)
 {
-  static Type_set<Reference_type> ts;
-  auto ins = ts.emplace(t);
-  return &*ins.first;
+  static Type_table<Reference_type> ts;
+  return ts.get(t);
 }
 
 
 Type const*
 get_record_type(Record_decl* r)
 {
-  static Type_set<Record_type> ts;
-  auto ins = ts.emplace(r);
-  return &*ins.first;
+  static Type_table<Record_type> ts;
+  return ts.get(r);
 }
 
 
@@ -9,6 +9,23 @@
 #include "decl.hpp"
 
 
+// The kinds of types.
+enum Type_kind : unsigned char
+{
+  id_type,
+  boolean_type,
+  character_type,
+  integer_type,
+  float_type,
+  double_type,
+  function_type,
+  array_type,
+  block_type,
+  reference_type,
+  record_type,
+};
+
+
 // The Type class represents the set of all types in the
 // language.
 //
@@ -23,8 +40,9 @@
 //
 // Note that types are not mutable. Once created, a type
 // cannot be changed. The reason for this is that we
-// internally canonicalize (most) types when they are
-// created.
+// internally canonicalize types when they are created.
+// Two types are the same if and only if they have the
+// same address.
 //
 // The "type" type (or kind) denotes the type user-defined
 // types. Although it describes the higher-level kind
@@ -34,12 +52,22 @@ struct Type
 {
   struct Visitor;
 
+  Type(Type_kind k)
+    : kind_(k), hash_(0)
+  { }
+
   virtual ~Type() { }
 
   virtual void accept(Visitor&) const = 0;
 
   virtual Type const* ref() const;
   virtual Type const* nonref() const;
+
+  Type_kind   kind() const { return kind_; }
+  std::size_t hash() const { return hash_; }
+
+  Type_kind   kind_;
+  std::size_t hash_; // Structural hash, set when interned
 };
 
 
@@ -63,8 +91,10 @@ struct Type::Visitor
 // placeholders to be determined during initialization.
 struct Id_type : Type
 {
+  static constexpr Type_kind node_kind = id_type;
+
   Id_type(Symbol const* s)
-    : sym_(s)
+    : Type(node_kind), sym_(s)
   { }
 
   void accept(Visitor& v) const { v.visit(this); };
@@ -78,6 +108,12 @@ struct Id_type : Type
 // The type bool.
 struct Boolean_type : Type
 {
+  static constexpr Type_kind node_kind = boolean_type;
+
+  Boolean_type()
+    : Type(node_kind)
+  { }
+
   void accept(Visitor& v) const { v.visit(this); };
 };
 
@@ -85,6 +121,12 @@ struct Boolean_type : Type
 // The type char.
 struct Character_type : Type
 {
+  static constexpr Type_kind node_kind = character_type;
+
+  Character_type()
+    : Type(node_kind)
+  { }
+
   void accept(Visitor& v) const { v.visit(this); };
 };
 
@@ -92,10 +134,12 @@ struct Character_type : Type
 // The type int.
 struct Integer_type : Type
 {
-  Integer_type(): _signed(true), _precision(32) { }
-  Integer_type(bool s, int p): _signed(s), _precision(p) { }
-  Integer_type(bool s): _signed(s), _precision(32) { }
-  Integer_type(int p): _signed(true), _precision(p) { }
+  static constexpr Type_kind node_kind = integer_type;
+
+  Integer_type(): Type(node_kind), _signed(true), _precision(32) { }
+  Integer_type(bool s, int p): Type(node_kind), _signed(s), _precision(p) { }
+  Integer_type(bool s): Type(node_kind), _signed(s), _precision(32) { }
+  Integer_type(int p): Type(node_kind), _signed(true), _precision(p) { }
     
   void accept(Visitor& v) const { v.visit(this); };
     
@@ -109,14 +153,26 @@ struct Integer_type : Type
 
 // The type float.
 struct Float_type : Type
-{   
+{
+  static constexpr Type_kind node_kind = float_type;
+
+  Float_type()
+    : Type(node_kind)
+  { }
+
   void accept(Visitor& v) const { v.visit(this); };
 };
 
 
 // The type double.
 struct Double_type : Type
-{   
+{
+  static constexpr Type_kind node_kind = double_type;
+
+  Double_type()
+    : Type(node_kind)
+  { }
+
   void accept(Visitor& v) const { v.visit(this); };
 };
 
@@ -124,8 +180,10 @@ struct Double_type : Type
 // Represents function types (t1, ..., tn) -> t.
 struct Function_type : Type
 {
+  static constexpr Type_kind node_kind = function_type;
+
   Function_type(Type_seq const& t, Type const* r)
-    : first(t), second(r)
+    : Type(node_kind), first(t), second(r)
   { }
 
   void accept(Visitor& v) const { v.visit(this); };
@@ -141,11 +199,15 @@ struct Function_type : Type
 // A fixed-length type T[N] which represents a region
 // of contiguous memory containing N objects of type T.
 //
-// N is required to be a literal of type int.
+// N is required to be a literal of type int. Until the
+// type is elaborated, N may be any expression; such types
+// are not canonical (see get_array_type).
 struct Array_type : Type
 {
+  static constexpr Type_kind node_kind = array_type;
+
   Array_type(Type const* t, Expr* e)
-    : first(t), second(e)
+    : Type(node_kind), first(t), second(e)
   { }
 
   void accept(Visitor& v) const { v.visit(this); };
@@ -167,8 +229,10 @@ struct Array_type : Type
 // This is equivalent to a C++ array of unknown bound.
 struct Block_type : Type
 {
+  static constexpr Type_kind node_kind = block_type;
+
   Block_type(Type const* t)
-    : first(t)
+    : Type(node_kind), first(t)
   { }
 
   void accept(Visitor& v) const { v.visit(this); };
@@ -182,8 +246,10 @@ struct Block_type : Type
 // The type of an expression that refers to an object.
 struct Reference_type : Type
 {
+  static constexpr Type_kind node_kind = reference_type;
+
   Reference_type(Type const* t)
-    : first(t)
+    : Type(node_kind), first(t)
   { }
 
   void accept(Visitor& v) const { v.visit(this); };
@@ -202,8 +268,10 @@ struct Reference_type : Type
 // record declaration.
 struct Record_type : Type
 {
+  static constexpr Type_kind node_kind = record_type;
+
   Record_type(Decl* d)
-    : decl_(d)
+    : Type(node_kind), decl_(d)
   { }
 
   void accept(Visitor& v) const { v.visit(this); };
@@ -328,4 +396,68 @@ apply(Type const* t, F fn)
 
 bool is_derived(const Type*, const Type*);
 
+// -------------------------------------------------------------------------- //
+// Kind dispatch
+
+// The range of kinds for the type class T. This is
+// specialized for classes that have derived classes.
+template<typename T>
+struct Type_kinds
+{
+  static constexpr Type_kind first = T::node_kind;
+  static constexpr Type_kind last  = T::node_kind;
+};
+
+template<>
+struct Type_kinds<Type>
+{
+  static constexpr Type_kind first = id_type;
+  static constexpr Type_kind last  = record_type;
+};
+
+
+// Returns true if t is a T. This is a comparison of
+// kinds and does not require a dynamic cast.
+template<typename T>
+inline bool
+is(Type const* t)
+{
+  using R = Type_kinds<T>;
+  return t && R::first <= t->kind() && t->kind() <= R::last;
+}
+
+
+// Returns t as a T, or nullptr if t is not a T.
+template<typename T>
+inline T const*
+as(Type const* t)
+{
+  return is<T>(t) ? static_cast<T const*>(t) : nullptr;
+}
+
+
+// Apply fn to t, dispatching on its kind. This has the
+// same effect as apply(), but selects the function with
+// a single switch instead of calling through a visitor.
+template<typename F, typename T = typename std::result_of<F(Id_type const*)>::type>
+inline T
+dispatch(Type const* t, F fn)
+{
+  switch (t->kind()) {
+    case id_type: return fn(static_cast<Id_type const*>(t));
+    case boolean_type: return fn(static_cast<Boolean_type const*>(t));
+    case character_type: return fn(static_cast<Character_type const*>(t));
+    case integer_type: return fn(static_cast<Integer_type const*>(t));
+    case float_type: return fn(static_cast<Float_type const*>(t));
+    case double_type: return fn(static_cast<Double_type const*>(t));
+    case function_type: return fn(static_cast<Function_type const*>(t));
+    case array_type: return fn(static_cast<Array_type const*>(t));
+    case block_type: return fn(static_cast<Block_type const*>(t));
+    case reference_type: return fn(static_cast<Reference_type const*>(t));
+    case record_type: return fn(static_cast<Record_type const*>(t));
+  }
+  lingo_unreachable();
+}
+
+
 #endif